@@ -11,10 +11,19 @@ static void usage(const char *msg = nullptr) {
 
     fprintf(stderr, R"(usage: raycmd --in <filename.yml> --out <output.ppm> [<options>]
 Rendering options:
+  --cache <dir>        Keep the obj models with their hierarchy in this directory between runs.
   --help               Print this help text.
   --in <filename>      The input scene description in yaml format.
+  --leafsize <num>     Largest number of primitives in a hierarchy leaf (default 8).
   --nthreads <num>     Use specified number of threads for rendering.
   --out <filename>     Write the final image to the given filename (in ppm format).
+  --packet <num>       Trace primary rays in packets of 4, 8 or 16 (default 1, no packets).
+  --progressive <num>  Trace 1 pixel in num x num first (a power of 2), then refine, writing
+                       the image as it improves.
+  --preview-interval <ms>
+                       Write the image of a progressive render at most every ms (default 1000).
+  --tile <num>         Render the image in tiles of num x num pixels (default 16).
+  --tile-order <order> Hand the tiles out by rows, morton or spiral (default morton).
 )");
     exit(msg ? 1 : 0);
 }
@@ -22,6 +31,9 @@ Rendering options:
 int main(int argc, char *argv[])
 {
     Scene scene;
+    BVHCost bvhCost;
+    int progressiveStride = 1;
+    std::chrono::milliseconds previewInterval{1000};
 
     // Process command-line arguments
     for (int i = 1; i < argc; ++i)
@@ -34,6 +46,10 @@ int main(int argc, char *argv[])
         {
             scene.SetOutputPath(argv[++i]);
         }
+        else if (!strcmp(argv[i], "--cache") || !strcmp(argv[i], "-cache"))
+        {
+            scene.SetCacheDirectory(argv[++i]);
+        }
         else if (!strcmp(argv[i], "--nthreads") || !strcmp(argv[i], "-nthreads")) {
             uint nThreads = std::atoi(argv[++i]);
             if (nThreads == 0) {
@@ -41,12 +57,63 @@ int main(int argc, char *argv[])
             }
             scene.SetNumThreads(nThreads);
         }
+        else if (!strcmp(argv[i], "--leafsize") || !strcmp(argv[i], "-leafsize")) {
+            int leafSize = std::atoi(argv[++i]);
+            if (leafSize <= 0) {
+                usage("invalid argument for --leafsize");
+            }
+            bvhCost.MaxLeafSize = leafSize;
+        }
+        else if (!strcmp(argv[i], "--packet") || !strcmp(argv[i], "-packet")) {
+            int packetSize = std::atoi(argv[++i]);
+            if (packetSize != 1 && packetSize != 4 && packetSize != 8 && packetSize != 16) {
+                usage("invalid argument for --packet");
+            }
+            scene.SetPacketSize(packetSize);
+        }
+        else if (!strcmp(argv[i], "--tile") || !strcmp(argv[i], "-tile")) {
+            int tileSize = std::atoi(argv[++i]);
+            if (tileSize <= 0) {
+                usage("invalid argument for --tile");
+            }
+            scene.SetTileSize(tileSize);
+        }
+        else if (!strcmp(argv[i], "--tile-order") || !strcmp(argv[i], "-tile-order")) {
+            std::string order = argv[++i];
+            if (order == "rows") {
+                scene.SetTileOrder(TileOrder::Rows);
+            }
+            else if (order == "morton") {
+                scene.SetTileOrder(TileOrder::Morton);
+            }
+            else if (order == "spiral") {
+                scene.SetTileOrder(TileOrder::Spiral);
+            }
+            else {
+                usage("invalid argument for --tile-order");
+            }
+        }
+        else if (!strcmp(argv[i], "--progressive") || !strcmp(argv[i], "-progressive")) {
+            progressiveStride = std::atoi(argv[++i]);
+            if (progressiveStride < 1 || (progressiveStride & (progressiveStride - 1)) != 0) {
+                usage("invalid argument for --progressive");
+            }
+        }
+        else if (!strcmp(argv[i], "--preview-interval") || !strcmp(argv[i], "-preview-interval")) {
+            int interval = std::atoi(argv[++i]);
+            if (interval < 0) {
+                usage("invalid argument for --preview-interval");
+            }
+            previewInterval = std::chrono::milliseconds(interval);
+        }
         else if (!strcmp(argv[i], "--help") || !strcmp(argv[i], "-help") || !strcmp(argv[i], "-h")) {
             usage();
             return 0;
         }
     }
 
+    scene.SetBVHCost(bvhCost);
+    scene.SetProgressive(progressiveStride, previewInterval);
     scene.Run();
 
     return 0;
@@ -1,5 +1,6 @@
 #include "scene.h"
 #include <fstream>
+#include <stdexcept>
 #include <thread>
 
 Scene::Scene()
@@ -52,17 +53,64 @@ std::shared_ptr<Object> Scene::getObject(const YAML::Node &node, std::string obj
     }
     else if (objType == "obj")
     {
-        // parse the teapot obj
         auto modelPath = scenePath.parent_path();
         auto path = modelPath.append(node["file"].as<std::string>());
-        ObjParser parser(path, true);
-        parser.Parse();
-        auto parsedObjs = parser.ObjToGroup();
-        // FIXME: assume we only have one group in the obj file
-        for (auto group : parsedObjs)
+
+        // hierarchy of the mesh: sah (default) or sbvh, which also splits
+        // triangles at spatial planes
+        auto meshCost = bvhCost;
+        auto bvh = node["bvh"] ? node["bvh"].as<std::string>() : "sah";
+        if (bvh == "sbvh")
+        {
+            meshCost.SpatialSplits = true;
+        }
+        else if (bvh != "sah")
         {
-            obj = group.second;
+            throw std::invalid_argument("unknown bvh " + bvh);
         }
+
+        auto &mesh = meshes[path.string() + ":" + bvh];
+        if (!mesh)
+        {
+            // a mesh divided by an earlier run is read back as it was built
+            MeshCache cache(cacheDirectory);
+            std::string key;
+            std::shared_ptr<TriangleMesh> divided;
+            if (!cacheDirectory.empty())
+            {
+                key = MeshCache::Key(path, true, meshCost);
+                divided = cache.Load(key);
+            }
+
+            if (!divided)
+            {
+                ObjParser parser(path, true);
+                parser.Parse();
+                auto parsedObjs = parser.ObjToMesh();
+                // FIXME: assume we only have one group in the obj file
+                for (auto group : parsedObjs)
+                {
+                    divided = group.second;
+                }
+                if (!divided)
+                {
+                    throw std::invalid_argument("no triangles in " + path.string());
+                }
+
+                // use bounding volume hierarchy
+                divided->Divide(meshCost);
+
+                if (!cacheDirectory.empty() && !cache.Store(key, *divided))
+                {
+                    std::cout << "Could not write " << cache.PathOf(key) << "\n";
+                }
+            }
+            mesh = divided;
+        }
+
+        // every placement (including the clones of a definition) is an
+        // instance of the same mesh with its own transform and material
+        obj = std::make_shared<Instance>(mesh);
     }
     else if (definitions.find(objType) != definitions.end())
     {
@@ -170,12 +218,6 @@ std::shared_ptr<Object> Scene::getObject(const YAML::Node &node, std::string obj
         obj->SetMaterial(material);
     }
 
-    // use bounding volume hierarchy
-    if (objType == "obj")
-    {
-        obj->Divide(divideThreshold);
-    }
-
     return obj;
 }
 
@@ -252,6 +294,7 @@ void Scene::parseGroup(std::shared_ptr<Object> &group, const YAML::Node &childre
 void Scene::Run()
 {
     YAML::Node scene = YAML::LoadFile(scenePath);
+    bvhCost.Threads = numThreads;
 
     for (YAML::const_iterator it = scene.begin(); it != scene.end(); ++it)
     {
@@ -322,13 +365,39 @@ void Scene::Run()
         }
     }
 
+    world.Commit();
+    cam.SetPacketSize(packetSize);
+    cam.SetTileSize(tileSize);
+    cam.SetTileOrder(tileOrder);
+    cam.SetProgressiveStride(progressiveStride);
+    if (progressiveStride > 1)
+        cam.SetPreviewCallback([this](Canvas &image, int) { writeImage(image); }, previewInterval);
+
     // render
     bool renderShadow = true;
 
     std::cout << "number of threads used: " << numThreads << '\n';
+    std::cout << "SIMD kernels: " << SIMD::LevelName(SIMD::GetLevel()) << '\n';
+    std::cout << "precision: " << (sizeof(Real) == sizeof(float) ? "float" : "double") << '\n';
+    std::cout << "ray packets: " << packetSize << '\n';
+    std::cout << "tiles: " << tileSize << 'x' << tileSize << '\n';
+    if (progressiveStride > 1)
+        std::cout << "progressive: 1 in " << progressiveStride << 'x' << progressiveStride << '\n';
     auto canvas = cam.Render(world, renderShadow, true, 5, numThreads);
+    writeImage(canvas);
+}
+
+void Scene::writeImage(Canvas &canvas)
+{
+    auto temporary = outputPath;
+    temporary += ".part";
+    {
+        std::ofstream out(temporary);
+        out << canvas.ToPPM();
+    }
 
-    std::ofstream out(outputPath);
-    out << canvas.ToPPM();
-    out.close();
+    std::error_code error;
+    std::filesystem::rename(temporary, outputPath, error);
+    if (error)
+        std::cout << "Could not write " << outputPath << ": " << error.message() << '\n';
 }
\ No newline at end of file
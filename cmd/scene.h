@@ -1,6 +1,7 @@
 #pragma once
 
 #include <set>
+#include <chrono>
 #include <filesystem>
 #include <unordered_map>
 #include "yaml-cpp/yaml.h"
@@ -14,7 +15,19 @@ class Scene
     Camera cam;
     uint numThreads;
     std::unordered_map<std::string, std::shared_ptr<Object>> definitions;
-    const int divideThreshold = 500;
+    // obj meshes by path and bvh option, parsed and divided once however often
+    // they are placed
+    std::unordered_map<std::string, std::shared_ptr<Object>> meshes;
+    BVHCost bvhCost;
+    int packetSize = 1;
+    int tileSize = 16;
+    TileOrder tileOrder = TileOrder::Morton;
+    // progressive rendering (see Camera::SetProgressiveStride), the image
+    // being written at most every previewInterval until it is done
+    int progressiveStride = 1;
+    std::chrono::milliseconds previewInterval{1000};
+    // where divided obj meshes are kept between runs, none when empty
+    std::filesystem::path cacheDirectory;
 
 public:
     Scene();
@@ -46,8 +59,46 @@ public:
         numThreads = n;
     }
 
+    // cost model used to build the hierarchies of obj models
+    inline void SetBVHCost(const BVHCost &cost)
+    {
+        bvhCost = cost;
+    }
+
+    // primary rays traced together (see Camera::SetPacketSize)
+    inline void SetPacketSize(int size)
+    {
+        packetSize = size;
+    }
+
+    // tiles the image is rendered in (see Camera::SetTileSize)
+    inline void SetTileSize(int size)
+    {
+        tileSize = size;
+    }
+
+    inline void SetTileOrder(TileOrder order)
+    {
+        tileOrder = order;
+    }
+
+    inline void SetProgressive(int stride, std::chrono::milliseconds interval)
+    {
+        progressiveStride = stride;
+        previewInterval = interval;
+    }
+
+    // keep the obj meshes, with their hierarchy, in a MeshCache there
+    inline void SetCacheDirectory(char *p)
+    {
+        cacheDirectory = p;
+    }
+
     std::shared_ptr<Object> getObject(const YAML::Node &node, std::string objType);
     Matrix getTransform(const Matrix currentTransform, const YAML::Node &transforms);
     void parseGroup(std::shared_ptr<Object> &group, const YAML::Node &childrenNode);
+    // write the image to the output path, through a file renamed into place
+    // so that a viewer never reads half an image
+    void writeImage(Canvas &canvas);
 
 };
\ No newline at end of file
@@ -106,6 +106,8 @@ void RoomScene()
                                                     Point(0., 0., 1.),
                                                     Vector(0., 1., 0.)));
 
+    W.Commit();
+
     bool RenderShadow = true;
 
     uint numThreads = 8;
@@ -182,6 +184,8 @@ void TestShadowScene()
                                                     Point(0., 0., 1.),
                                                     Vector(0., 1., 0.)));
 
+    W.Commit();
+
     bool RenderShadow = true;
 
     uint numThreads = 8;
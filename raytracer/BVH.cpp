@@ -0,0 +1,407 @@
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <limits>
+#include <utility>
+#include "include/BVH.h"
+#include "include/Groups.h"
+#include "include/Object.h"
+#include "include/BoundingBoxes.h"
+#include "include/SIMD.h"
+
+namespace
+{
+    // bounds are stored as float, rounded so the box only grows
+    float RoundDown(Real V)
+    {
+        if (V >= FLT_MAX)
+            return FLT_MAX;
+        if (V <= -FLT_MAX)
+            return -INFINITY;
+        auto F = static_cast<float>(V);
+        return F > V ? std::nextafter(F, -INFINITY) : F;
+    }
+
+    float RoundUp(Real V)
+    {
+        if (V <= -FLT_MAX)
+            return -FLT_MAX;
+        if (V >= FLT_MAX)
+            return INFINITY;
+        auto F = static_cast<float>(V);
+        return F < V ? std::nextafter(F, INFINITY) : F;
+    }
+
+    // a shape sorted by the surface area heuristic of BVH::Build(Shapes)
+    struct ShapeItem
+    {
+        Object *Shape;
+        BoundingBoxes Box;
+        Point Centroid;
+    };
+
+    struct BuildEntry
+    {
+        Object *Shape;
+        // set when Shape is a subgroup folded into the hierarchy
+        Groups *Group;
+        BoundingBoxes Box;
+    };
+
+    Real SurfaceArea(const BVHNode &N)
+    {
+        Real D[3];
+        for (int a = 0; a < 3; ++a)
+            D[a] = static_cast<Real>(N.Max[a]) - N.Min[a];
+        return 2 * (D[0] * D[1] + D[1] * D[2] + D[2] * D[0]);
+    }
+
+    bool HasPrimitives(Groups &G)
+    {
+        for (auto &Child : G.GetShapes())
+        {
+            auto Sub = BVH::Inlined(Child.get());
+            if (!Sub || HasPrimitives(*Sub))
+                return true;
+        }
+        return false;
+    }
+
+    class Builder
+    {
+        std::vector<BVHNode> &Nodes;
+        std::vector<Object *> &Primitives;
+
+    public:
+        int MaxDepth = 0;
+
+        Builder(std::vector<BVHNode> &N, std::vector<Object *> &P) : Nodes(N), Primitives(P) {}
+
+        // children of G, primitives first
+        std::vector<BuildEntry> Collect(Groups &G)
+        {
+            std::vector<BuildEntry> Entries;
+            for (auto &Child : G.GetShapes())
+            {
+                auto Sub = BVH::Inlined(Child.get());
+                if (Sub && !HasPrimitives(*Sub))
+                    continue;
+                Entries.push_back({Child.get(), Sub, Sub ? Sub->BoundsOf() : Child->ParentSpaceBoundsOf()});
+            }
+            std::stable_partition(Entries.begin(), Entries.end(), [](const BuildEntry &E) { return !E.Group; });
+            return Entries;
+        }
+
+        void EmitGroup(Groups &G, int Depth)
+        {
+            auto Entries = Collect(G);
+            if (!Entries.empty())
+                Emit(Entries, 0, Entries.size(), Depth);
+        }
+
+        // emit the subtree holding Entries[Begin, End) (not empty)
+        void Emit(std::vector<BuildEntry> &Entries, size_t Begin, size_t End, int Depth)
+        {
+            MaxDepth = std::max(MaxDepth, Depth);
+
+            auto FirstGroup = Begin;
+            while (FirstGroup < End && !Entries[FirstGroup].Group)
+                ++FirstGroup;
+
+            if (FirstGroup == End)
+            {
+                BoundingBoxes Box;
+                BVHNode Leaf;
+                Leaf.Offset = Primitives.size();
+                Leaf.Count = End - Begin;
+                for (auto i = Begin; i < End; ++i)
+                {
+                    Box.AddBox(Entries[i].Box);
+                    Primitives.push_back(Entries[i].Shape);
+                }
+                Leaf.SetBounds(Box);
+                Nodes.push_back(Leaf);
+                return;
+            }
+
+            if (End - Begin == 1)
+            {
+                EmitGroup(*Entries[Begin].Group, Depth);
+                return;
+            }
+
+            // the primitives make one leaf, the subgroups are split in halves
+            auto Mid = FirstGroup > Begin ? FirstGroup : Begin + (End - Begin) / 2;
+            auto Index = Nodes.size();
+            Nodes.push_back(BVHNode());
+            Emit(Entries, Begin, Mid, Depth + 1);
+            auto Second = Nodes.size();
+            Emit(Entries, Mid, End, Depth + 1);
+
+            Join(Index, Second);
+        }
+
+        // emit the subtree holding Items[Begin, End) (not empty), split with
+        // the binned SAH of Groups::Divide(const BVHCost &)
+        void Emit(std::vector<ShapeItem> &Items, size_t Begin, size_t End, const BVHCost &Cost, int Depth)
+        {
+            MaxDepth = std::max(MaxDepth, Depth);
+
+            BoundingBoxes Box;
+            for (auto i = Begin; i < End; ++i)
+                Box.AddBox(Items[i].Box);
+
+            auto Mid = End - Begin > 1 ? BVHBuild::SplitItems(Items, Begin, End, Box, Cost) : End;
+            if (Mid == End)
+            {
+                BVHNode Leaf;
+                Leaf.Offset = Primitives.size();
+                Leaf.Count = End - Begin;
+                for (auto i = Begin; i < End; ++i)
+                    Primitives.push_back(Items[i].Shape);
+                Leaf.SetBounds(Box);
+                Nodes.push_back(Leaf);
+                return;
+            }
+
+            auto Index = Nodes.size();
+            Nodes.push_back(BVHNode());
+            Emit(Items, Begin, Mid, Cost, Depth + 1);
+            auto Second = Nodes.size();
+            Emit(Items, Mid, End, Cost, Depth + 1);
+            Join(Index, Second);
+        }
+
+    private:
+        // make node Index the parent of the node after it and of Second
+        void Join(size_t Index, size_t Second)
+        {
+            auto &Node = Nodes[Index];
+            Node.Offset = Second;
+            Node.Count = 0;
+            for (int a = 0; a < 3; ++a)
+            {
+                Node.Min[a] = std::min(Nodes[Index + 1].Min[a], Nodes[Second].Min[a]);
+                Node.Max[a] = std::max(Nodes[Index + 1].Max[a], Nodes[Second].Max[a]);
+            }
+        }
+    };
+}
+
+using namespace BVHTraversal;
+
+void BVHNode::SetBounds(const BoundingBoxes &Box)
+{
+    for (int a = 0; a < 3; ++a)
+    {
+        Min[a] = RoundDown(Box.Min[a]);
+        Max[a] = RoundUp(Box.Max[a]);
+    }
+}
+
+Groups *BVH::Inlined(Object *Shape)
+{
+    auto G = dynamic_cast<Groups *>(Shape);
+    if (!G || G->Transformed())
+        return nullptr;
+    return G;
+}
+
+void BVH::Build(Groups &Root)
+{
+    Clear();
+
+    FoldsGroups = true;
+    Builder B(Nodes, Primitives);
+    B.EmitGroup(Root, 0);
+    Index(B.MaxDepth);
+}
+
+void BVH::Build(const std::vector<std::shared_ptr<Object>> &Shapes, const BVHCost &Cost)
+{
+    Clear();
+    if (Shapes.empty())
+        return;
+
+    std::vector<ShapeItem> Items;
+    Items.reserve(Shapes.size());
+    for (auto &S : Shapes)
+    {
+        auto Box = S->ParentSpaceBoundsOf();
+        Items.push_back({S.get(), Box, Box.Centroid()});
+    }
+
+    Builder B(Nodes, Primitives);
+    B.Emit(Items, 0, Items.size(), Cost, 0);
+    Index(B.MaxDepth);
+}
+
+void BVH::Index(int Depth)
+{
+    // the traversal stack holds one entry per level
+    if (Depth > StackSize)
+    {
+        Clear();
+        Dropped = Fallback::TooDeep;
+        return;
+    }
+
+    Parents.assign(Nodes.size(), NoParent);
+    for (uint32_t i = 0; i < Nodes.size(); ++i)
+    {
+        auto &N = Nodes[i];
+        if (N.Count == 0)
+        {
+            Parents[i + 1] = i;
+            Parents[N.Offset] = i;
+            continue;
+        }
+        for (auto p = N.Offset; p < N.Offset + N.Count; ++p)
+            Leaves.emplace(Primitives[p], i);
+    }
+
+    for (uint32_t i = 0; i < Nodes.size(); ++i)
+        Area += WeightedArea(i);
+    BuiltCost = RelativeCost(Area);
+}
+
+void BVH::Clear()
+{
+    Nodes.clear();
+    Primitives.clear();
+    Parents.clear();
+    Leaves.clear();
+    BuiltCost = Area = 0;
+    FoldsGroups = false;
+    Dropped = Fallback::None;
+}
+
+bool BVH::Refit(const Object *Primitive)
+{
+    auto Range = Leaves.equal_range(Primitive);
+    if (Range.first == Range.second)
+    {
+        Clear();
+        return false;
+    }
+    // a subgroup that lost its transform is to be folded into the nodes
+    if (auto G = FoldsGroups ? Inlined(const_cast<Object *>(Primitive)) : nullptr)
+    {
+        if (HasPrimitives(*G))
+        {
+            Clear();
+            return false;
+        }
+    }
+
+    for (auto It = Range.first; It != Range.second; ++It)
+    {
+        auto i = It->second;
+        BoundingBoxes Box;
+        for (auto p = Nodes[i].Offset; p < Nodes[i].Offset + Nodes[i].Count; ++p)
+            Box.AddBox(Primitives[p]->ParentSpaceBoundsOf());
+        Area -= WeightedArea(i);
+        Nodes[i].SetBounds(Box);
+        Area += WeightedArea(i);
+
+        // up to the first node that already holds its children
+        for (auto Up = Parents[i]; Up != NoParent; Up = Parents[Up])
+        {
+            auto &N = Nodes[Up];
+            auto &First = Nodes[Up + 1];
+            auto &Second = Nodes[N.Offset];
+            auto Before = N;
+            for (int a = 0; a < 3; ++a)
+            {
+                N.Min[a] = std::min(First.Min[a], Second.Min[a]);
+                N.Max[a] = std::max(First.Max[a], Second.Max[a]);
+            }
+            if (std::equal(N.Min, N.Min + 3, Before.Min) && std::equal(N.Max, N.Max + 3, Before.Max))
+                break;
+            Area += SurfaceArea(N) - SurfaceArea(Before);
+        }
+    }
+
+    // unbounded primitives (planes) make the costs infinite, the comparison
+    // fails and such hierarchies are always kept
+    if (RelativeCost(Area) > MaxRefitGrowth * BuiltCost)
+    {
+        Clear();
+        Dropped = Fallback::Degraded;
+        return false;
+    }
+    return true;
+}
+
+Real BVH::WeightedArea(uint32_t i) const
+{
+    auto &N = Nodes[i];
+    return SurfaceArea(N) * (N.Count == 0 ? 1 : N.Count);
+}
+
+Real BVH::RelativeCost(Real Sum) const
+{
+    return Sum / SurfaceArea(Nodes[0]);
+}
+
+void BVH::Intersect(const Ray &R, std::vector<Intersection<Object>> &XS) const
+{
+    const Real TMax = std::numeric_limits<Real>::infinity();
+    Traverse(Nodes, 0, R, -TMax, TMax, [&](const BVHNode &N) {
+        for (auto i = N.Offset; i < N.Offset + N.Count; ++i)
+        {
+            Primitives[i]->Intersect(R, XS);
+        }
+        return true;
+    });
+}
+
+bool BVH::ClosestHit(const Ray &R, Real TMin, Real &TMax, Intersection<Object> &Hit) const
+{
+    return ClosestHitBelow(0, R, TMin, TMax, Hit);
+}
+
+bool BVH::ClosestHitBelow(uint32_t Root, const Ray &R, Real TMin, Real &TMax, Intersection<Object> &Hit) const
+{
+    bool Found = false;
+    Traverse(Nodes, Root, R, TMin, TMax, [&](const BVHNode &N) {
+        for (auto i = N.Offset; i < N.Offset + N.Count; ++i)
+        {
+            if (Primitives[i]->ClosestHit(R, TMin, TMax, Hit))
+                Found = true;
+        }
+        return true;
+    });
+    return Found;
+}
+
+LaneMask BVH::ClosestHits(const RayPacket &P, LaneMask Active, Real TMin, Real *TMax, Intersection<Object> *Hits) const
+{
+    return TracePacket(Nodes, P, Active, TMin, TMax,
+        [&](const BVHNode &N, LaneMask Lanes) {
+            LaneMask Found = 0;
+            for (auto i = N.Offset; i < N.Offset + N.Count; ++i)
+            {
+                Found |= Primitives[i]->ClosestHits(P, Lanes, TMin, TMax, Hits);
+            }
+            return Found;
+        },
+        [&](uint32_t Index, int i) { return ClosestHitBelow(Index, P.GetRay(i), TMin, TMax[i], Hits[i]); });
+}
+
+bool BVH::AnyHit(const Ray &R, Real TMin, Real TMax) const
+{
+    bool Found = false;
+    Traverse(Nodes, 0, R, TMin, TMax, [&](const BVHNode &N) {
+        for (auto i = N.Offset; i < N.Offset + N.Count; ++i)
+        {
+            if (Primitives[i]->AnyHit(R, TMin, TMax))
+            {
+                Found = true;
+                return false;
+            }
+        }
+        return true;
+    });
+    return Found;
+}
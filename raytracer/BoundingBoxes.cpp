@@ -1,6 +1,5 @@
 #include "include/BoundingBoxes.h"
 #include <limits>
-#include "include/Cubes.h"
 #include <algorithm>
 // #include "include/Ray.h"
 // #include "include/Intersection.h"
@@ -27,7 +26,7 @@ BoundingBoxes::BoundingBoxes(std::pair<Point, Point> MinMax)
     Max = MinMax.second;
 }
 
-void BoundingBoxes::AddPoint(Point P)
+void BoundingBoxes::AddPoint(const Point &P)
 {
     if (P.X() < Min.X()) Min.SetX(P.X());
     if (P.Y() < Min.Y()) Min.SetY(P.Y());
@@ -38,27 +37,55 @@ void BoundingBoxes::AddPoint(Point P)
     if (P.Z() > Max.Z()) Max.SetZ(P.Z());
 }
 
-void BoundingBoxes::AddBox(BoundingBoxes &B)
+void BoundingBoxes::AddBox(const BoundingBoxes &B)
 {
+    // an empty box (inverted bounds, e.g. an empty bin of the hierarchy
+    // builders) adds nothing; its corners would make the union infinite
+    for (int i = 0; i < 3; ++i)
+    {
+        if (!(B.Min[i] <= B.Max[i]))
+            return;
+    }
     AddPoint(B.Min);
     AddPoint(B.Max);
 }
 
-bool BoundingBoxes::ContainsPoint(Point P)
+bool BoundingBoxes::ContainsPoint(const Point &P) const
 {
     return ( P.X() >= Min.X() && P.X() <= Max.X() )
             && ( P.Y() >= Min.Y() && P.Y() <= Max.Y() )
             && ( P.Z() >= Min.Z() && P.Z() <= Max.Z() );
 }
 
-bool BoundingBoxes::ContainsBox(BoundingBoxes &B)
+bool BoundingBoxes::ContainsBox(const BoundingBoxes &B) const
 {
     return ContainsPoint(B.Min) && ContainsPoint(B.Max);
 }
 
-BoundingBoxes BoundingBoxes::Transform(Matrix &M)
+Point BoundingBoxes::Centroid() const
+{
+    return Point((Min.X() + Max.X()) / 2, (Min.Y() + Max.Y()) / 2, (Min.Z() + Max.Z()) / 2);
+}
+
+Real BoundingBoxes::SurfaceArea() const
+{
+    auto D = Max - Min;
+    return 2 * (D.X() * D.Y() + D.Y() * D.Z() + D.Z() * D.X());
+}
+
+bool BoundingBoxes::IsBounded() const
+{
+    for (int i = 0; i < 3; ++i)
+    {
+        if (!(Min[i] <= Max[i]) || !(-Util::Inf < Min[i]) || !(Max[i] < Util::Inf))
+            return false;
+    }
+    return true;
+}
+
+BoundingBoxes BoundingBoxes::Transform(const Matrix &M) const
 {
-    std::vector<Point> PS {
+    const Point PS[8] {
         Min,
         Point(Min.X(), Min.Y(), Max.Z()),
         Point(Min.X(), Max.Y(), Min.Z()),
@@ -80,19 +107,8 @@ BoundingBoxes BoundingBoxes::Transform(Matrix &M)
 
 bool BoundingBoxes::Intersect(const Ray &R)
 {
-    auto XT = CheckAxis(R.GetOrigin().X(), R.GetDirection().X(), Min.X(), Max.X());
-    auto YT = CheckAxis(R.GetOrigin().Y(), R.GetDirection().Y(), Min.Y(), Max.Y());
-    auto ZT = CheckAxis(R.GetOrigin().Z(), R.GetDirection().Z(), Min.Z(), Max.Z());
-
-    std::vector<double> TMinCandidates {XT[0], YT[0], ZT[0]};
-    std::vector<double> TMaxCandidates {XT[1], YT[1], ZT[1]};
-    auto TMin = *std::max_element(TMinCandidates.begin(), TMinCandidates.end());
-    auto TMax = *std::min_element(TMaxCandidates.begin(), TMaxCandidates.end());
-
-    if (TMin > TMax)
-        return false;
-
-    return true;
+    auto T = Intersect(RaySlabs(R));
+    return T.first <= T.second;
 }
 
 std::pair<BoundingBoxes, BoundingBoxes> BoundingBoxes::SplitBounds()
@@ -101,7 +117,7 @@ std::pair<BoundingBoxes, BoundingBoxes> BoundingBoxes::SplitBounds()
     auto Dx = Max.X() - Min.X();
     auto Dy = Max.Y() - Min.Y();
     auto Dz = Max.Z() - Min.Z();
-    std::vector<double> Dxyz {Dx, Dy, Dz};
+    std::vector<Real> Dxyz {Dx, Dy, Dz};
 
     auto Greatest = *max_element(std::begin(Dxyz), std::end(Dxyz));
     auto X0 = Min.X();
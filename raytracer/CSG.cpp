@@ -43,22 +43,17 @@ int CSG::GetID()
     return ID;
 }
 
-std::vector<Intersection<Object>> CSG::LocalIntersect(const Ray &LocalRay)
+void CSG::LocalIntersect(const Ray &LocalRay, std::vector<Intersection<Object>> &XS)
 {
-    std::vector<Intersection<Object>> Intersections;
-
     if (BoundsOf().Intersect(LocalRay)) {
-        auto LeftXS = Left->Intersect(LocalRay);
-        auto RightXS = Right->Intersect(LocalRay);
-
-        Intersections.insert(Intersections.end(), LeftXS.begin(), LeftXS.end());
-        Intersections.insert(Intersections.end(), RightXS.begin(), RightXS.end());
-        std::sort(Intersections.begin(), Intersections.end());
+        // the filter needs both children's hits in order, but only ours
+        auto First = XS.size();
+        Left->Intersect(LocalRay, XS);
+        Right->Intersect(LocalRay, XS);
+        std::sort(XS.begin() + First, XS.end());
 
-        return FilterIntersections(Intersections);
+        FilterIntersections(XS, First);
     }
-
-    return Intersections;
 }
 
 bool CSG::IntersectionAllowed(bool LHit, bool InL, bool InR)
@@ -81,16 +76,24 @@ bool CSG::IntersectionAllowed(bool LHit, bool InL, bool InR)
 
 std::vector<Intersection<Object>> CSG::FilterIntersections(std::vector<Intersection<Object>> &XS)
 {
-    std::vector<Intersection<Object>> Intersections;
+    std::vector<Intersection<Object>> Intersections = XS;
+    FilterIntersections(Intersections, 0);
+    return Intersections;
+}
+
+void CSG::FilterIntersections(std::vector<Intersection<Object>> &XS, std::size_t First)
+{
     bool LHit = false;
     bool InL = false;
     bool InR = false;
 
-    for (auto &X: XS)
+    // compact the allowed intersections in place
+    auto Kept = First;
+    for (auto i = First; i < XS.size(); ++i)
     {
-        LHit = Left->Include(X.GetObject());
+        LHit = Left->Include(XS[i].GetObject());
         if (IntersectionAllowed(LHit, InL, InR))
-            Intersections.push_back(X);
+            XS[Kept++] = XS[i];
 
         // depending on which object was hit, toggle either InL or InR
         if (LHit)
@@ -99,7 +102,7 @@ std::vector<Intersection<Object>> CSG::FilterIntersections(std::vector<Intersect
             InR = !InR;
     }
 
-    return Intersections;
+    XS.resize(Kept);
 }
 
 bool CSG::Include(Object *S)
@@ -109,6 +112,26 @@ bool CSG::Include(Object *S)
     return false;
 }
 
+void CSG::Commit()
+{
+    Object::Commit();
+
+    if (Left)
+        Left->Commit();
+    if (Right)
+        Right->Commit();
+}
+
+void CSG::Uncommit()
+{
+    Object::Uncommit();
+
+    if (Left)
+        Left->Uncommit();
+    if (Right)
+        Right->Uncommit();
+}
+
 BoundingBoxes CSG::BoundsOf()
 {
     BoundingBoxes Box;
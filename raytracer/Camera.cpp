@@ -5,14 +5,16 @@
 #include <iostream>
 #include <cmath>
 #include <chrono>
-#include <atomic>
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
 #include "threadpool.h"
 
 Camera::Camera()
 {
 }
 
-Camera::Camera(int H, int V, double FOV)
+Camera::Camera(int H, int V, Real FOV)
 {
     HSize = H;
     VSize = V;
@@ -22,16 +24,46 @@ Camera::Camera(int H, int V, double FOV)
     ComputePixelSize();
 }
 
-void Camera::SetTransform(Matrix &M)
+void Camera::SetTransform(const Matrix &M)
 {
     Transform = M;
     TransformInverse = Transform.Inverse();
 }
 
+void Camera::SetPacketSize(int Size)
+{
+    if (Size != 1 && Size != 4 && Size != 8 && Size != 16)
+        throw std::invalid_argument("the packet size must be 1, 4, 8 or 16");
+
+    PacketSize = Size;
+}
+
+void Camera::SetTileSize(int Size)
+{
+    if (Size < 1)
+        throw std::invalid_argument("the tile size must be at least 1");
+
+    TileSize = Size;
+}
+
+void Camera::SetProgressiveStride(int Stride)
+{
+    if (Stride < 1 || (Stride & (Stride - 1)) != 0)
+        throw std::invalid_argument("the progressive stride must be a power of 2");
+
+    ProgressiveStride = Stride;
+}
+
+void Camera::SetPreviewCallback(std::function<void(Canvas &Image, int Stride)> Fn, std::chrono::milliseconds Interval)
+{
+    Preview = std::move(Fn);
+    PreviewInterval = Interval;
+}
+
 void Camera::ComputePixelSize()
 {
-    double HalfView = std::tan(FieldOfView / 2);
-    double Aspect = (double)(HSize) / (double)(VSize);
+    Real HalfView = std::tan(FieldOfView / 2);
+    Real Aspect = (Real)(HSize) / (Real)(VSize);
 
     if (Aspect >= 1.)
     {
@@ -68,71 +100,207 @@ Ray Camera::RayForPixel(int X, int Y)
     return Ray(Origin, Direction);
 }
 
-Canvas Camera::Render(World &W, bool RenderShadow, bool printLog, int RayDepth, uint numThreads)
+std::vector<std::pair<int, int>> Camera::Tiles() const
 {
-    Canvas Image(HSize, VSize);
+    int Columns = (HSize + TileSize - 1) / TileSize;
+    int Rows = (VSize + TileSize - 1) / TileSize;
+    std::size_t Count = Columns * Rows;
+    std::vector<std::pair<int, int>> Res;
+    Res.reserve(Count);
+
+    if (Order == TileOrder::Spiral)
+    {
+        // walk a square spiral around the center tile (1 right, 1 down, 2
+        // left, 2 up, 3 right...), keeping the tiles inside the image
+        int TX = (Columns - 1) / 2, TY = (Rows - 1) / 2;
+        int DX = 1, DY = 0;
+        for (int Leg = 1; Res.size() < Count; ++Leg)
+        {
+            for (int Turn = 0; Turn < 2; ++Turn)
+            {
+                for (int i = 0; i < Leg; ++i)
+                {
+                    if (TX >= 0 && TX < Columns && TY >= 0 && TY < Rows)
+                        Res.emplace_back(TX * TileSize, TY * TileSize);
+                    TX += DX;
+                    TY += DY;
+                }
+                std::swap(DX, DY);
+                DX = -DX;
+            }
+        }
+        return Res;
+    }
+
+    for (int TY = 0; TY < Rows; ++TY)
+    {
+        for (int TX = 0; TX < Columns; ++TX)
+            Res.emplace_back(TX, TY);
+    }
 
-    // variables for progress bar
-    int TotalPixels = HSize * VSize;
-    std::atomic<int> CurPixel = 0;
-    int Step = 1;
-    int DisplayNext = 1;
+    if (Order == TileOrder::Morton)
+    {
+        // interleave the bits of the tile coordinates, X in the even ones
+        auto Code = [](const std::pair<int, int> &T) {
+            uint64_t C = 0;
+            for (int b = 0; b < 31; ++b)
+            {
+                C |= static_cast<uint64_t>(T.first >> b & 1) << (2 * b);
+                C |= static_cast<uint64_t>(T.second >> b & 1) << (2 * b + 1);
+            }
+            return C;
+        };
+        std::sort(Res.begin(), Res.end(), [&](const std::pair<int, int> &A, const std::pair<int, int> &B) {
+            return Code(A) < Code(B);
+        });
+    }
+
+    for (auto &T : Res)
+        T = {T.first * TileSize, T.second * TileSize};
+    return Res;
+}
 
-    auto StartTime = std::chrono::system_clock::now();
+void Camera::RenderTile(World &W, Canvas &Image, int X0, int Y0, int X1, int Y1, bool RenderShadow, int RayDepth)
+{
+    if (PacketSize == 1)
+    {
+        for (int Y = Y0; Y < Y1; ++Y)
+        {
+            for (int X = X0; X < X1; ++X)
+            {
+                auto R = RayForPixel(X, Y);
+                Image.WritePixel(X, Y, W.ColorAt(R, RenderShadow, RayDepth));
+            }
+        }
+        return;
+    }
 
-    // ProgressThread will print out the progress to screen
-    std::thread ProgressThread([&] {
-        std::chrono::milliseconds SleepDuration(250);
-        while (CurPixel < TotalPixels)
+    // the rays of a block form a packet, blocks are cut at the tile edges
+    int BlockWidth = PacketSize == 4 ? 2 : 4;
+    int BlockHeight = PacketSize / BlockWidth;
+    Ray Rays[RayPacket::MaxSize];
+    Color Colors[RayPacket::MaxSize];
+    for (int Y = Y0; Y < Y1; Y += BlockHeight)
+    {
+        auto EndY = std::min(Y + BlockHeight, Y1);
+        for (int X = X0; X < X1; X += BlockWidth)
         {
-            std::this_thread::sleep_for(SleepDuration);
-            if (printLog)
+            auto EndX = std::min(X + BlockWidth, X1);
+            int N = 0;
+            for (int PY = Y; PY < EndY; ++PY)
             {
-                // Formatted progress indicator
-                auto Percent = (100 * (CurPixel + 1)) / TotalPixels ;
-                if (Percent >= DisplayNext)
+                for (int PX = X; PX < EndX; ++PX)
                 {
-                    std::cout << "\r" << "Progress [" << std::string(Percent / 5, '=') << std::string(100 / 5 - Percent / 5, ' ') << "]";
-                    std::cout << ' ' << Percent << "%";
+                    Rays[N++] = RayForPixel(PX, PY);
+                }
+            }
 
-                    auto CurrentTime = std::chrono::system_clock::now();
-                    std::chrono::duration<double> ElapsedSeconds = CurrentTime - StartTime;
+            W.ColorsAt(RayPacket(Rays, N), RenderShadow, RayDepth, Colors);
 
-                    std::cout << "    " << "Elapsed time: " << (int)ElapsedSeconds.count() << "s";
-                    std::cout.flush();
-                    DisplayNext += Step;
+            N = 0;
+            for (int PY = Y; PY < EndY; ++PY)
+            {
+                for (int PX = X; PX < EndX; ++PX)
+                {
+                    Image.WritePixel(PX, PY, Colors[N++]);
                 }
             }
         }
+    }
+}
+
+void Camera::SetProgressCallback(RenderJob::Callback Fn, std::chrono::milliseconds Interval)
+{
+    Progress = std::move(Fn);
+    ProgressInterval = Interval;
+}
+
+int Camera::RenderTileOnGrid(World &W, Canvas &Image, int X0, int Y0, int X1, int Y1, int Step, int Coarse,
+                             bool RenderShadow, int RayDepth)
+{
+    int Count = 0;
+    for (int Y = (Y0 + Step - 1) / Step * Step; Y < Y1; Y += Step)
+    {
+        for (int X = (X0 + Step - 1) / Step * Step; X < X1; X += Step)
+        {
+            if (Coarse > 0 && X % Coarse == 0 && Y % Coarse == 0)
+                continue;
+            auto R = RayForPixel(X, Y);
+            Image.WritePixel(X, Y, W.ColorAt(R, RenderShadow, RayDepth));
+            ++Count;
+        }
+    }
+    return Count;
+}
+
+Canvas Camera::Render(World &W, bool RenderShadow, bool printLog, int RayDepth, uint numThreads)
+{
+    Canvas Image(HSize, VSize);
 
-        if (printLog)
-            std::cout << std::endl;
-    });
+    // progress bar, redrawn by the thread finishing a tile when the interval
+    // has passed; nothing runs in between
+    auto Callback = Progress;
+    if (!Callback && printLog)
+    {
+        auto StartTime = std::chrono::steady_clock::now();
+        Callback = [StartTime](int Done, int Total) {
+            auto Percent = Total > 0 ? (100 * static_cast<int64_t>(Done)) / Total : 100;
+            std::cout << "\r" << "Progress [" << std::string(Percent / 5, '=') << std::string(100 / 5 - Percent / 5, ' ') << "]";
+            std::cout << ' ' << Percent << "%";
 
-    // Use a thread pool here
-    ThreadPool pool{numThreads};
+            std::chrono::duration<Real> ElapsedSeconds = std::chrono::steady_clock::now() - StartTime;
+            std::cout << "    " << "Elapsed time: " << (int)ElapsedSeconds.count() << "s";
+            if (Done == Total)
+                std::cout << std::endl;
+            std::cout.flush();
+        };
+    }
 
-    for (int Y = 0; Y < VSize; ++Y)
+    // rows of pixels vary widely in cost, so instead of a fixed share each
+    // thread takes the next tile from a shared counter as long as some are
+    // left; the calling thread renders too, until all the tiles are done
+    auto Origins = Tiles();
+    int Passes = 1;
+    for (int Step = ProgressiveStride; Step > 1; Step /= 2)
+        ++Passes;
+    RenderJob Job(Origins.size() * Passes, HSize * VSize, Callback, ProgressInterval);
+
+    auto LastPreview = std::chrono::steady_clock::now();
+    for (int Pass = 0; Pass < Passes; ++Pass)
     {
-        auto CurY = Y;
-        // auto CurX = X;
+        int Step = ProgressiveStride >> Pass;
+        int Coarse = Pass == 0 ? 0 : Step * 2;
+        ThreadPool::shared().parallelFor(0, Origins.size(), 1, [&](std::size_t t) {
+            auto X0 = Origins[t].first, Y0 = Origins[t].second;
+            auto X1 = std::min(X0 + TileSize, HSize), Y1 = std::min(Y0 + TileSize, VSize);
+            int Count = (X1 - X0) * (Y1 - Y0);
+            if (Passes == 1)
+                RenderTile(W, Image, X0, Y0, X1, Y1, RenderShadow, RayDepth);
+            else
+                Count = RenderTileOnGrid(W, Image, X0, Y0, X1, Y1, Step, Coarse, RenderShadow, RayDepth);
+            Job.Finish(Pass * Origins.size() + t, Count);
+        }, numThreads);
 
-        // enqueue a task
-        pool.enqueue([=, &W, &Image, &CurPixel, &ProgressThread] {
-            for (int CurX = 0; CurX < HSize; ++CurX)
-            {
-                auto R = RayForPixel(CurX, CurY);
-                auto Col = W.ColorAt(R, RenderShadow, RayDepth);
+        if (Step == 1 || !Preview)
+            continue;
+        auto Now = std::chrono::steady_clock::now();
+        if (Pass > 0 && Now - LastPreview < PreviewInterval)
+            continue;
 
-                Image.WritePixel(CurX, CurY, Col);
-                ++CurPixel;
-                if (CurPixel == TotalPixels)
-                {
-                    ProgressThread.join();
-                }
+        // the pixels off the grid take the color of the one at the top left
+        // of their cell, the next pass overwrites those it traces
+        ThreadPool::shared().parallelFor(0, VSize, 16, [&](std::size_t Y) {
+            int SourceY = Y / Step * Step;
+            for (int X = 0; X < HSize; ++X)
+            {
+                if (X % Step != 0 || static_cast<int>(Y) != SourceY)
+                    Image.WritePixel(X, Y, *Image.GetPixel(X / Step * Step, SourceY));
             }
-        });
+        }, numThreads);
+        Preview(Image, Step);
+        LastPreview = std::chrono::steady_clock::now();
     }
+    Job.Wait();
 
     return Image;
 }
@@ -11,7 +11,7 @@ Color::Color() {
     B = 0.;
 }
 
-Color::Color(double R, double G, double B)
+Color::Color(Real R, Real G, Real B)
 {
     this->R = R;
     this->G = G;
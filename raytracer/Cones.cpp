@@ -18,8 +18,8 @@ Cones::Cones(int ID)
     AMaterial = Material();
     UseShadow = true;
     this->ID = ID;
-    Min = -std::numeric_limits<double>::max();
-    Max = std::numeric_limits<double>::max();
+    Min = -std::numeric_limits<Real>::max();
+    Max = std::numeric_limits<Real>::max();
     Closed = false;
     Parent = nullptr;
 }
@@ -28,7 +28,7 @@ Cones::Cones() : Cones(0)
 {
 }
 
-Cones::Cones(double Minimum, double Maximum, bool IsClosed)
+Cones::Cones(Real Minimum, Real Maximum, bool IsClosed)
 {
     Transform = Matrix::Identity();
     TransformInverse = Matrix::Identity();
@@ -70,10 +70,8 @@ Vector Cones::LocalNormalAt(Point &&LocalPoint)
     return LocalNormalAt(LocalPoint);
 }
 
-std::vector<Intersection<Object>> Cones::LocalIntersect(const Ray &LocalRay)
+void Cones::LocalIntersect(const Ray &LocalRay, std::vector<Intersection<Object>> &XS)
 {
-    std::vector<Intersection<Object>> Intersections;
-
     auto RayDirection = LocalRay.GetDirection();
     auto RayOrigin = LocalRay.GetOrigin();
 
@@ -90,7 +88,7 @@ std::vector<Intersection<Object>> Cones::LocalIntersect(const Ray &LocalRay)
         auto Disc = B * B - 4 * A * C;
         // check case: ray does not intersect the Cone
         if (Disc < 0)
-            return Intersections;
+            return;
 
         auto T0 = (-B - std::sqrt(Disc)) / (2 * A);
         auto T1 = (-B + std::sqrt(Disc)) / (2 * A);
@@ -98,25 +96,23 @@ std::vector<Intersection<Object>> Cones::LocalIntersect(const Ray &LocalRay)
 
         auto Y0 = RayOrigin.Y() + T0 * RayDirection.Y();
         if (Min < Y0 && Y0 < Max)
-            Intersections.push_back(Intersection<Object>(T0, this));
+            XS.push_back(Intersection<Object>(T0, this));
 
         auto Y1 = RayOrigin.Y() + T1 * RayDirection.Y();
         if (Min < Y1 && Y1 < Max)
-            Intersections.push_back(Intersection<Object>(T1, this));
+            XS.push_back(Intersection<Object>(T1, this));
     }
     else
     {
         auto T = (-C) / (2 * B);
-        Intersections.push_back(Intersection<Object>(T, this));
+        XS.push_back(Intersection<Object>(T, this));
     }
 
     // check intersection with caps
-    IntersectCaps(LocalRay, Intersections);
-
-    return Intersections;
+    IntersectCaps(LocalRay, XS);
 }
 
-bool Cones::CheckCap(const Ray &R, double T, double AbsY)
+bool Cones::CheckCap(const Ray &R, Real T, Real AbsY)
 {
     auto X = R.GetOrigin().X() + T * R.GetDirection().X();
     auto Z = R.GetOrigin().Z() + T * R.GetDirection().Z();
@@ -131,7 +127,7 @@ void Cones::IntersectCaps(const Ray &R, std::vector<Intersection<Object>> &Inter
     if (!Closed || Util::Equal(R.GetDirection().Y(), 0.))
         return;
 
-    double T;
+    Real T;
     // check for an intersection with the lower end cap by intersecting
     // the ray with the plane at y = GetMin()
     T = (Min - R.GetOrigin().Y()) / R.GetDirection().Y();
@@ -48,35 +48,29 @@ Vector Cubes::LocalNormalAt(Point &&LocalPoint)
     return LocalNormalAt(LocalPoint);
 }
 
-std::vector<Intersection<Object>> Cubes::LocalIntersect(const Ray &LocalRay)
+void Cubes::LocalIntersect(const Ray &LocalRay, std::vector<Intersection<Object>> &XS)
 {
-    std::vector<Intersection<Object>> Intersections;
-
     auto XT = CheckAxis(LocalRay.GetOrigin().X(), LocalRay.GetDirection().X(), -1., 1.);
     auto YT = CheckAxis(LocalRay.GetOrigin().Y(), LocalRay.GetDirection().Y(), -1., 1.);
     auto ZT = CheckAxis(LocalRay.GetOrigin().Z(), LocalRay.GetDirection().Z(), -1., 1.);
 
-    std::vector<double> TMinCandidates {XT[0], YT[0], ZT[0]};
-    std::vector<double> TMaxCandidates {XT[1], YT[1], ZT[1]};
-    auto TMin = *std::max_element(TMinCandidates.begin(), TMinCandidates.end());
-    auto TMax = *std::min_element(TMaxCandidates.begin(), TMaxCandidates.end());
+    auto TMin = std::max({XT.first, YT.first, ZT.first});
+    auto TMax = std::min({XT.second, YT.second, ZT.second});
 
     if (TMin > TMax)
-        return Intersections;
-
-    Intersections.push_back(Intersection<Object>(TMin, this));
-    Intersections.push_back(Intersection<Object>(TMax, this));
+        return;
 
-    return Intersections;
+    XS.push_back(Intersection<Object>(TMin, this));
+    XS.push_back(Intersection<Object>(TMax, this));
 }
 
-std::vector<double> CheckAxis(double Origin, double Direction, double Min, double Max)
+std::pair<Real, Real> CheckAxis(Real Origin, Real Direction, Real Min, Real Max)
 {
     // we consider two planes with offset -1 and 1 from origin,
     // respectively.
     auto TMinNumerator = (Min - Origin);
     auto TMaxNumerator = (Max - Origin);
-    double TMin, TMax;
+    Real TMin, TMax;
 
     if (std::abs(Direction) >= Util::EPSILON)
     {
@@ -85,7 +79,7 @@ std::vector<double> CheckAxis(double Origin, double Direction, double Min, doubl
     }
     else
     {
-        auto inf = std::numeric_limits<double>::infinity();
+        auto inf = std::numeric_limits<Real>::infinity();
         TMin = TMinNumerator * inf;
         TMax = TMaxNumerator * inf;
     }
@@ -93,7 +87,7 @@ std::vector<double> CheckAxis(double Origin, double Direction, double Min, doubl
     if (TMin > TMax)
         std::swap(TMin, TMax);
 
-    return std::vector<double> { TMin, TMax };
+    return std::pair<Real, Real> { TMin, TMax };
 }
 
 BoundingBoxes Cubes::BoundsOf()
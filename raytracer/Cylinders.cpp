@@ -18,8 +18,8 @@ Cylinders::Cylinders(int ID)
     AMaterial = Material();
     UseShadow = true;
     this->ID = ID;
-    Min = -std::numeric_limits<double>::max();
-    Max = std::numeric_limits<double>::max();
+    Min = -std::numeric_limits<Real>::max();
+    Max = std::numeric_limits<Real>::max();
     Closed = false;
     Parent = nullptr;
 }
@@ -28,7 +28,7 @@ Cylinders::Cylinders() : Cylinders(0)
 {
 }
 
-Cylinders::Cylinders(double Minimum, double Maximum, bool IsClosed)
+Cylinders::Cylinders(Real Minimum, Real Maximum, bool IsClosed)
 {
     int ID = 0;
     Transform = Matrix::Identity();
@@ -67,10 +67,8 @@ Vector Cylinders::LocalNormalAt(Point &&LocalPoint)
     return LocalNormalAt(LocalPoint);
 }
 
-std::vector<Intersection<Object>> Cylinders::LocalIntersect(const Ray &LocalRay)
+void Cylinders::LocalIntersect(const Ray &LocalRay, std::vector<Intersection<Object>> &XS)
 {
-    std::vector<Intersection<Object>> Intersections;
-
     auto RayDirection = LocalRay.GetDirection();
     auto RayOrigin = LocalRay.GetOrigin();
 
@@ -85,7 +83,7 @@ std::vector<Intersection<Object>> Cylinders::LocalIntersect(const Ray &LocalRay)
         auto Disc = B * B - 4 * A * C;
         // check case: ray does not intersect the cylinder
         if (Disc < 0)
-            return Intersections;
+            return;
 
         auto T0 = (-B - std::sqrt(Disc)) / (2 * A);
         auto T1 = (-B + std::sqrt(Disc)) / (2 * A);
@@ -93,20 +91,18 @@ std::vector<Intersection<Object>> Cylinders::LocalIntersect(const Ray &LocalRay)
 
         auto Y0 = RayOrigin.Y() + T0 * RayDirection.Y();
         if (Min < Y0 && Y0 < Max)
-            Intersections.push_back(Intersection<Object>(T0, this));
+            XS.push_back(Intersection<Object>(T0, this));
 
         auto Y1 = RayOrigin.Y() + T1 * RayDirection.Y();
         if (Min < Y1 && Y1 < Max)
-            Intersections.push_back(Intersection<Object>(T1, this));
+            XS.push_back(Intersection<Object>(T1, this));
     }
 
     // check intersection with caps
-    IntersectCaps(LocalRay, Intersections);
-
-    return Intersections;
+    IntersectCaps(LocalRay, XS);
 }
 
-bool Cylinders::CheckCap(const Ray &R, double T)
+bool Cylinders::CheckCap(const Ray &R, Real T)
 {
     auto X = R.GetOrigin().X() + T * R.GetDirection().X();
     auto Z = R.GetOrigin().Z() + T * R.GetDirection().Z();
@@ -121,7 +117,7 @@ void Cylinders::IntersectCaps(const Ray &R, std::vector<Intersection<Object>> &I
     if (!Closed || Util::Equal(R.GetDirection().Y(), 0.))
         return;
 
-    double T;
+    Real T;
     // check for an intersection with the lower end cap by intersecting
     // the ray with the plane at y = cylinder.GetMin()
     T = (Min - R.GetOrigin().Y()) / R.GetDirection().Y();
@@ -216,8 +212,8 @@ BoundingBoxes Cylinders::BoundsOf()
 // TEST_CASE("The default minimum and maximum for a cylinder")
 // {
 //     Cylinders Cyl;
-//     CHECK(Cyl.GetMin() == -std::numeric_limits<double>::max());
-//     CHECK(Cyl.GetMax() == std::numeric_limits<double>::max());
+//     CHECK(Cyl.GetMin() == -std::numeric_limits<Real>::max());
+//     CHECK(Cyl.GetMax() == std::numeric_limits<Real>::max());
 // }
 
 // TEST_CASE("Intersecting a constrained cylinder")
@@ -7,8 +7,11 @@
 #include "include/Triangles.h"
 #include <vector>
 #include <cmath>
+#include <algorithm>
+#include <utility>
 
-template PreComputations<Object> TRay::PrepareComputations(Intersection<Object> &I, Ray &R, std::vector<Intersection<Object>> IntersectionList);
+template PreComputations<Object> TRay::PrepareComputations(Intersection<Object> &I, Ray &R, const std::vector<Intersection<Object>> &IntersectionList);
+template std::pair<Real, Real> TRay::ComputeRefractiveIndex(const Intersection<Object> &I, const std::vector<Intersection<Object>> &IntersectionList);
 
 Color TRay::PatternAtShape(std::shared_ptr<Pattern> &Pat, Object *Obj, Point &P)
 {
@@ -18,65 +21,46 @@ Color TRay::PatternAtShape(std::shared_ptr<Pattern> &Pat, Object *Obj, Point &P)
 }
 
 template<class OT>
-std::vector<double> TRay::ComputeRefractiveIndex(Intersection<OT> &I, std::vector<Intersection<OT>> IntersectionList)
+std::pair<Real, Real> TRay::ComputeRefractiveIndex(const Intersection<OT> &I,
+    const std::vector<Intersection<OT>> &IntersectionList)
 {
-    std::vector<double> NS;
+    // objects the ray is inside of, innermost last; only the hits up to I
+    // matter, and nesting is shallow, so a linear search is fine
+    thread_local std::vector<OT *> Containers;
+    Containers.clear();
 
-    std::vector<Object*> Containers;
+    auto Outer = [&]() -> Real {
+        return Containers.empty() ? 1. : Containers.back()->GetMaterial().GetRefractiveIndex();
+    };
+
+    if (IntersectionList.empty())
+    {
+        return {1., I.GetObject()->GetMaterial().GetRefractiveIndex()};
+    }
+
+    Real N1 = 1.;
     for (auto &Intersect : IntersectionList)
     {
-        if (Intersect == I)
-        {
-            if (Containers.size() == 0)
-            {
-                NS.push_back(1.);
-            } else
-            {
-                NS.push_back(Containers[Containers.size()-1]->GetMaterial().GetRefractiveIndex());
-            }
-        }
-
-        // search containers for Intersect.GetObject()
-        int ObjectIdx = -1;
-        for (int j = 0; j < Containers.size(); ++j)
-        {
-            if (Containers[j] == Intersect.GetObject())
-            {
-                ObjectIdx = j;
-            }
-        }
-
-        if (ObjectIdx == -1)
-        {
+        bool IsHit = Intersect.GetObject() == I.GetObject() && Intersect.GetT() == I.GetT();
+        if (IsHit)
+            N1 = Outer();
+
+        auto It = std::find(Containers.begin(), Containers.end(), Intersect.GetObject());
+        if (It == Containers.end())
             Containers.push_back(Intersect.GetObject());
-        } else
-        {
-            Containers.erase(Containers.begin() + ObjectIdx);
-        }
-
-        if (Intersect == I)
-        {
-            if (Containers.size() == 0)
-            {
-                NS.push_back(1.);
-            } else
-            {
-                NS.push_back(Containers[Containers.size()-1]->GetMaterial().GetRefractiveIndex());
-            }
-
-            break;
-        }
+        else
+            Containers.erase(It);
+
+        if (IsHit)
+            return {N1, Outer()};
     }
 
-    return NS;
+    return {N1, Outer()};
 }
 
 template<class OT>
-PreComputations<OT> TRay::PrepareComputations(Intersection<OT> &I, Ray &R, std::vector<Intersection<OT>> IntersectionList)
+PreComputations<OT> TRay::PrepareComputations(Intersection<OT> &I, Ray &R, const std::vector<Intersection<OT>> &IntersectionList)
 {
-    if (IntersectionList.size() == 0)
-        IntersectionList.push_back(I);
-
     PreComputations<OT> Comps;
     Comps.T = I.GetT();
     Comps.AObject = I.GetObject();
@@ -91,15 +75,21 @@ PreComputations<OT> TRay::PrepareComputations(Intersection<OT> &I, Ray &R, std::
         Comps.NormalV = -Comps.NormalV;
     }
 
-    Comps.OverPosition = Comps.Position + Comps.NormalV * Util::EPSILON;
-    Comps.UnderPosition = Comps.Position - Comps.NormalV * Util::EPSILON;
+    auto Offset = Util::SurfaceOffset(Comps.Position.X(), Comps.Position.Y(), Comps.Position.Z());
+    Comps.OverPosition = Comps.Position + Comps.NormalV * Offset;
+    Comps.UnderPosition = Comps.Position - Comps.NormalV * Offset;
 
     Comps.ReflectV = R.GetDirection().Reflect(Comps.NormalV);
 
-    // determine N1 and N2
-    auto NS = ComputeRefractiveIndex(I, IntersectionList);
-    Comps.N1 = NS[0];
-    Comps.N2 = NS[1];
+    // determine N1 and N2, only refraction (and Schlick) reads them
+    Comps.N1 = 1.;
+    Comps.N2 = 1.;
+    if (Comps.AObject->GetMaterial().GetTransparency() > 0.)
+    {
+        auto NS = ComputeRefractiveIndex(I, IntersectionList);
+        Comps.N1 = NS.first;
+        Comps.N2 = NS.second;
+    }
 
     return Comps;
 }
@@ -127,27 +117,33 @@ float TRay::Schlick(PreComputations<Object> &Comps)
     return R0 + (1 - R0) * std::pow( (1 - CosI), 5.);
 }
 
-Point TRay::WorldToObject(Object *O, Point &P)
+Point TRay::WorldToObject(Object *O, const Point &P)
 {
-    Point NewPoint = P;
+    if (O->Committed())
+    {
+        return O->GetWorldInverse().Mul(P);
+    }
 
     if (O->GetParent())
     {
-        NewPoint = WorldToObject(O->GetParent(), P);
+        return O->GetTransformInverse().Mul(WorldToObject(O->GetParent(), P));
     }
 
-    return O->GetTransformInverse().Mul(NewPoint);
+    return O->GetTransformInverse().Mul(P);
 }
 
-Vector TRay::NormalToWorld(Object *O, Vector &N)
+Vector TRay::NormalToWorld(Object *O, const Vector &N)
 {
-    auto Normal = O->GetTransformInverse().T().Mul(N);
-    Normal.SetW(0);
-    Normal = Normal.Normalize();
+    if (O->Committed())
+    {
+        return O->GetWorldNormalTransform().Mul(N).Normalize();
+    }
+
+    auto Normal = O->GetNormalTransform().Mul(N).Normalize();
 
     if (O->GetParent())
     {
-        Normal = NormalToWorld(O->GetParent(), Normal);
+        return NormalToWorld(O->GetParent(), Normal);
     }
 
     return Normal;
@@ -36,27 +36,105 @@ int Groups::GetID()
 }
 
 void Groups::AddChild(std::shared_ptr<Object> &S)
+{
+    Attach(S);
+    ChildrenChanged();
+}
+
+void Groups::Attach(std::shared_ptr<Object> &S)
 {
     S->SetParent(this);
     Shapes.push_back(S);
 }
 
-std::vector<Intersection<Object>> Groups::LocalIntersect(const Ray &LocalRay)
+void Groups::ChildrenChanged()
+{
+    // the compiled hierarchy is out of date
+    Object::Uncommit();
+    Compiled.Clear();
+    IsBoundingBoxCached = false;
+
+    auto P = dynamic_cast<Groups *>(Parent);
+    if (P && BVH::Inlined(this))
+        P->ChildrenChanged();
+    else
+        BoundsChanged();
+}
+
+void Groups::ChildBoundsChanged(Object *Child)
 {
-    std::vector<Intersection<Object>> Intersections;
+    IsBoundingBoxCached = false;
+    if (!Compiled.Empty())
+        Compiled.Refit(Child);
+
+    // the hierarchy this group is folded into holds Child as well, one of
+    // its own holds this group
+    if (Parent)
+        Parent->ChildBoundsChanged(BVH::Inlined(this) ? Child : this);
+}
+
+void Groups::LocalIntersect(const Ray &LocalRay, std::vector<Intersection<Object>> &XS)
+{
+    if (!Compiled.Empty())
+    {
+        Compiled.Intersect(LocalRay, XS);
+        return;
+    }
 
     if (BoundsOf().Intersect(LocalRay))
     {
         for (auto &S : Shapes)
         {
-            auto XS = S->Intersect(LocalRay);
-            Intersections.insert(Intersections.end(), XS.begin(), XS.end());
+            S->Intersect(LocalRay, XS);
         }
+    }
+}
+
+bool Groups::LocalClosestHit(const Ray &LocalRay, Real TMin, Real &TMax, Intersection<Object> &Hit)
+{
+    if (!Compiled.Empty())
+        return Compiled.ClosestHit(LocalRay, TMin, TMax, Hit);
+
+    // the box may well start beyond the closest hit found so far
+    auto T = BoundsOf().Intersect(RaySlabs(LocalRay), TMin, TMax);
+    if (T.first > T.second)
+        return false;
 
-        std::sort(Intersections.begin(), Intersections.end());
+    bool Found = false;
+    for (auto &S : Shapes)
+    {
+        if (S->ClosestHit(LocalRay, TMin, TMax, Hit))
+            Found = true;
     }
 
-    return Intersections;
+    return Found;
+}
+
+bool Groups::LocalAnyHit(const Ray &LocalRay, Real TMin, Real TMax)
+{
+    if (!Compiled.Empty())
+        return Compiled.AnyHit(LocalRay, TMin, TMax);
+
+    auto T = BoundsOf().Intersect(RaySlabs(LocalRay), TMin, TMax);
+    if (T.first > T.second)
+        return false;
+
+    for (auto &S : Shapes)
+    {
+        if (S->AnyHit(LocalRay, TMin, TMax))
+            return true;
+    }
+
+    return false;
+}
+
+LaneMask Groups::LocalClosestHits(const RayPacket &LocalPacket, LaneMask Active, Real TMin, Real *TMax,
+                                  Intersection<Object> *Hits)
+{
+    if (!Compiled.Empty())
+        return Compiled.ClosestHits(LocalPacket, Active, TMin, TMax, Hits);
+
+    return Object::LocalClosestHits(LocalPacket, Active, TMin, TMax, Hits);
 }
 
 bool Groups::Include(Object *S)
@@ -69,6 +147,42 @@ bool Groups::Include(Object *S)
     return false;
 }
 
+void Groups::Commit()
+{
+    CommitTree();
+    if (Compiled.Empty())
+        Compiled.Build(*this);
+}
+
+// commit this group and its children; subgroups folded into the hierarchy
+// compiled above do not build one of their own
+void Groups::CommitTree()
+{
+    Object::Commit();
+
+    for (auto &Child: Shapes)
+    {
+        // children shared with another group (through Clone) only need it once
+        if (Child->Committed() && Child->GetParent() != this)
+            continue;
+        if (auto G = BVH::Inlined(Child.get()))
+            G->CommitTree();
+        else
+            Child->Commit();
+    }
+}
+
+void Groups::Uncommit()
+{
+    // the hierarchy is in the space of the group, it outlives a new transform
+    Object::Uncommit();
+
+    for (auto &Child: Shapes)
+    {
+        Child->Uncommit();
+    }
+}
+
 BoundingBoxes Groups::BoundsOf()
 {
     // need to cache the box
@@ -97,30 +211,29 @@ std::pair<std::vector<std::shared_ptr<Object>>, std::vector<std::shared_ptr<Obje
 
     std::vector<std::shared_ptr<Object>> Left {};
     std::vector<std::shared_ptr<Object>> Right {};
+    std::vector<std::shared_ptr<Object>> Remaining {};
 
-    // loop using iterator so we can delete element in the list while iterating
-    auto It = Shapes.begin();
-    while (It != Shapes.end())
+    // one pass, erasing from Shapes one child at a time is quadratic
+    for (auto &S : Shapes)
     {
-        auto S = *It;
         auto Bounds = S->ParentSpaceBoundsOf();
         if (LeftBox.ContainsBox(Bounds))
         {
             Left.push_back(S);
             S->SetParent(nullptr);
-            It = Shapes.erase(It);
         }
         else if (RightBox.ContainsBox(Bounds))
         {
             Right.push_back(S);
             S->SetParent(nullptr);
-            It = Shapes.erase(It);
         }
         else
         {
-            ++It;
+            Remaining.push_back(S);
         }
     }
+    Shapes.swap(Remaining);
+    ChildrenChanged();
 
     return std::pair<std::vector<std::shared_ptr<Object>>, std::vector<std::shared_ptr<Object>>> {Left, Right};
 }
@@ -160,6 +273,99 @@ void Groups::Divide(int Threshold)
     }
 }
 
+struct Groups::BuildItem
+{
+    std::shared_ptr<Object> Shape;
+    BoundingBoxes Box;
+    Point Centroid;
+};
+
+using namespace BVHBuild;
+
+void Groups::BuildHierarchy(std::vector<BuildItem> &Items, std::size_t Begin, std::size_t End, const BVHCost &Cost, int Threads)
+{
+    // the boxes are known already, no need to transform them back from the
+    // children (subgroups have no transform)
+    BoundingBoxes Box;
+    for (auto i = Begin; i < End; ++i)
+    {
+        Box.AddBox(Items[i].Box);
+    }
+    BoxCache = Box;
+    IsBoundingBoxCached = true;
+
+    auto Mid = End - Begin > 1 ? SplitItems(Items, Begin, End, Box, Cost) : End;
+    if (Mid == End)
+    {
+        for (auto i = Begin; i < End; ++i)
+        {
+            Attach(Items[i].Shape);
+        }
+        return;
+    }
+
+    // subgroups are added before they are filled, so that adding them does
+    // not uncommit a whole subtree; a large left half is a task of its own
+    ThreadPool::TaskGroup Pending{ThreadPool::shared()};
+    bool Spawned = false;
+    for (auto Range : {std::make_pair(Begin, Mid), std::make_pair(Mid, End)})
+    {
+        if (Range.second - Range.first == 1)
+        {
+            Attach(Items[Range.first].Shape);
+            continue;
+        }
+        auto Child = std::make_shared<Groups>();
+        std::shared_ptr<Object> ChildObj = Child;
+        Attach(ChildObj);
+        if (Threads > 1 && !Spawned && Range.second - Range.first >= ParallelGrain)
+        {
+            Spawned = true;
+            Pending.run([=, &Items, &Cost]() {
+                Child->BuildHierarchy(Items, Range.first, Range.second, Cost, Threads - Threads / 2);
+            });
+        }
+        else
+        {
+            Child->BuildHierarchy(Items, Range.first, Range.second, Cost, Spawned ? Threads / 2 : Threads);
+        }
+    }
+    Pending.wait();
+}
+
+void Groups::Divide(const BVHCost &Cost)
+{
+    for (auto &S: Shapes)
+    {
+        S->Divide(Cost);
+    }
+
+    // bounds and centroids are computed once, the build only moves items
+    std::vector<BuildItem> Items(Shapes.size());
+    ParallelFor(Shapes.size(), Cost.Threads, [&](std::size_t i) {
+        auto Box = Shapes[i]->ParentSpaceBoundsOf();
+        Items[i] = {Shapes[i], Box, Box.Centroid()};
+    });
+
+    // infinite children (planes) cannot be binned, they stay on this group
+    auto Bounded = std::stable_partition(Items.begin(), Items.end(), [](const BuildItem &Item) {
+        return Item.Box.IsBounded();
+    });
+    if (Bounded - Items.begin() <= 1)
+        return;
+
+    Shapes.clear();
+    for (auto It = Bounded; It != Items.end(); ++It)
+    {
+        Attach(It->Shape);
+    }
+    Items.erase(Bounded, Items.end());
+    BuildHierarchy(Items, 0, Items.size(), Cost, Cost.Threads);
+
+    ChildrenChanged();
+    BoundsOf();
+}
+
 // TEST_CASE("Creating a new group")
 // {
 //     Groups G;
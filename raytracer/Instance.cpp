@@ -0,0 +1,95 @@
+#include <memory>
+#include <vector>
+#include "include/Instance.h"
+#include "include/Ray.h"
+#include "include/Intersection.h"
+#include "include/Functions.h"
+
+Instance::Instance(int ID)
+{
+    Transform = Matrix::Identity(4);
+    TransformInverse = Matrix::Identity(4);
+    Origin = Point(0., 0., 0.);
+    AMaterial = Material();
+    UseShadow = true;
+    this->ID = ID;
+    Parent = nullptr;
+}
+
+Instance::Instance() : Instance(0)
+{
+}
+
+Instance::Instance(const std::shared_ptr<Object> &Proto) : Instance(0)
+{
+    Prototype = Proto;
+}
+
+int Instance::GetID()
+{
+    return ID;
+}
+
+Vector Instance::NormalAt(Point &P, Intersection<Object> &I)
+{
+    // the prototype has no parent, its world space is the local space of
+    // the instance
+    auto LocalPoint = TRay::WorldToObject(this, P);
+    Intersection<Object> InnerHit(I.GetT(), I.GetInner(), I.GetU(), I.GetV(), I.GetIndex());
+    auto LocalNormal = I.GetInner()->NormalAt(LocalPoint, InnerHit);
+    return TRay::NormalToWorld(this, LocalNormal);
+}
+
+void Instance::LocalIntersect(const Ray &LocalRay, std::vector<Intersection<Object>> &XS)
+{
+    auto First = XS.size();
+    Prototype->Intersect(LocalRay, XS);
+    for (auto i = First; i < XS.size(); ++i)
+    {
+        XS[i].SetInstance(this);
+    }
+}
+
+bool Instance::LocalClosestHit(const Ray &LocalRay, Real TMin, Real &TMax, Intersection<Object> &Hit)
+{
+    if (!Prototype->ClosestHit(LocalRay, TMin, TMax, Hit))
+        return false;
+
+    Hit.SetInstance(this);
+    return true;
+}
+
+bool Instance::LocalAnyHit(const Ray &LocalRay, Real TMin, Real TMax)
+{
+    return ShadowOn() && Prototype->AnyHit(LocalRay, TMin, TMax);
+}
+
+LaneMask Instance::LocalClosestHits(const RayPacket &LocalPacket, LaneMask Active, Real TMin, Real *TMax,
+                                    Intersection<Object> *Hits)
+{
+    auto Found = Prototype->ClosestHits(LocalPacket, Active, TMin, TMax, Hits);
+    for (int i = 0; i < LocalPacket.GetSize(); ++i)
+    {
+        if (Found >> i & 1)
+            Hits[i].SetInstance(this);
+    }
+    return Found;
+}
+
+void Instance::Commit()
+{
+    Object::Commit();
+
+    if (!Prototype->Committed())
+        Prototype->Commit();
+}
+
+BoundingBoxes Instance::BoundsOf()
+{
+    if (!IsBoundingBoxCached)
+    {
+        BoxCache = Prototype->ParentSpaceBoundsOf();
+        IsBoundingBoxCached = true;
+    }
+    return BoxCache;
+}
@@ -55,7 +55,7 @@ Color Lighting(Material &M, Object *Obj, Light &L, Point &Pos, Vector &EyeV, Vec
         // reflection vector and the eye vector.
         // A negative value means the light reflects away from the eye.
         auto ReflectV = (-LightV).Reflect(NormalV);
-        double ReflectDotEye = ReflectV.Dot(EyeV);
+        Real ReflectDotEye = ReflectV.Dot(EyeV);
 
         if (ReflectDotEye > 0.)
         {
@@ -14,7 +14,7 @@ Material::Material()
     RefractiveIndex = 1.;
 }
 
-Material::Material(Color &C, double Amb, double Dif, double Spec, double Shini)
+Material::Material(Color &C, Real Amb, Real Dif, Real Spec, Real Shini)
 {
     AColor = C;
     Ambient = Amb;
@@ -27,7 +27,7 @@ Material::Material(Color &C, double Amb, double Dif, double Spec, double Shini)
     RefractiveIndex = 1.;
 }
 
-Material::Material(Color &&C, double Amb, double Dif, double Spec, double Shini) : Material(C, Amb, Dif, Spec, Shini)
+Material::Material(Color &&C, Real Amb, Real Dif, Real Spec, Real Shini) : Material(C, Amb, Dif, Spec, Shini)
 {
 }
 
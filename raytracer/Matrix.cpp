@@ -1,28 +1,37 @@
 #include <iostream>
 #include <exception>
 #include <stdexcept>
-#include <vector>
 #include <string>
 #include <cmath>
 #include "include/Util.h"
 #include "include/Matrix.h"
 #include "include/Point.h"
 #include "include/Tuple.h"
+#include "include/SIMD.h"
 
-Matrix::Matrix() {}
+Matrix::Matrix() : Matrix(MAX_SIZE, MAX_SIZE, 0.) {}
 
-Matrix::Matrix(int NumRows, int NumCols, double Val)
+Matrix::Matrix(int NumRows, int NumCols, Real Val)
 {
+    if (NumRows < 0 || NumRows > MAX_SIZE || NumCols < 0 || NumCols > MAX_SIZE)
+        throw std::invalid_argument("Matrix dimensions must be at most 4x4.");
+
     numRows = NumRows;
     numCols = NumCols;
-    m = std::vector<std::vector<double>>(numRows, std::vector<double>(numCols, Val));
+    for (int r = 0; r < MAX_SIZE; ++r)
+    {
+        for (int c = 0; c < MAX_SIZE; ++c)
+        {
+            m[r][c] = (r < numRows && c < numCols) ? Val : 0.;
+        }
+    }
 }
 
 Matrix::Matrix(int NumRows, int NumCols) : Matrix(NumRows, NumCols, 0.)
 {
 }
 
-Matrix::Matrix(double X, double Y, double Z, double W) : Matrix(4, 1, 0.)
+Matrix::Matrix(Real X, Real Y, Real Z, Real W) : Matrix(4, 1, 0.)
 {
     m[0][0] = X;
     m[1][0] = Y;
@@ -145,29 +154,76 @@ Matrix operator/(const Matrix &LHS, const Matrix &RHS)
     return Res;
 }
 
-// template<class Derived>
-// Derived Matrix::Mul(const Derived &RHS)
-// {
-//     static_assert(std::is_base_of<Matrix, Derived>::value, "Derived not derived from Matrix");
-
-//     if (this->GetNumCols() != RHS.GetNumRows())
-//         throw std::invalid_argument("LHS matrix's rows must match RHS matrix's columns.");
-
-//     int Dim = this->GetNumCols();
-
-//     Derived Res(this->GetNumRows(), RHS.GetNumCols());
-//     for (int r = 0; r < Res.GetNumRows(); ++r)
-//     {
-//         for (int c = 0; c < Res.GetNumCols(); ++c)
-//         {
-//             for (int i = 0; i < Dim; ++i)
-//             {
-//                 Res(r, c) += this->At(r, i) * RHS.At(i, c);
-//             }
-//         }
-//     }
-//     return Res;
-// }
+Matrix Matrix::Mul(const Matrix &RHS) const
+{
+    if (numCols != RHS.GetNumRows())
+        throw std::invalid_argument("LHS matrix's rows must match RHS matrix's columns.");
+
+    Matrix Res(numRows, RHS.GetNumCols());
+    for (int r = 0; r < numRows; ++r)
+    {
+        for (int c = 0; c < RHS.GetNumCols(); ++c)
+        {
+            Real Sum = 0.;
+            for (int i = 0; i < numCols; ++i)
+            {
+                Sum += m[r][i] * RHS.m[i][c];
+            }
+            Res.m[r][c] = Sum;
+        }
+    }
+    return Res;
+}
+
+Point Matrix::Mul(const Point &P) const
+{
+    return SIMD::TransformPoint(*this, P);
+}
+
+Vector Matrix::Mul(const Vector &V) const
+{
+    return SIMD::TransformVector(*this, V);
+}
+
+Tuple Matrix::Mul(const Tuple &T) const
+{
+    return Tuple(m[0][0] * T.X() + m[0][1] * T.Y() + m[0][2] * T.Z() + m[0][3] * T.W(),
+                 m[1][0] * T.X() + m[1][1] * T.Y() + m[1][2] * T.Z() + m[1][3] * T.W(),
+                 m[2][0] * T.X() + m[2][1] * T.Y() + m[2][2] * T.Z() + m[2][3] * T.W(),
+                 m[3][0] * T.X() + m[3][1] * T.Y() + m[3][2] * T.Z() + m[3][3] * T.W());
+}
+
+namespace
+{
+    // The 2x2 determinants of the top two rows (S) and the bottom two rows (C)
+    // of a 4x4 matrix. Laplace expansion along the first two rows expresses the
+    // 4x4 determinant and every 3x3 cofactor in terms of these twelve values,
+    // which gives a closed-form inverse without any recursion or submatrices.
+    struct Det2x2
+    {
+        Real S[6];
+        Real C[6];
+    };
+
+    inline Det2x2 Det2x2Blocks(const Matrix &A)
+    {
+        Det2x2 D;
+        D.S[0] = A.At(0, 0) * A.At(1, 1) - A.At(1, 0) * A.At(0, 1);
+        D.S[1] = A.At(0, 0) * A.At(1, 2) - A.At(1, 0) * A.At(0, 2);
+        D.S[2] = A.At(0, 0) * A.At(1, 3) - A.At(1, 0) * A.At(0, 3);
+        D.S[3] = A.At(0, 1) * A.At(1, 2) - A.At(1, 1) * A.At(0, 2);
+        D.S[4] = A.At(0, 1) * A.At(1, 3) - A.At(1, 1) * A.At(0, 3);
+        D.S[5] = A.At(0, 2) * A.At(1, 3) - A.At(1, 2) * A.At(0, 3);
+
+        D.C[0] = A.At(2, 0) * A.At(3, 1) - A.At(3, 0) * A.At(2, 1);
+        D.C[1] = A.At(2, 0) * A.At(3, 2) - A.At(3, 0) * A.At(2, 2);
+        D.C[2] = A.At(2, 0) * A.At(3, 3) - A.At(3, 0) * A.At(2, 3);
+        D.C[3] = A.At(2, 1) * A.At(3, 2) - A.At(3, 1) * A.At(2, 2);
+        D.C[4] = A.At(2, 1) * A.At(3, 3) - A.At(3, 1) * A.At(2, 3);
+        D.C[5] = A.At(2, 2) * A.At(3, 3) - A.At(3, 2) * A.At(2, 3);
+        return D;
+    }
+}
 
 Matrix Matrix::Identity(int Size)
 {
@@ -184,7 +240,7 @@ Matrix Matrix::Identity()
     return Identity(4);
 }
 
-Matrix Matrix::T()
+Matrix Matrix::T() const
 {
     Matrix Res(numCols, numRows);
     for (int r = 0; r < numRows; ++r)
@@ -198,7 +254,7 @@ Matrix Matrix::T()
     return Res;
 }
 
-double Matrix::Determinant()
+Real Matrix::Determinant() const
 {
     if (numRows != numCols)
         throw std::invalid_argument("only square matrix has determinant");
@@ -209,9 +265,15 @@ double Matrix::Determinant()
     {
         return this->At(0, 0) * this->At(1, 1) - this->At(0, 1) * this->At(1, 0);
     }
+    else if (numRows == 4)
+    {
+        auto D = Det2x2Blocks(*this);
+        return D.S[0] * D.C[5] - D.S[1] * D.C[4] + D.S[2] * D.C[3]
+             + D.S[3] * D.C[2] - D.S[4] * D.C[1] + D.S[5] * D.C[0];
+    }
     else
     {
-        double Det = 0.;
+        Real Det = 0.;
         for (int c = 0; c < numCols; ++c)
         {
             Det += this->At(0, c) * Cofactor(0, c);
@@ -220,7 +282,7 @@ double Matrix::Determinant()
     }
 }
 
-Matrix Matrix::Submatrix(int RowRemoved, int ColRemoved)
+Matrix Matrix::Submatrix(int RowRemoved, int ColRemoved) const
 {
     if (!IsValid(RowRemoved, ColRemoved))
         throw std::invalid_argument("Invalid Row or Col value");
@@ -246,31 +308,61 @@ Matrix Matrix::Submatrix(int RowRemoved, int ColRemoved)
     return Res;
 }
 
-double Matrix::Minor(int Row, int Col)
+Real Matrix::Minor(int Row, int Col) const
 {
     return Submatrix(Row, Col).Determinant();
 }
 
-double Matrix::Cofactor(int Row, int Col)
+Real Matrix::Cofactor(int Row, int Col) const
 {
-    double Minor = Submatrix(Row, Col).Determinant();
+    Real Minor = Submatrix(Row, Col).Determinant();
     if ((Row + Col) % 2 == 1) return -Minor;
     return Minor;
 }
 
-bool Matrix::IsInvertible()
+bool Matrix::IsInvertible() const
 {
     return Determinant() != 0;
 }
 
-Matrix Matrix::Inverse()
+Matrix Matrix::Inverse() const
 {
-    double Det = Determinant();
-    if (Util::Equal(Det, 0.))
+    Real Det = Determinant();
+    if (Det == 0)
         throw std::invalid_argument("this matrix is not invertible");
 
     Matrix Res(numRows, numCols);
 
+    if (numRows == 4)
+    {
+        auto D = Det2x2Blocks(*this);
+        const auto &S = D.S;
+        const auto &C = D.C;
+        const auto &a = m;
+
+        Res.m[0][0] = ( a[1][1] * C[5] - a[1][2] * C[4] + a[1][3] * C[3]) / Det;
+        Res.m[0][1] = (-a[0][1] * C[5] + a[0][2] * C[4] - a[0][3] * C[3]) / Det;
+        Res.m[0][2] = ( a[3][1] * S[5] - a[3][2] * S[4] + a[3][3] * S[3]) / Det;
+        Res.m[0][3] = (-a[2][1] * S[5] + a[2][2] * S[4] - a[2][3] * S[3]) / Det;
+
+        Res.m[1][0] = (-a[1][0] * C[5] + a[1][2] * C[2] - a[1][3] * C[1]) / Det;
+        Res.m[1][1] = ( a[0][0] * C[5] - a[0][2] * C[2] + a[0][3] * C[1]) / Det;
+        Res.m[1][2] = (-a[3][0] * S[5] + a[3][2] * S[2] - a[3][3] * S[1]) / Det;
+        Res.m[1][3] = ( a[2][0] * S[5] - a[2][2] * S[2] + a[2][3] * S[1]) / Det;
+
+        Res.m[2][0] = ( a[1][0] * C[4] - a[1][1] * C[2] + a[1][3] * C[0]) / Det;
+        Res.m[2][1] = (-a[0][0] * C[4] + a[0][1] * C[2] - a[0][3] * C[0]) / Det;
+        Res.m[2][2] = ( a[3][0] * S[4] - a[3][1] * S[2] + a[3][3] * S[0]) / Det;
+        Res.m[2][3] = (-a[2][0] * S[4] + a[2][1] * S[2] - a[2][3] * S[0]) / Det;
+
+        Res.m[3][0] = (-a[1][0] * C[3] + a[1][1] * C[1] - a[1][2] * C[0]) / Det;
+        Res.m[3][1] = ( a[0][0] * C[3] - a[0][1] * C[1] + a[0][2] * C[0]) / Det;
+        Res.m[3][2] = (-a[3][0] * S[3] + a[3][1] * S[1] - a[3][2] * S[0]) / Det;
+        Res.m[3][3] = ( a[2][0] * S[3] - a[2][1] * S[1] + a[2][2] * S[0]) / Det;
+
+        return Res;
+    }
+
     for (int r = 0; r < numRows; ++r)
     {
         for (int c = 0; c < numCols; ++c)
@@ -282,7 +374,7 @@ Matrix Matrix::Inverse()
     return Res;
 }
 
-Matrix Matrix::Translation(double X, double Y, double Z)
+Matrix Matrix::Translation(Real X, Real Y, Real Z)
 {
     Matrix Res = Identity(4);
     Res(0, 3) = X;
@@ -291,7 +383,7 @@ Matrix Matrix::Translation(double X, double Y, double Z)
     return Res;
 }
 
-Matrix Matrix::Scaling(double X, double Y, double Z)
+Matrix Matrix::Scaling(Real X, Real Y, Real Z)
 {
     Matrix Res = Identity(4);
     Res(0, 0) = X;
@@ -300,11 +392,11 @@ Matrix Matrix::Scaling(double X, double Y, double Z)
     return Res;
 }
 
-Matrix Matrix::RotationX(double Rad)
+Matrix Matrix::RotationX(Real Rad)
 {
     Matrix Res = Identity(4);
-    double Sin = std::sin(Rad);
-    double Cos = std::cos(Rad);
+    Real Sin = std::sin(Rad);
+    Real Cos = std::cos(Rad);
     Res(1, 1) = Cos;
     Res(1, 2) = -Sin;
     Res(2, 1) = Sin;
@@ -312,11 +404,11 @@ Matrix Matrix::RotationX(double Rad)
     return Res;
 }
 
-Matrix Matrix::RotationY(double Rad)
+Matrix Matrix::RotationY(Real Rad)
 {
     Matrix Res = Identity(4);
-    double Sin = std::sin(Rad);
-    double Cos = std::cos(Rad);
+    Real Sin = std::sin(Rad);
+    Real Cos = std::cos(Rad);
     Res(0, 0) = Cos;
     Res(0, 2) = Sin;
     Res(2, 0) = -Sin;
@@ -324,11 +416,11 @@ Matrix Matrix::RotationY(double Rad)
     return Res;
 }
 
-Matrix Matrix::RotationZ(double Rad)
+Matrix Matrix::RotationZ(Real Rad)
 {
     Matrix Res = Identity(4);
-    double Sin = std::sin(Rad);
-    double Cos = std::cos(Rad);
+    Real Sin = std::sin(Rad);
+    Real Cos = std::cos(Rad);
     Res(0, 0) = Cos;
     Res(0, 1) = -Sin;
     Res(1, 0) = Sin;
@@ -336,7 +428,7 @@ Matrix Matrix::RotationZ(double Rad)
     return Res;
 }
 
-Matrix Matrix::Shearing(double XY, double XZ, double YX, double YZ, double ZX, double ZY)
+Matrix Matrix::Shearing(Real XY, Real XZ, Real YX, Real YZ, Real ZX, Real ZY)
 {
     Matrix Res = Identity(4);
     Res(0, 1) = XY;
@@ -348,31 +440,31 @@ Matrix Matrix::Shearing(double XY, double XZ, double YX, double YZ, double ZX, d
     return Res;
 }
 
-Matrix Matrix::Translate(double X, double Y, double Z)
+Matrix Matrix::Translate(Real X, Real Y, Real Z) const
 {
     return Translation(X, Y, Z).Mul(*this);
 }
 
-Matrix Matrix::Scale(double X, double Y, double Z)
+Matrix Matrix::Scale(Real X, Real Y, Real Z) const
 {
     return Scaling(X, Y, Z).Mul(*this);
 }
 
-Matrix Matrix::RotateX(double Rad)
+Matrix Matrix::RotateX(Real Rad) const
 {
     return RotationX(Rad).Mul(*this);
 }
 
-Matrix Matrix::RotateY(double Rad)
+Matrix Matrix::RotateY(Real Rad) const
 {
     return RotationY(Rad).Mul(*this);
 }
-Matrix Matrix::RotateZ(double Rad)
+Matrix Matrix::RotateZ(Real Rad) const
 {
     return RotationZ(Rad).Mul(*this);
 }
 
-Matrix Matrix::Shear(double XY, double XZ, double YX, double YZ, double ZX, double ZY)
+Matrix Matrix::Shear(Real XY, Real XZ, Real YX, Real YZ, Real ZX, Real ZY) const
 {
     return Shearing(XY, XZ, YX, YZ, ZX, ZY).Mul(*this);
 }
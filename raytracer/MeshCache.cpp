@@ -0,0 +1,282 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <system_error>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "include/MeshCache.h"
+#include "include/SIMD.h"
+
+namespace
+{
+    const char Magic[8] = {'R', 'T', 'M', 'E', 'S', 'H', '\0', '\0'};
+    // every buffer starts on a multiple of this, as mapped from the file
+    const std::size_t Alignment = 64;
+    const int BufferCount = 11;
+
+    // the file starts with this, followed by the buffers
+    struct Header
+    {
+        char Magic[8];
+        uint32_t Version;
+        uint32_t RealSize;
+        uint32_t BlockWidth;
+        // 1 when some triangles are in several leaves
+        uint32_t Flags;
+        // elements in each buffer
+        uint64_t Counts[BufferCount];
+    };
+
+    std::size_t Aligned(std::size_t Size)
+    {
+        return (Size + Alignment - 1) / Alignment * Alignment;
+    }
+
+    // 64-bit FNV-1a
+    class Hash
+    {
+        uint64_t State = 14695981039346656037ull;
+
+    public:
+        void Add(const void *Data, std::size_t Size)
+        {
+            auto Bytes = static_cast<const unsigned char *>(Data);
+            for (std::size_t i = 0; i < Size; ++i)
+            {
+                State ^= Bytes[i];
+                State *= 1099511628211ull;
+            }
+        }
+
+        template <class T>
+        void Add(const T &Value)
+        {
+            Add(&Value, sizeof(Value));
+        }
+
+        uint64_t Value() const { return State; }
+    };
+
+    // read-only mapping of a whole file, empty when it cannot be mapped
+    class Mapping
+    {
+        void *Data = MAP_FAILED;
+        std::size_t Size = 0;
+
+    public:
+        explicit Mapping(const std::filesystem::path &Path)
+        {
+            auto File = open(Path.c_str(), O_RDONLY);
+            if (File < 0)
+                return;
+            struct stat Info;
+            if (fstat(File, &Info) == 0 && Info.st_size > 0)
+            {
+                Size = Info.st_size;
+                Data = mmap(nullptr, Size, PROT_READ, MAP_PRIVATE, File, 0);
+            }
+            close(File);
+        }
+
+        ~Mapping()
+        {
+            if (Data != MAP_FAILED)
+                munmap(Data, Size);
+        }
+
+        Mapping(const Mapping &) = delete;
+        Mapping &operator=(const Mapping &) = delete;
+
+        const char *Bytes() const { return Data == MAP_FAILED ? nullptr : static_cast<const char *>(Data); }
+        std::size_t Length() const { return Data == MAP_FAILED ? 0 : Size; }
+    };
+}
+
+template <class Mesh, class Fn>
+void MeshCache::ForEachBuffer(Mesh &M, Fn F)
+{
+    for (auto &V : M.Vertices)
+        F(V);
+    for (auto &N : M.Normals)
+        F(N);
+    F(M.VertexIndices);
+    F(M.NormalIndices);
+    F(M.Nodes);
+    F(M.Order);
+    F(M.Blocks);
+}
+
+MeshCache::MeshCache(const std::filesystem::path &Dir) : Directory(Dir)
+{
+}
+
+std::string MeshCache::Key(const std::filesystem::path &Path, bool Smoothing, const BVHCost &Cost)
+{
+    std::ifstream File(Path, std::ios::binary);
+    if (!File)
+        throw std::invalid_argument("cannot read " + Path.string());
+
+    Hash H;
+    std::vector<char> Chunk(1 << 20);
+    while (File)
+    {
+        File.read(Chunk.data(), Chunk.size());
+        H.Add(Chunk.data(), File.gcount());
+    }
+
+    // everything else the built mesh depends on (not the threads, the build
+    // is the same on any number of them)
+    H.Add(Version);
+    H.Add(sizeof(Real));
+    H.Add(TriangleBlock::Width);
+    H.Add(Smoothing);
+    H.Add(Cost.Traversal);
+    H.Add(Cost.Intersection);
+    H.Add(Cost.MaxLeafSize);
+    H.Add(Cost.Bins);
+    H.Add(Cost.SpatialSplits);
+    H.Add(Cost.DuplicateBudget);
+
+    char Name[17];
+    snprintf(Name, sizeof(Name), "%016llx", static_cast<unsigned long long>(H.Value()));
+    return Name;
+}
+
+std::filesystem::path MeshCache::PathOf(const std::string &Key) const
+{
+    return Directory / (Key + ".rtmesh");
+}
+
+std::shared_ptr<TriangleMesh> MeshCache::Load(const std::string &Key) const
+{
+    Mapping File(PathOf(Key));
+    if (File.Length() < sizeof(Header))
+        return nullptr;
+
+    Header Head;
+    std::memcpy(&Head, File.Bytes(), sizeof(Header));
+    if (std::memcmp(Head.Magic, Magic, sizeof(Magic)) != 0 || Head.Version != Version ||
+        Head.RealSize != sizeof(Real) || Head.BlockWidth != TriangleBlock::Width)
+        return nullptr;
+
+    // the buffers must fill the file exactly
+    auto Mesh = std::make_shared<TriangleMesh>();
+    std::size_t Offset = Aligned(sizeof(Header));
+    int Buffer = 0;
+    bool Fits = true;
+    ForEachBuffer(*Mesh, [&](auto &V) {
+        auto Count = Head.Counts[Buffer++];
+        auto Size = Count * sizeof(V[0]);
+        if (!Fits || Count > File.Length() || Offset + Size > File.Length())
+        {
+            Fits = false;
+            return;
+        }
+        V.resize(Count);
+        std::memcpy(V.data(), File.Bytes() + Offset, Size);
+        Offset = Aligned(Offset + Size);
+    });
+    if (!Fits || Offset != Aligned(File.Length()))
+        return nullptr;
+
+    auto Triangles = Mesh->VertexIndices.size();
+    if (Triangles % 3 != 0 || (!Mesh->NormalIndices.empty() && Mesh->NormalIndices.size() != Triangles) ||
+        Mesh->Order.size() != Mesh->Blocks.size() * TriangleBlock::Width)
+        return nullptr;
+    for (int a = 1; a < 3; ++a)
+    {
+        if (Mesh->Vertices[a].size() != Mesh->Vertices[0].size() || Mesh->Normals[a].size() != Mesh->Normals[0].size())
+            return nullptr;
+    }
+
+    // and every index must stay in its buffer, a damaged file must not crash
+    // the render later
+    for (auto Index : Mesh->VertexIndices)
+    {
+        if (Index >= Mesh->VertexCount())
+            return nullptr;
+    }
+    for (auto Index : Mesh->NormalIndices)
+    {
+        if (Index != TriangleMesh::Flat && Index >= Mesh->NormalCount())
+            return nullptr;
+    }
+    for (auto Triangle : Mesh->Order)
+    {
+        if (Triangle >= Mesh->TriangleCount())
+            return nullptr;
+    }
+    for (std::size_t i = 0; i < Mesh->Nodes.size(); ++i)
+    {
+        auto &N = Mesh->Nodes[i];
+        bool Valid = N.Count > 0 ? N.Offset <= Mesh->Order.size() && N.Count <= Mesh->Order.size() - N.Offset
+                                 : N.Offset > i + 1 && N.Offset < Mesh->Nodes.size();
+        if (!Valid)
+            return nullptr;
+    }
+    // nor may the tree be deeper than the traversal stack (see Divide); the
+    // children of a node come after it, so the depths are known backwards
+    std::vector<int> Depths(Mesh->Nodes.size());
+    for (auto i = Mesh->Nodes.size(); i-- > 0;)
+    {
+        auto &N = Mesh->Nodes[i];
+        Depths[i] = N.Count > 0 ? 1 : std::max(Depths[i + 1], Depths[N.Offset]) + 1;
+        if (Depths[i] > BVH::StackSize)
+            return nullptr;
+    }
+
+    Mesh->SplitTriangles = Head.Flags & 1;
+    return Mesh;
+}
+
+bool MeshCache::Store(const std::string &Key, const TriangleMesh &Mesh) const
+{
+    Header Head = {};
+    std::memcpy(Head.Magic, Magic, sizeof(Magic));
+    Head.Version = Version;
+    Head.RealSize = sizeof(Real);
+    Head.BlockWidth = TriangleBlock::Width;
+    Head.Flags = Mesh.SplitTriangles ? 1 : 0;
+    int Buffer = 0;
+    ForEachBuffer(Mesh, [&](auto &V) { Head.Counts[Buffer++] = V.size(); });
+
+    // written aside and renamed, so that a run reading the cache never sees
+    // half a file
+    std::error_code Error;
+    std::filesystem::create_directories(Directory, Error);
+    auto Temporary = PathOf(Key);
+    Temporary += "." + std::to_string(getpid());
+    {
+        std::ofstream File(Temporary, std::ios::binary | std::ios::trunc);
+        if (!File)
+            return false;
+
+        const char Padding[Alignment] = {};
+        std::size_t Offset = 0;
+        auto Write = [&](const void *Data, std::size_t Size) {
+            File.write(static_cast<const char *>(Data), Size);
+            Offset += Size;
+            File.write(Padding, Aligned(Offset) - Offset);
+            Offset = Aligned(Offset);
+        };
+        Write(&Head, sizeof(Head));
+        ForEachBuffer(Mesh, [&](auto &V) { Write(V.data(), V.size() * sizeof(V[0])); });
+        if (!File.flush())
+        {
+            std::filesystem::remove(Temporary, Error);
+            return false;
+        }
+    }
+
+    std::filesystem::rename(Temporary, PathOf(Key), Error);
+    if (Error)
+    {
+        std::filesystem::remove(Temporary, Error);
+        return false;
+    }
+    return true;
+}
@@ -3,8 +3,11 @@
 #include <string>
 #include <exception>
 #include <stdexcept>
+#include <algorithm>
+#include <iterator>
 #include "include/ObjParser.h"
 #include "include/Triangles.h"
+#include "threadpool.h"
 
 ObjParser::ObjParser(std::string F, bool Smoothing)
 {
@@ -12,11 +15,11 @@ ObjParser::ObjParser(std::string F, bool Smoothing)
     Normals = std::vector<Vector>();
     IgnoredLines = 0;
     Filename = F;
-    TriGroups = std::unordered_map<std::string, std::vector<Triangles>>();
-    STriGroups = std::unordered_map<std::string, std::vector<SmoothTriangles>>();
+    TriGroups = std::unordered_map<std::string, std::vector<FaceTriangle>>();
+    STriGroups = std::unordered_map<std::string, std::vector<FaceTriangle>>();
     LatestGroup = "Default";
-    TriGroups["Default"] = std::vector<Triangles>();
-    STriGroups["Default"] = std::vector<SmoothTriangles>();
+    TriGroups["Default"] = std::vector<FaceTriangle>();
+    STriGroups["Default"] = std::vector<FaceTriangle>();
     this->Smoothing = Smoothing;
 }
 
@@ -60,52 +63,156 @@ void ObjParser::ParseFace(std::vector<int> &VIndices, std::vector<int> &TIndices
         return;
 }
 
+namespace
+{
+    // files smaller than this are parsed in one part
+    const std::size_t MinChunkSize = 1 << 20;
+}
+
+struct ObjParser::ParsedChunk
+{
+    // kind of every line used, in file order: 'v', 'n', 'f' or 'g'
+    std::string Kinds;
+    std::vector<Point> Vertices;
+    std::vector<Vector> Normals;
+    // vertex and normal IDs of the faces as written, FaceSizes[i] of each
+    // for face i (no normal IDs for faces without normals)
+    std::vector<int> VertexIDs;
+    std::vector<int> NormalIDs;
+    std::vector<std::pair<uint32_t, uint32_t>> FaceSizes;
+    std::vector<std::string> GroupNames;
+    int IgnoredLines = 0;
+    // what the line after the last one parsed threw
+    std::exception_ptr Error;
+};
+
 void ObjParser::Parse()
 {
     std::ifstream InFile(Filename);
-    std::string Line;
-    while (std::getline(InFile, Line))
+    std::string Text((std::istreambuf_iterator<char>(InFile)), std::istreambuf_iterator<char>());
+
+    // the parts end on line ends; indices are checked and triangles made when
+    // the parts are added, in order, so the result is that of one pass
+    auto &Pool = ThreadPool::shared();
+    auto Count = std::min(Pool.size() + 1, Text.size() / MinChunkSize + 1);
+    std::vector<std::size_t> Bounds {0};
+    for (std::size_t i = 1; i < Count; ++i)
+    {
+        auto Pos = std::max(Text.size() * i / Count, Bounds.back());
+        Pos = Text.find('\n', Pos);
+        Bounds.push_back(Pos == std::string::npos ? Text.size() : Pos + 1);
+    }
+    Bounds.push_back(Text.size());
+
+    std::vector<ParsedChunk> Chunks(Count);
+    Pool.parallelFor(0, Count, 1, [&](std::size_t i) {
+        ParseChunk(Text.data() + Bounds[i], Text.data() + Bounds[i + 1], Chunks[i]);
+    });
+    for (auto &Chunk : Chunks)
     {
-        std::istringstream ISS(Line);
-        std::string Indicator;
-        ISS >> Indicator;
+        AddChunk(Chunk);
+    }
+}
 
-        if (Indicator == "v")
+void ObjParser::ParseChunk(const char *Begin, const char *End, ParsedChunk &Chunk)
+{
+    try
+    {
+        while (Begin < End)
         {
-            double Num1, Num2, Num3;
-            if (!(ISS >> Num1 >> Num2 >> Num3))
+            auto LineEnd = std::find(Begin, End, '\n');
+            std::istringstream ISS(std::string(Begin, LineEnd));
+            Begin = LineEnd + 1;
+
+            std::string Indicator;
+            ISS >> Indicator;
+
+            if (Indicator == "v")
             {
-                throw std::invalid_argument("Wrong format for vertex line.");
+                Real Num1, Num2, Num3;
+                if (!(ISS >> Num1 >> Num2 >> Num3))
+                {
+                    throw std::invalid_argument("Wrong format for vertex line.");
+                }
+
+                Chunk.Vertices.push_back(Point(Num1, Num2, Num3));
+                Chunk.Kinds += 'v';
             }
-
-            Vertices.push_back(Point(Num1, Num2, Num3));
-        }
-        else if (Indicator == "vn")
-        {
-            double Num1, Num2, Num3;
-            if (!(ISS >> Num1 >> Num2 >> Num3))
+            else if (Indicator == "vn")
             {
-                throw std::invalid_argument("Wrong format for vertex normal line.");
+                Real Num1, Num2, Num3;
+                if (!(ISS >> Num1 >> Num2 >> Num3))
+                {
+                    throw std::invalid_argument("Wrong format for vertex normal line.");
+                }
+
+                Chunk.Normals.push_back(Vector(Num1, Num2, Num3));
+                Chunk.Kinds += 'n';
             }
+            else if (Indicator == "f")
+            {
+                std::vector<int> VIndices;
+                std::vector<int> TIndices;
+                std::vector<int> NIndices;
+                std::string NextStr;
+                while(ISS >> NextStr)
+                {
+                    ParseFace(VIndices, TIndices, NIndices, NextStr);
+                }
+
+                Chunk.VertexIDs.insert(Chunk.VertexIDs.end(), VIndices.begin(), VIndices.end());
+                Chunk.NormalIDs.insert(Chunk.NormalIDs.end(), NIndices.begin(), NIndices.end());
+                Chunk.FaceSizes.emplace_back(VIndices.size(), NIndices.size());
+                Chunk.Kinds += 'f';
+            }
+            else if (Indicator == "g")
+            {
+                std::string GroupName;
+                if (!(ISS >> GroupName))
+                {
+                    throw std::invalid_argument("Wrong format for group name.");
+                }
+
+                Chunk.GroupNames.push_back(GroupName);
+                Chunk.Kinds += 'g';
+            }
+            else
+            {
+                ++Chunk.IgnoredLines;
+            }
+        }
+    }
+    catch (...)
+    {
+        Chunk.Error = std::current_exception();
+    }
+}
 
-            Normals.push_back(Vector(Num1, Num2, Num3));
+void ObjParser::AddChunk(const ParsedChunk &Chunk)
+{
+    std::size_t V = 0, N = 0, F = 0, G = 0, VertexID = 0, NormalID = 0;
+    for (auto Kind : Chunk.Kinds)
+    {
+        if (Kind == 'v')
+        {
+            Vertices.push_back(Chunk.Vertices[V++]);
         }
-        else if (Indicator == "f")
+        else if (Kind == 'n')
         {
-            int Idx;
-            std::vector<int> VIndices;
-            std::vector<int> TIndices;
-            std::vector<int> NIndices;
-            std::string NextStr;
-            while(ISS >> NextStr)
-            {
-                ParseFace(VIndices, TIndices, NIndices, NextStr);
-            }
+            Normals.push_back(Chunk.Normals[N++]);
+        }
+        else if (Kind == 'f')
+        {
+            auto Size = Chunk.FaceSizes[F++];
+            std::vector<int> VIndices(Chunk.VertexIDs.begin() + VertexID, Chunk.VertexIDs.begin() + VertexID + Size.first);
+            std::vector<int> NIndices(Chunk.NormalIDs.begin() + NormalID, Chunk.NormalIDs.begin() + NormalID + Size.second);
+            VertexID += Size.first;
+            NormalID += Size.second;
 
             // create triangles
             if (NIndices.size() > 0 && Smoothing)
             {
-                auto Tris = FanTriangulation(VIndices, TIndices, NIndices);
+                auto Tris = FanTriangulation(VIndices, std::vector<int>(), NIndices);
                 STriGroups[LatestGroup].insert(STriGroups[LatestGroup].end(), Tris.begin(), Tris.end());
             }
             else
@@ -113,53 +220,62 @@ void ObjParser::Parse()
                 auto Tris = FanTriangulation(VIndices);
                 TriGroups[LatestGroup].insert(TriGroups[LatestGroup].end(), Tris.begin(), Tris.end());
             }
-            
         }
-        else if (Indicator == "g")
+        else
         {
-            std::string GroupName;
-            if (!(ISS >> GroupName))
-            {
-                throw std::invalid_argument("Wrong format for group name.");
-            }
-            
+            auto &GroupName = Chunk.GroupNames[G++];
             if (TriGroups.find(GroupName) == TriGroups.end())
-                TriGroups[GroupName] = std::vector<Triangles>();
+                TriGroups[GroupName] = std::vector<FaceTriangle>();
 
             if (STriGroups.find(GroupName) == STriGroups.end())
-                STriGroups[GroupName] = std::vector<SmoothTriangles>();
+                STriGroups[GroupName] = std::vector<FaceTriangle>();
 
             LatestGroup = GroupName;
         }
-        else
-        {
-            ++IgnoredLines;
-        }
     }
+    IgnoredLines += Chunk.IgnoredLines;
+
+    if (Chunk.Error)
+        std::rethrow_exception(Chunk.Error);
 }
 
-Point ObjParser::GetVertex(int ID)
+uint32_t ObjParser::VertexIndex(int ID)
 {
     if (ID < 1 || ID > Vertices.size())
         throw std::invalid_argument("vertex index is invalid");
-    
-    return Vertices[ID-1];
+
+    return ID - 1;
 }
 
-Vector ObjParser::GetNormal(int ID)
+uint32_t ObjParser::NormalIndex(int ID)
 {
     if (ID < 1 || ID > Normals.size())
         throw std::invalid_argument("normal index is invalid");
 
-    return Normals[ID-1];
+    return ID - 1;
+}
+
+Point ObjParser::GetVertex(int ID)
+{
+    return Vertices[VertexIndex(ID)];
+}
+
+Vector ObjParser::GetNormal(int ID)
+{
+    return Normals[NormalIndex(ID)];
 }
 
 std::vector<Triangles> ObjParser::GetGroup(std::string Name)
 {
     if (TriGroups.find(Name) == TriGroups.end())
         throw std::invalid_argument("group name is invalid");
-    
-    return TriGroups[Name];
+
+    std::vector<Triangles> Tris;
+    for (auto &F : TriGroups[Name])
+    {
+        Tris.push_back(MakeTriangle(F));
+    }
+    return Tris;
 }
 
 std::vector<SmoothTriangles> ObjParser::GetSGroup(std::string Name)
@@ -167,30 +283,47 @@ std::vector<SmoothTriangles> ObjParser::GetSGroup(std::string Name)
     if (STriGroups.find(Name) == STriGroups.end())
         throw std::invalid_argument("smooth-triangle group name is invalid");
 
-    return STriGroups[Name];
+    std::vector<SmoothTriangles> Tris;
+    for (auto &F : STriGroups[Name])
+    {
+        Tris.push_back(MakeSmoothTriangle(F));
+    }
+    return Tris;
 }
 
-std::vector<Triangles> ObjParser::FanTriangulation(std::vector<int>VIndices)
+Triangles ObjParser::MakeTriangle(const FaceTriangle &F)
 {
-    std::vector<Triangles> Tris;
+    return Triangles(Vertices[F.V[0]], Vertices[F.V[1]], Vertices[F.V[2]]);
+}
+
+SmoothTriangles ObjParser::MakeSmoothTriangle(const FaceTriangle &F)
+{
+    return SmoothTriangles(Vertices[F.V[0]], Vertices[F.V[1]], Vertices[F.V[2]],
+                           Normals[F.N[0]], Normals[F.N[1]], Normals[F.N[2]]);
+}
+
+std::vector<ObjParser::FaceTriangle> ObjParser::FanTriangulation(std::vector<int>VIndices)
+{
+    std::vector<FaceTriangle> Tris;
 
     for (int i = 1; i < (VIndices.size()-1); ++i)
     {
-        Triangles Tri(GetVertex(VIndices[0]), GetVertex(VIndices[i]), GetVertex(VIndices[i+1]));
+        FaceTriangle Tri {{VertexIndex(VIndices[0]), VertexIndex(VIndices[i]), VertexIndex(VIndices[i+1])},
+                          {TriangleMesh::Flat, TriangleMesh::Flat, TriangleMesh::Flat}};
         Tris.push_back(Tri);
     }
 
     return Tris;
 }
 
-std::vector<SmoothTriangles> ObjParser::FanTriangulation(std::vector<int>VIndices, std::vector<int>TIndices, std::vector<int>NIndices)
+std::vector<ObjParser::FaceTriangle> ObjParser::FanTriangulation(std::vector<int>VIndices, std::vector<int>TIndices, std::vector<int>NIndices)
 {
-    std::vector<SmoothTriangles> Tris;
+    std::vector<FaceTriangle> Tris;
 
     for (int i = 1; i < (VIndices.size()-1); ++i)
     {
-        SmoothTriangles Tri(GetVertex(VIndices[0]), GetVertex(VIndices[i]), GetVertex(VIndices[i+1]),
-                            GetNormal(NIndices[0]), GetNormal(NIndices[i]), GetNormal(NIndices[i+1]));
+        FaceTriangle Tri {{VertexIndex(VIndices[0]), VertexIndex(VIndices[i]), VertexIndex(VIndices[i+1])},
+                          {NormalIndex(NIndices[0]), NormalIndex(NIndices[i]), NormalIndex(NIndices[i+1])}};
         Tris.push_back(Tri);
     }
 
@@ -206,7 +339,7 @@ std::unordered_map<std::string, std::shared_ptr<Groups>> ObjParser::ObjToGroup()
         auto NewGroup = std::make_shared<Groups>(Groups());
         for (auto &Child: G.second)
         {
-            std::shared_ptr<Object> NewChild = std::make_shared<Triangles>(Child);
+            std::shared_ptr<Object> NewChild = std::make_shared<Triangles>(MakeTriangle(Child));
             NewGroup->AddChild(NewChild);
         }
 
@@ -217,7 +350,7 @@ std::unordered_map<std::string, std::shared_ptr<Groups>> ObjParser::ObjToGroup()
     {
         for (auto &Child: G.second)
         {
-            std::shared_ptr<Object> NewChild = std::make_shared<SmoothTriangles>(Child);
+            std::shared_ptr<Object> NewChild = std::make_shared<SmoothTriangles>(MakeSmoothTriangle(Child));
             if (OutputGroups.find(G.first) == OutputGroups.end())
             {
                 OutputGroups[G.first] = std::make_shared<Groups>(Groups());
@@ -229,6 +362,61 @@ std::unordered_map<std::string, std::shared_ptr<Groups>> ObjParser::ObjToGroup()
     return OutputGroups;
 }
 
+std::unordered_map<std::string, std::shared_ptr<TriangleMesh>> ObjParser::ObjToMesh()
+{
+    std::unordered_map<std::string, std::shared_ptr<TriangleMesh>> OutputMeshes;
+
+    // file indices to mesh indices of the current group, Flat until used
+    std::vector<uint32_t> VertexMap(Vertices.size(), TriangleMesh::Flat);
+    std::vector<uint32_t> NormalMap(Normals.size(), TriangleMesh::Flat);
+
+    for (auto &G: TriGroups)
+    {
+        auto &Smooth = STriGroups[G.first];
+        if (G.second.empty() && Smooth.empty())
+            continue;
+
+        auto Mesh = std::make_shared<TriangleMesh>();
+        auto MapVertex = [&](uint32_t V) {
+            if (VertexMap[V] == TriangleMesh::Flat)
+                VertexMap[V] = Mesh->AddVertex(Vertices[V]);
+            return VertexMap[V];
+        };
+        auto MapNormal = [&](uint32_t N) {
+            if (N != TriangleMesh::Flat && NormalMap[N] == TriangleMesh::Flat)
+                NormalMap[N] = Mesh->AddNormal(Normals[N]);
+            return N == TriangleMesh::Flat ? N : NormalMap[N];
+        };
+
+        // flat triangles first, then smooth ones, as in ObjToGroup
+        for (auto *Faces : {&G.second, &Smooth})
+        {
+            for (auto &F: *Faces)
+            {
+                Mesh->AddTriangle(MapVertex(F.V[0]), MapVertex(F.V[1]), MapVertex(F.V[2]),
+                                  MapNormal(F.N[0]), MapNormal(F.N[1]), MapNormal(F.N[2]));
+            }
+        }
+
+        for (auto *Faces : {&G.second, &Smooth})
+        {
+            for (auto &F: *Faces)
+            {
+                for (int c = 0; c < 3; ++c)
+                {
+                    VertexMap[F.V[c]] = TriangleMesh::Flat;
+                    if (F.N[c] != TriangleMesh::Flat)
+                        NormalMap[F.N[c]] = TriangleMesh::Flat;
+                }
+            }
+        }
+
+        OutputMeshes[G.first] = Mesh;
+    }
+
+    return OutputMeshes;
+}
+
 // TEST_CASE("Ignoring unrecognized lines")
 // {
 //     ObjParser Parser("../test/obj/test1.obj");
@@ -3,10 +3,19 @@
 #include <stdexcept>
 #include <memory>
 #include <cmath>
+#include <algorithm>
 #include "include/Object.h"
 #include "include/Transformations.h"
 #include "include/Functions.h"
 
+namespace
+{
+    // scratch list for the default hit queries of leaf shapes (and CSG, which
+    // needs all its hits to filter them); groups override the queries and
+    // never use it, so it is not shared between nested calls
+    thread_local std::vector<Intersection<Object>> HitBuffer;
+}
+
 Object::Object()
 {
     ID = 0;
@@ -17,17 +26,157 @@ int Object::GetID()
     return ID;
 }
 
-void Object::SetTransform(Matrix &M)
+void Object::SetTransform(const Matrix &M)
 {
     Transform = M;
     TransformInverse = Transform.Inverse();
+    NormalTransform = TransformInverse.T();
+
+    HasTransform = false;
+    for (int r = 0; r < 4; ++r)
+    {
+        for (int c = 0; c < 4; ++c)
+        {
+            if (M.At(r, c) != (r == c ? 1 : 0))
+                HasTransform = true;
+        }
+    }
+    Uncommit();
+    BoundsChanged();
+}
+
+void Object::BoundsChanged()
+{
+    if (Parent)
+        Parent->ChildBoundsChanged(this);
+}
+
+void Object::Commit()
+{
+    // groups commit before their children, so the parent is normally done
+    // already; shared children of cloned groups still point at the original
+    // group, in that case compose its chain here
+    auto ParentInverse = Matrix::Identity();
+    if (Parent && Parent->Committed())
+    {
+        ParentInverse = Parent->GetWorldInverse();
+    }
+    else
+    {
+        for (auto P = Parent; P; P = P->GetParent())
+        {
+            ParentInverse = ParentInverse.Mul(P->GetTransformInverse());
+        }
+    }
+
+    WorldInverse = TransformInverse.Mul(ParentInverse);
+    WorldNormalTransform = WorldInverse.T();
+    IsCommitted = true;
+}
+
+void Object::Intersect(const Ray &R, std::vector<Intersection<Object>> &XS)
+{
+    if (!HasTransform)
+        return LocalIntersect(R, XS);
+
+    auto LocalRay = R.Transform(TransformInverse);
+
+    LocalIntersect(LocalRay, XS);
 }
 
 std::vector<Intersection<Object>> Object::Intersect(const Ray &R)
 {
+    std::vector<Intersection<Object>> XS;
+    Intersect(R, XS);
+    std::sort(XS.begin(), XS.end());
+    return XS;
+}
+
+bool Object::ClosestHit(const Ray &R, Real TMin, Real &TMax, Intersection<Object> &Hit)
+{
+    if (!HasTransform)
+        return LocalClosestHit(R, TMin, TMax, Hit);
+
+    // T is the same along the transformed ray, so the range carries over
+    auto LocalRay = R.Transform(TransformInverse);
+
+    return LocalClosestHit(LocalRay, TMin, TMax, Hit);
+}
+
+bool Object::LocalClosestHit(const Ray &LocalRay, Real TMin, Real &TMax, Intersection<Object> &Hit)
+{
+    auto &XS = HitBuffer;
+    XS.clear();
+    LocalIntersect(LocalRay, XS);
+
+    bool Found = false;
+    for (auto &I : XS)
+    {
+        if (I.GetT() > TMin && I.GetT() < TMax)
+        {
+            Hit = I;
+            TMax = I.GetT();
+            Found = true;
+        }
+    }
+
+    return Found;
+}
+
+LaneMask Object::ClosestHits(const RayPacket &P, LaneMask Active, Real TMin, Real *TMax, Intersection<Object> *Hits)
+{
+    if (!HasTransform)
+        return LocalClosestHits(P, Active, TMin, TMax, Hits);
+
+    auto LocalPacket = P.Transform(TransformInverse);
+
+    return LocalClosestHits(LocalPacket, Active, TMin, TMax, Hits);
+}
+
+LaneMask Object::LocalClosestHits(const RayPacket &LocalPacket, LaneMask Active, Real TMin, Real *TMax,
+                                  Intersection<Object> *Hits)
+{
+    LaneMask Found = 0;
+    for (int i = 0; i < LocalPacket.GetSize(); ++i)
+    {
+        if ((Active >> i & 1) && LocalClosestHit(LocalPacket.GetRay(i), TMin, TMax[i], Hits[i]))
+            Found |= LaneMask(1) << i;
+    }
+
+    return Found;
+}
+
+bool Object::AnyHit(const Ray &R, Real TMin, Real TMax)
+{
+    if (!HasTransform)
+        return LocalAnyHit(R, TMin, TMax);
+
     auto LocalRay = R.Transform(TransformInverse);
 
-    return LocalIntersect(LocalRay);
+    return LocalAnyHit(LocalRay, TMin, TMax);
+}
+
+bool Object::LocalAnyHit(const Ray &LocalRay, Real TMin, Real TMax)
+{
+    auto &XS = HitBuffer;
+    XS.clear();
+    LocalIntersect(LocalRay, XS);
+
+    for (auto &I : XS)
+    {
+        if (I.GetT() > TMin && I.GetT() < TMax && I.GetObject()->ShadowOn())
+            return true;
+    }
+
+    return false;
+}
+
+std::vector<Intersection<Object>> Object::LocalIntersect(const Ray &LocalRay)
+{
+    std::vector<Intersection<Object>> XS;
+    LocalIntersect(LocalRay, XS);
+    std::sort(XS.begin(), XS.end());
+    return XS;
 }
 
 Vector Object::NormalAt(Point &P)
@@ -66,11 +215,9 @@ Vector TestShape::LocalNormalAt(Point &LocalPoint)
     return Vector(LocalPoint.X(), LocalPoint.Y(), LocalPoint.Z());
 }
 
-std::vector<Intersection<Object>> TestShape::LocalIntersect(const Ray &R)
+void TestShape::LocalIntersect(const Ray &R, std::vector<Intersection<Object>> &XS)
 {
     SavedRay = std::make_unique<Ray>(R);
-
-    return std::vector<Intersection<Object>>();
 }
 
 BoundingBoxes TestShape::BoundsOf()
@@ -39,19 +39,15 @@ Vector Plane::LocalNormalAt(Point &&LocalPoint)
     return Vector(0., 1., 0.);
 }
 
-std::vector<Intersection<Object>> Plane::LocalIntersect(const Ray &LocalRay)
+void Plane::LocalIntersect(const Ray &LocalRay, std::vector<Intersection<Object>> &XS)
 {
-    std::vector<Intersection<Object>> Intersections;
-
     if (std::abs(LocalRay.GetDirection().Y()) < Util::EPSILON)
     {
-        return Intersections;
+        return;
     }
 
     auto T = -LocalRay.GetOrigin().Y() / LocalRay.GetDirection().Y();
-    Intersections.push_back(Intersection<Object>(T, this));
-
-    return Intersections;
+    XS.push_back(Intersection<Object>(T, this));
 }
 
 BoundingBoxes Plane::BoundsOf()
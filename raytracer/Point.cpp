@@ -1,38 +1,12 @@
 #include <iostream>
-#include <exception>
-#include <stdexcept>
 #include "include/Point.h"
 
-Point::Point() : Matrix(4, 1)
+Point::Point() : Tuple(0., 0., 0., 1.)
 {
-    this->Set(3, 0, 1.);
 }
 
-Point::Point(int NumRows, int NumCols) : Matrix(4, 1)
+Point::Point(Real X, Real Y, Real Z) : Tuple(X, Y, Z, 1.)
 {
-    if (NumRows != 4 && NumCols != 1)
-        throw std::invalid_argument("size of a Point must be 4x1");
-}
-
-Point::Point(double X, double Y, double Z) : Matrix(4, 1)
-{
-    this->Set(0, 0, X);
-    this->Set(1, 0, Y);
-    this->Set(2, 0, Z);
-    this->Set(3, 0, 1.);
-}
-
-Point::Point(Matrix &M)
-{
-    if (M.GetNumRows() != 4 && M.GetNumCols() != 1)
-        throw std::invalid_argument("size of a Point must be 4x1");
-    if (!Util::Equal(M.At(3,0), 1.))
-        throw std::invalid_argument("W value must be 1.0");
-
-    this->Set(0, 0, M.At(0, 0));
-    this->Set(1, 0, M.At(1, 0));
-    this->Set(2, 0, M.At(2, 0));
-    this->Set(3, 0, M.At(3, 0));
 }
 
 std::ostream &operator<<(std::ostream &os, const Point &P)
@@ -4,56 +4,22 @@
 #include <cmath>
 #include <memory>
 #include "include/Ray.h"
+#include "include/SIMD.h"
 
 Ray::Ray() {}
 
-Ray::Ray(Point &&O, Vector &&D)
+Ray::Ray(const Point &O, const Vector &D) : Origin(O), Direction(D)
 {
-    Origin = O;
-    Direction = D;
 }
 
-Ray::Ray(Point &O, Vector &&D)
-{
-    Origin = O;
-    Direction = D;
-}
-
-Ray::Ray(Point &O, Vector &D)
-{
-    Origin = O;
-    Direction = D;
-}
-
-Ray::Ray(Point &&O, Vector &D)
-{
-    Origin = O;
-    Direction = D;
-}
-
-Point Ray::GetOrigin() const
-{
-    return Origin;
-}
-
-Vector Ray::GetDirection() const
-{
-    return Direction;
-}
-
-Point Ray::Position(double T)
+Point Ray::Position(Real T) const
 {
     return Origin + Direction * T;
 }
 
-Ray Ray::Transform(Matrix &M) const
-{
-    return Ray(M.Mul(Origin), M.Mul(Direction));
-}
-
-Ray Ray::Transform(Matrix &&M) const
+Ray Ray::Transform(const Matrix &M) const
 {
-    return Ray(M.Mul(Origin), M.Mul(Direction));
+    return SIMD::TransformRay(M, *this);
 }
 
 // TEST_CASE("Creating and querying a Ray")
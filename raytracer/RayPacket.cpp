@@ -0,0 +1,49 @@
+#include <stdexcept>
+#include "include/RayPacket.h"
+#include "include/SIMD.h"
+
+RayPacket::RayPacket(const Ray *R, int N)
+{
+    if (N < 1 || N > MaxSize)
+        throw std::invalid_argument("a ray packet holds 1 to 16 rays");
+
+    Size = N;
+    for (int i = 0; i < N; ++i)
+    {
+        Rays[i] = R[i];
+    }
+    Scatter();
+}
+
+RayPacket RayPacket::Transform(const Matrix &M) const
+{
+    RayPacket Res;
+    Res.Size = Size;
+    SIMD::TransformRays(M, Rays, Res.Rays, Size);
+    Res.Scatter();
+    return Res;
+}
+
+void RayPacket::Scatter()
+{
+    for (int i = 0; i < MaxSize; ++i)
+    {
+        auto &R = Rays[i < Size ? i : 0];
+        for (int a = 0; a < 3; ++a)
+        {
+            Origin[a][i] = R.GetOrigin()[a];
+            Direction[a][i] = R.GetDirection()[a];
+        }
+    }
+}
+
+PacketSlabs::PacketSlabs(const RayPacket &P)
+{
+    for (int a = 0; a < 3; ++a)
+    {
+        for (int i = 0; i < RayPacket::MaxSize; ++i)
+        {
+            InvDirection[a][i] = 1 / P.Direction[a][i];
+        }
+    }
+}
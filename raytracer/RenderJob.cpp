@@ -0,0 +1,61 @@
+#include "include/RenderJob.h"
+
+RenderJob::RenderJob(int Tiles, int Pixels, Callback Fn, std::chrono::milliseconds Interval)
+    : TileCount(Tiles), TotalPixels(Pixels), Completions(new std::atomic<int>[Tiles]), TilesLeft(Tiles),
+      Progress(std::move(Fn)), Interval(Interval)
+{
+    for (int t = 0; t < TileCount; ++t)
+        Completions[t].store(0, std::memory_order_relaxed);
+    Complete.store(TileCount == 0, std::memory_order_relaxed);
+    NextReport = std::chrono::steady_clock::now() + Interval;
+}
+
+void RenderJob::Report()
+{
+    // a thread already reporting has the news, do not queue behind it
+    std::unique_lock<std::mutex> Lock(ReportMutex, std::try_to_lock);
+    if (!Lock.owns_lock())
+        return;
+
+    auto Now = std::chrono::steady_clock::now();
+    if (Now < NextReport)
+        return;
+    // read under the lock, so that the reports never go backwards; the end is
+    // left to the last tile
+    auto Done = PixelsDone.load(std::memory_order_relaxed);
+    if (Done == TotalPixels)
+        return;
+    NextReport = Now + Interval;
+    Progress(Done, TotalPixels);
+}
+
+void RenderJob::Finish(int Tile, int Pixels)
+{
+    Completions[Tile].fetch_add(1, std::memory_order_relaxed);
+    PixelsDone.fetch_add(Pixels, std::memory_order_relaxed);
+    // reported before the tile is counted: once the last tile is counted no
+    // other thread touches the job any more
+    if (Progress && TilesLeft.load(std::memory_order_relaxed) > 1)
+        Report();
+
+    // acq_rel: the thread finishing the last tile sees the pixels of all the
+    // others, and passes them on to Wait() through Complete
+    if (TilesLeft.fetch_sub(1, std::memory_order_acq_rel) != 1)
+        return;
+
+    if (Progress)
+    {
+        std::lock_guard<std::mutex> Lock(ReportMutex);
+        Progress(TotalPixels, TotalPixels);
+    }
+    std::lock_guard<std::mutex> Lock(WaitMutex);
+    Complete.store(true, std::memory_order_release);
+    Finished.notify_all();
+}
+
+void RenderJob::Wait()
+{
+    // always under the lock, Finish() may still be holding it
+    std::unique_lock<std::mutex> Lock(WaitMutex);
+    Finished.wait(Lock, [this]() { return Done(); });
+}
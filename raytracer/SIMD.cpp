@@ -0,0 +1,856 @@
+#include "include/SIMD.h"
+#include <cmath>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define RAYTRACER_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+namespace
+{
+    // Every kernel works on the raw row-major 4x4 array of a Matrix and on the
+    // raw 4-element arrays of Points/Vectors. W of the outputs is fixed to 1 for
+    // points and 0 for vectors (all transforms here are affine).
+    using PointKernel = void (*)(const Real *M, const Real *In, Real *Out);
+    using RaysKernel = void (*)(const Real *M, const Ray *In, Ray *Out, std::size_t N);
+    using EnterBoxKernel = LaneMask (*)(const RayPacket &P, const PacketSlabs &S, LaneMask Active, const float *Min,
+                                        const float *Max, Real TMin, const Real *TMax, Real Slack, Real *Enter);
+    using TriangleKernel = LaneMask (*)(const RayPacket &P, LaneMask Active, const Real *P1, const Real *E1,
+                                        const Real *E2, Real TMin, const Real *TMax, Real *T, Real *U, Real *V);
+    using BlockKernel = LaneMask (*)(const Ray &R, const TriangleBlock &B, int Count, Real TMin, Real TMax,
+                                     Real *T, Real *U, Real *V);
+
+    struct Kernels
+    {
+        PointKernel Point;
+        PointKernel Vector;
+        RaysKernel Rays;
+        EnterBoxKernel EnterBox;
+        TriangleKernel Triangle;
+        BlockKernel Block;
+    };
+
+    // ---------------------------------------------------------------------
+    // scalar fallback
+
+    void ScalarPoint(const Real *M, const Real *In, Real *Out)
+    {
+        Real X = In[0], Y = In[1], Z = In[2];
+        Out[0] = M[0] * X + M[1] * Y + M[2] * Z + M[3];
+        Out[1] = M[4] * X + M[5] * Y + M[6] * Z + M[7];
+        Out[2] = M[8] * X + M[9] * Y + M[10] * Z + M[11];
+        Out[3] = 1;
+    }
+
+    void ScalarVector(const Real *M, const Real *In, Real *Out)
+    {
+        Real X = In[0], Y = In[1], Z = In[2];
+        Out[0] = M[0] * X + M[1] * Y + M[2] * Z;
+        Out[1] = M[4] * X + M[5] * Y + M[6] * Z;
+        Out[2] = M[8] * X + M[9] * Y + M[10] * Z;
+        Out[3] = 0;
+    }
+
+    void ScalarRays(const Real *M, const Ray *In, Ray *Out, std::size_t N)
+    {
+        for (std::size_t i = 0; i < N; ++i)
+        {
+            Point O;
+            Vector D;
+            ScalarPoint(M, In[i].GetOrigin().Data(), O.Data());
+            ScalarVector(M, In[i].GetDirection().Data(), D.Data());
+            Out[i] = Ray(O, D);
+        }
+    }
+
+    LaneMask ScalarEnterBox(const RayPacket &P, const PacketSlabs &S, LaneMask Active, const float *Min,
+                            const float *Max, Real TMin, const Real *TMax, Real Slack, Real *Enter)
+    {
+        LaneMask Hit = 0;
+        for (int i = 0; i < RayPacket::MaxSize; ++i)
+        {
+            if (!(Active >> i & 1))
+                continue;
+
+            Real T0 = TMin, T1 = TMax[i];
+            for (int a = 0; a < 3; ++a)
+            {
+                Real Inv = S.InvDirection[a][i];
+                Real Near = Inv < 0 ? Max[a] : Min[a];
+                Real Far = Inv < 0 ? Min[a] : Max[a];
+                Real A = (Near - P.Origin[a][i]) * Inv;
+                Real B = (Far - P.Origin[a][i]) * Inv;
+                T0 = A > T0 ? A : T0;
+                T1 = B < T1 ? B : T1;
+            }
+            T0 -= std::abs(T0) * Slack;
+            T1 += std::abs(T1) * Slack;
+            Enter[i] = T0;
+            if (T0 <= T1)
+                Hit |= LaneMask(1) << i;
+        }
+        return Hit;
+    }
+
+    LaneMask ScalarTriangle(const RayPacket &P, LaneMask Active, const Real *P1, const Real *E1, const Real *E2,
+                            Real TMin, const Real *TMax, Real *T, Real *U, Real *V)
+    {
+        LaneMask Hit = 0;
+        for (int i = 0; i < RayPacket::MaxSize; ++i)
+        {
+            if (!(Active >> i & 1))
+                continue;
+
+            Real D0 = P.Direction[0][i], D1 = P.Direction[1][i], D2 = P.Direction[2][i];
+            Real C0 = D1 * E2[2] - D2 * E2[1];
+            Real C1 = D2 * E2[0] - D0 * E2[2];
+            Real C2 = D0 * E2[1] - D1 * E2[0];
+            Real Determinant = E1[0] * C0 + E1[1] * C1 + E1[2] * C2;
+            if (std::abs(Determinant) < Util::EPSILON)
+                continue;
+
+            // F, U and V have the types they have in Triangles::LocalIntersect
+            auto F = 1. / Determinant;
+            Real X = P.Origin[0][i] - P1[0], Y = P.Origin[1][i] - P1[1], Z = P.Origin[2][i] - P1[2];
+            auto LaneU = F * (X * C0 + Y * C1 + Z * C2);
+            if (LaneU < 0. || LaneU > 1.)
+                continue;
+
+            Real Q0 = Y * E1[2] - Z * E1[1];
+            Real Q1 = Z * E1[0] - X * E1[2];
+            Real Q2 = X * E1[1] - Y * E1[0];
+            auto LaneV = F * (D0 * Q0 + D1 * Q1 + D2 * Q2);
+            if (LaneV < 0. || (LaneU + LaneV) > 1.)
+                continue;
+
+            Real LaneT = F * (E2[0] * Q0 + E2[1] * Q1 + E2[2] * Q2);
+            if (LaneT > TMin && LaneT < TMax[i])
+            {
+                T[i] = LaneT;
+                U[i] = LaneU;
+                V[i] = LaneV;
+                Hit |= LaneMask(1) << i;
+            }
+        }
+        return Hit;
+    }
+
+    LaneMask ScalarBlock(const Ray &R, const TriangleBlock &B, int Count, Real TMin, Real TMax,
+                         Real *T, Real *U, Real *V)
+    {
+        const Real *O = R.GetOrigin().Data();
+        const Real *D = R.GetDirection().Data();
+        LaneMask Hit = 0;
+        for (int i = 0; i < Count; ++i)
+        {
+            Real E1[3] = {B.E1[0][i], B.E1[1][i], B.E1[2][i]};
+            Real E2[3] = {B.E2[0][i], B.E2[1][i], B.E2[2][i]};
+            Real C0 = D[1] * E2[2] - D[2] * E2[1];
+            Real C1 = D[2] * E2[0] - D[0] * E2[2];
+            Real C2 = D[0] * E2[1] - D[1] * E2[0];
+            Real Determinant = E1[0] * C0 + E1[1] * C1 + E1[2] * C2;
+            if (std::abs(Determinant) < Util::EPSILON)
+                continue;
+
+            auto F = 1. / Determinant;
+            Real X = O[0] - B.P1[0][i], Y = O[1] - B.P1[1][i], Z = O[2] - B.P1[2][i];
+            auto LaneU = F * (X * C0 + Y * C1 + Z * C2);
+            if (LaneU < 0. || LaneU > 1.)
+                continue;
+
+            Real Q0 = Y * E1[2] - Z * E1[1];
+            Real Q1 = Z * E1[0] - X * E1[2];
+            Real Q2 = X * E1[1] - Y * E1[0];
+            auto LaneV = F * (D[0] * Q0 + D[1] * Q1 + D[2] * Q2);
+            if (LaneV < 0. || (LaneU + LaneV) > 1.)
+                continue;
+
+            Real LaneT = F * (E2[0] * Q0 + E2[1] * Q1 + E2[2] * Q2);
+            if (LaneT > TMin && LaneT < TMax)
+            {
+                T[i] = LaneT;
+                U[i] = LaneU;
+                V[i] = LaneV;
+                Hit |= LaneMask(1) << i;
+            }
+        }
+        return Hit;
+    }
+
+#if defined(RAYTRACER_X86_KERNELS) && !defined(RAYTRACER_FLOAT)
+    // ---------------------------------------------------------------------
+    // SSE2: two lanes, the output is computed as the (x, y) and (z, w) halves
+    // of Col0 * X + Col1 * Y + Col2 * Z (+ Col3).
+
+    struct SSE2Columns
+    {
+        __m128d Lo[4];
+        __m128d Hi[4];
+    };
+
+    __attribute__((target("sse2"))) inline SSE2Columns SSE2Load(const double *M)
+    {
+        SSE2Columns C;
+        for (int c = 0; c < 4; c += 2)
+        {
+            __m128d R0 = _mm_loadu_pd(M + c);
+            __m128d R1 = _mm_loadu_pd(M + 4 + c);
+            __m128d R2 = _mm_loadu_pd(M + 8 + c);
+            __m128d R3 = _mm_loadu_pd(M + 12 + c);
+            C.Lo[c] = _mm_unpacklo_pd(R0, R1);
+            C.Lo[c + 1] = _mm_unpackhi_pd(R0, R1);
+            C.Hi[c] = _mm_unpacklo_pd(R2, R3);
+            C.Hi[c + 1] = _mm_unpackhi_pd(R2, R3);
+        }
+        return C;
+    }
+
+    __attribute__((target("sse2"))) inline void SSE2Apply(const SSE2Columns &C, const double *In, double *Out,
+                                                          bool IsPoint)
+    {
+        __m128d X = _mm_set1_pd(In[0]);
+        __m128d Y = _mm_set1_pd(In[1]);
+        __m128d Z = _mm_set1_pd(In[2]);
+        __m128d Lo = _mm_add_pd(_mm_add_pd(_mm_mul_pd(C.Lo[0], X), _mm_mul_pd(C.Lo[1], Y)), _mm_mul_pd(C.Lo[2], Z));
+        __m128d Hi = _mm_add_pd(_mm_add_pd(_mm_mul_pd(C.Hi[0], X), _mm_mul_pd(C.Hi[1], Y)), _mm_mul_pd(C.Hi[2], Z));
+        if (IsPoint)
+        {
+            Lo = _mm_add_pd(Lo, C.Lo[3]);
+            Hi = _mm_add_pd(Hi, C.Hi[3]);
+        }
+        _mm_storeu_pd(Out, Lo);
+        _mm_storeu_pd(Out + 2, Hi);
+        Out[3] = IsPoint ? 1. : 0.;
+    }
+
+    __attribute__((target("sse2"))) void SSE2Point(const double *M, const double *In, double *Out)
+    {
+        SSE2Apply(SSE2Load(M), In, Out, true);
+    }
+
+    __attribute__((target("sse2"))) void SSE2Vector(const double *M, const double *In, double *Out)
+    {
+        SSE2Apply(SSE2Load(M), In, Out, false);
+    }
+
+    __attribute__((target("sse2"))) void SSE2Rays(const double *M, const Ray *In, Ray *Out, std::size_t N)
+    {
+        auto C = SSE2Load(M);
+        for (std::size_t i = 0; i < N; ++i)
+        {
+            Point O;
+            Vector D;
+            SSE2Apply(C, In[i].GetOrigin().Data(), O.Data(), true);
+            SSE2Apply(C, In[i].GetDirection().Data(), D.Data(), false);
+            Out[i] = Ray(O, D);
+        }
+    }
+
+    // ---------------------------------------------------------------------
+    // AVX2: one register per matrix column, the rows are transposed in
+    // registers once per call (or once per batch).
+
+    struct AVX2Columns
+    {
+        __m256d C[4];
+    };
+
+    __attribute__((target("avx2"))) inline AVX2Columns AVX2Load(const double *M)
+    {
+        __m256d R0 = _mm256_loadu_pd(M);
+        __m256d R1 = _mm256_loadu_pd(M + 4);
+        __m256d R2 = _mm256_loadu_pd(M + 8);
+        __m256d R3 = _mm256_loadu_pd(M + 12);
+
+        __m256d T0 = _mm256_unpacklo_pd(R0, R1); // m00 m10 m02 m12
+        __m256d T1 = _mm256_unpackhi_pd(R0, R1); // m01 m11 m03 m13
+        __m256d T2 = _mm256_unpacklo_pd(R2, R3); // m20 m30 m22 m32
+        __m256d T3 = _mm256_unpackhi_pd(R2, R3); // m21 m31 m23 m33
+
+        AVX2Columns Cols;
+        Cols.C[0] = _mm256_permute2f128_pd(T0, T2, 0x20);
+        Cols.C[1] = _mm256_permute2f128_pd(T1, T3, 0x20);
+        Cols.C[2] = _mm256_permute2f128_pd(T0, T2, 0x31);
+        Cols.C[3] = _mm256_permute2f128_pd(T1, T3, 0x31);
+        return Cols;
+    }
+
+    __attribute__((target("avx2"))) inline __m256d AVX2Linear(const AVX2Columns &Cols, const double *In)
+    {
+        __m256d X = _mm256_broadcast_sd(In);
+        __m256d Y = _mm256_broadcast_sd(In + 1);
+        __m256d Z = _mm256_broadcast_sd(In + 2);
+        return _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(Cols.C[0], X), _mm256_mul_pd(Cols.C[1], Y)),
+                             _mm256_mul_pd(Cols.C[2], Z));
+    }
+
+    __attribute__((target("avx2"))) inline void AVX2ApplyPoint(const AVX2Columns &Cols, const double *In, double *Out)
+    {
+        _mm256_storeu_pd(Out, _mm256_add_pd(AVX2Linear(Cols, In), Cols.C[3]));
+        Out[3] = 1.;
+    }
+
+    __attribute__((target("avx2"))) inline void AVX2ApplyVector(const AVX2Columns &Cols, const double *In, double *Out)
+    {
+        _mm256_storeu_pd(Out, AVX2Linear(Cols, In));
+        Out[3] = 0.;
+    }
+
+    __attribute__((target("avx2"))) void AVX2Point(const double *M, const double *In, double *Out)
+    {
+        AVX2ApplyPoint(AVX2Load(M), In, Out);
+    }
+
+    __attribute__((target("avx2"))) void AVX2Vector(const double *M, const double *In, double *Out)
+    {
+        AVX2ApplyVector(AVX2Load(M), In, Out);
+    }
+
+    __attribute__((target("avx2"))) void AVX2Rays(const double *M, const Ray *In, Ray *Out, std::size_t N)
+    {
+        auto Cols = AVX2Load(M);
+        for (std::size_t i = 0; i < N; ++i)
+        {
+            Point O;
+            Vector D;
+            AVX2ApplyPoint(Cols, In[i].GetOrigin().Data(), O.Data());
+            AVX2ApplyVector(Cols, In[i].GetDirection().Data(), D.Data());
+            Out[i] = Ray(O, D);
+        }
+    }
+
+    // packets: four lanes per register, the loops skip groups of four
+    // without active lanes
+
+    __attribute__((target("avx2"))) LaneMask AVX2EnterBox(const RayPacket &P, const PacketSlabs &S, LaneMask Active,
+                                                          const float *Min, const float *Max, double TMin,
+                                                          const double *TMax, double Slack, double *Enter)
+    {
+        const __m256d Zero = _mm256_setzero_pd();
+        const __m256d SignBit = _mm256_set1_pd(-0.);
+        const __m256d VSlack = _mm256_set1_pd(Slack);
+        LaneMask Hit = 0;
+        for (int i = 0; i < RayPacket::MaxSize; i += 4)
+        {
+            if (!(Active >> i & 0xF))
+                continue;
+
+            __m256d T0 = _mm256_set1_pd(TMin);
+            __m256d T1 = _mm256_loadu_pd(TMax + i);
+            for (int a = 0; a < 3; ++a)
+            {
+                __m256d Inv = _mm256_load_pd(S.InvDirection[a] + i);
+                __m256d O = _mm256_load_pd(P.Origin[a] + i);
+                __m256d Negative = _mm256_cmp_pd(Inv, Zero, _CMP_LT_OQ);
+                __m256d Lo = _mm256_set1_pd(Min[a]);
+                __m256d Hi = _mm256_set1_pd(Max[a]);
+                __m256d Near = _mm256_blendv_pd(Lo, Hi, Negative);
+                __m256d Far = _mm256_blendv_pd(Hi, Lo, Negative);
+                // max and min keep their second operand on NaN, as the
+                // scalar test keeps its range
+                T0 = _mm256_max_pd(_mm256_mul_pd(_mm256_sub_pd(Near, O), Inv), T0);
+                T1 = _mm256_min_pd(_mm256_mul_pd(_mm256_sub_pd(Far, O), Inv), T1);
+            }
+            T0 = _mm256_sub_pd(T0, _mm256_mul_pd(_mm256_andnot_pd(SignBit, T0), VSlack));
+            T1 = _mm256_add_pd(T1, _mm256_mul_pd(_mm256_andnot_pd(SignBit, T1), VSlack));
+            _mm256_storeu_pd(Enter + i, T0);
+            Hit |= static_cast<LaneMask>(_mm256_movemask_pd(_mm256_cmp_pd(T0, T1, _CMP_LE_OQ))) << i;
+        }
+        return Hit & Active;
+    }
+
+    __attribute__((target("avx2"))) inline __m256d AVX2Dot(const __m256d *A, const __m256d *B)
+    {
+        return _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(A[0], B[0]), _mm256_mul_pd(A[1], B[1])),
+                             _mm256_mul_pd(A[2], B[2]));
+    }
+
+    __attribute__((target("avx2"))) inline void AVX2Cross(const __m256d *A, const __m256d *B, __m256d *Out)
+    {
+        Out[0] = _mm256_sub_pd(_mm256_mul_pd(A[1], B[2]), _mm256_mul_pd(A[2], B[1]));
+        Out[1] = _mm256_sub_pd(_mm256_mul_pd(A[2], B[0]), _mm256_mul_pd(A[0], B[2]));
+        Out[2] = _mm256_sub_pd(_mm256_mul_pd(A[0], B[1]), _mm256_mul_pd(A[1], B[0]));
+    }
+
+    __attribute__((target("avx2"))) LaneMask AVX2Triangle(const RayPacket &P, LaneMask Active, const double *P1,
+                                                          const double *E1, const double *E2, double TMin,
+                                                          const double *TMax, double *T, double *U, double *V)
+    {
+        const __m256d Zero = _mm256_setzero_pd();
+        const __m256d One = _mm256_set1_pd(1.);
+        const __m256d SignBit = _mm256_set1_pd(-0.);
+        const __m256d Epsilon = _mm256_set1_pd(Util::EPSILON);
+        const __m256d VTMin = _mm256_set1_pd(TMin);
+        __m256d VP1[3], VE1[3], VE2[3];
+        for (int a = 0; a < 3; ++a)
+        {
+            VP1[a] = _mm256_set1_pd(P1[a]);
+            VE1[a] = _mm256_set1_pd(E1[a]);
+            VE2[a] = _mm256_set1_pd(E2[a]);
+        }
+
+        LaneMask Hit = 0;
+        for (int i = 0; i < RayPacket::MaxSize; i += 4)
+        {
+            if (!(Active >> i & 0xF))
+                continue;
+
+            __m256d D[3], ToOrigin[3];
+            for (int a = 0; a < 3; ++a)
+            {
+                D[a] = _mm256_load_pd(P.Direction[a] + i);
+                ToOrigin[a] = _mm256_sub_pd(_mm256_load_pd(P.Origin[a] + i), VP1[a]);
+            }
+            __m256d DirCrossE2[3], OriginCrossE1[3];
+            AVX2Cross(D, VE2, DirCrossE2);
+            AVX2Cross(ToOrigin, VE1, OriginCrossE1);
+
+            __m256d Determinant = AVX2Dot(VE1, DirCrossE2);
+            __m256d F = _mm256_div_pd(One, Determinant);
+            __m256d LaneU = _mm256_mul_pd(F, AVX2Dot(ToOrigin, DirCrossE2));
+            __m256d LaneV = _mm256_mul_pd(F, AVX2Dot(D, OriginCrossE1));
+            __m256d LaneT = _mm256_mul_pd(F, AVX2Dot(VE2, OriginCrossE1));
+
+            // the negated comparisons let NaN through like the early returns
+            // of the scalar test
+            __m256d Ok = _mm256_cmp_pd(_mm256_andnot_pd(SignBit, Determinant), Epsilon, _CMP_NLT_UQ);
+            Ok = _mm256_and_pd(Ok, _mm256_cmp_pd(LaneU, Zero, _CMP_NLT_UQ));
+            Ok = _mm256_and_pd(Ok, _mm256_cmp_pd(LaneU, One, _CMP_NGT_UQ));
+            Ok = _mm256_and_pd(Ok, _mm256_cmp_pd(LaneV, Zero, _CMP_NLT_UQ));
+            Ok = _mm256_and_pd(Ok, _mm256_cmp_pd(_mm256_add_pd(LaneU, LaneV), One, _CMP_NGT_UQ));
+            Ok = _mm256_and_pd(Ok, _mm256_cmp_pd(LaneT, VTMin, _CMP_GT_OQ));
+            Ok = _mm256_and_pd(Ok, _mm256_cmp_pd(LaneT, _mm256_loadu_pd(TMax + i), _CMP_LT_OQ));
+
+            _mm256_storeu_pd(T + i, LaneT);
+            _mm256_storeu_pd(U + i, LaneU);
+            _mm256_storeu_pd(V + i, LaneV);
+            Hit |= static_cast<LaneMask>(_mm256_movemask_pd(Ok)) << i;
+        }
+        return Hit & Active;
+    }
+
+    // one ray against four triangles, the roles of the packet test swapped
+    __attribute__((target("avx2"))) LaneMask AVX2Block(const Ray &R, const TriangleBlock &B, int Count, double TMin,
+                                                       double TMax, double *T, double *U, double *V)
+    {
+        const __m256d Zero = _mm256_setzero_pd();
+        const __m256d One = _mm256_set1_pd(1.);
+        const __m256d SignBit = _mm256_set1_pd(-0.);
+        const __m256d Epsilon = _mm256_set1_pd(Util::EPSILON);
+        __m256d D[3], ToOrigin[3], E1[3], E2[3];
+        for (int a = 0; a < 3; ++a)
+        {
+            D[a] = _mm256_set1_pd(R.GetDirection()[a]);
+            ToOrigin[a] = _mm256_sub_pd(_mm256_set1_pd(R.GetOrigin()[a]), _mm256_load_pd(B.P1[a]));
+            E1[a] = _mm256_load_pd(B.E1[a]);
+            E2[a] = _mm256_load_pd(B.E2[a]);
+        }
+        __m256d DirCrossE2[3], OriginCrossE1[3];
+        AVX2Cross(D, E2, DirCrossE2);
+        AVX2Cross(ToOrigin, E1, OriginCrossE1);
+
+        __m256d Determinant = AVX2Dot(E1, DirCrossE2);
+        __m256d F = _mm256_div_pd(One, Determinant);
+        __m256d LaneU = _mm256_mul_pd(F, AVX2Dot(ToOrigin, DirCrossE2));
+        __m256d LaneV = _mm256_mul_pd(F, AVX2Dot(D, OriginCrossE1));
+        __m256d LaneT = _mm256_mul_pd(F, AVX2Dot(E2, OriginCrossE1));
+
+        __m256d Ok = _mm256_cmp_pd(_mm256_andnot_pd(SignBit, Determinant), Epsilon, _CMP_NLT_UQ);
+        Ok = _mm256_and_pd(Ok, _mm256_cmp_pd(LaneU, Zero, _CMP_NLT_UQ));
+        Ok = _mm256_and_pd(Ok, _mm256_cmp_pd(LaneU, One, _CMP_NGT_UQ));
+        Ok = _mm256_and_pd(Ok, _mm256_cmp_pd(LaneV, Zero, _CMP_NLT_UQ));
+        Ok = _mm256_and_pd(Ok, _mm256_cmp_pd(_mm256_add_pd(LaneU, LaneV), One, _CMP_NGT_UQ));
+        Ok = _mm256_and_pd(Ok, _mm256_cmp_pd(LaneT, _mm256_set1_pd(TMin), _CMP_GT_OQ));
+        Ok = _mm256_and_pd(Ok, _mm256_cmp_pd(LaneT, _mm256_set1_pd(TMax), _CMP_LT_OQ));
+
+        _mm256_storeu_pd(T, LaneT);
+        _mm256_storeu_pd(U, LaneU);
+        _mm256_storeu_pd(V, LaneV);
+        return _mm256_movemask_pd(Ok) & ((1 << Count) - 1);
+    }
+#endif
+
+#if defined(RAYTRACER_X86_KERNELS) && defined(RAYTRACER_FLOAT)
+    // ---------------------------------------------------------------------
+    // single precision: a whole tuple fits in one SSE register, so SSE2 keeps
+    // one register per matrix column and AVX2 transforms the origin and the
+    // direction of a ray together, one in each 128-bit half.
+
+    struct SSE2Columns
+    {
+        __m128 C[4];
+    };
+
+    __attribute__((target("sse2"))) inline SSE2Columns SSE2Load(const float *M)
+    {
+        SSE2Columns Cols;
+        Cols.C[0] = _mm_loadu_ps(M);
+        Cols.C[1] = _mm_loadu_ps(M + 4);
+        Cols.C[2] = _mm_loadu_ps(M + 8);
+        Cols.C[3] = _mm_loadu_ps(M + 12);
+        _MM_TRANSPOSE4_PS(Cols.C[0], Cols.C[1], Cols.C[2], Cols.C[3]);
+        return Cols;
+    }
+
+    __attribute__((target("sse2"))) inline __m128 SSE2Linear(const SSE2Columns &Cols, const float *In)
+    {
+        __m128 X = _mm_set1_ps(In[0]);
+        __m128 Y = _mm_set1_ps(In[1]);
+        __m128 Z = _mm_set1_ps(In[2]);
+        return _mm_add_ps(_mm_add_ps(_mm_mul_ps(Cols.C[0], X), _mm_mul_ps(Cols.C[1], Y)), _mm_mul_ps(Cols.C[2], Z));
+    }
+
+    __attribute__((target("sse2"))) inline void SSE2ApplyPoint(const SSE2Columns &Cols, const float *In, float *Out)
+    {
+        _mm_storeu_ps(Out, _mm_add_ps(SSE2Linear(Cols, In), Cols.C[3]));
+        Out[3] = 1.f;
+    }
+
+    __attribute__((target("sse2"))) inline void SSE2ApplyVector(const SSE2Columns &Cols, const float *In, float *Out)
+    {
+        _mm_storeu_ps(Out, SSE2Linear(Cols, In));
+        Out[3] = 0.f;
+    }
+
+    __attribute__((target("sse2"))) void SSE2Point(const float *M, const float *In, float *Out)
+    {
+        SSE2ApplyPoint(SSE2Load(M), In, Out);
+    }
+
+    __attribute__((target("sse2"))) void SSE2Vector(const float *M, const float *In, float *Out)
+    {
+        SSE2ApplyVector(SSE2Load(M), In, Out);
+    }
+
+    __attribute__((target("sse2"))) void SSE2Rays(const float *M, const Ray *In, Ray *Out, std::size_t N)
+    {
+        auto Cols = SSE2Load(M);
+        for (std::size_t i = 0; i < N; ++i)
+        {
+            Point O;
+            Vector D;
+            SSE2ApplyPoint(Cols, In[i].GetOrigin().Data(), O.Data());
+            SSE2ApplyVector(Cols, In[i].GetDirection().Data(), D.Data());
+            Out[i] = Ray(O, D);
+        }
+    }
+
+    // single tuples gain nothing from 8 lanes, AVX2 only differs for rays
+    __attribute__((target("avx2"))) void AVX2Rays(const float *M, const Ray *In, Ray *Out, std::size_t N)
+    {
+        auto Cols = SSE2Load(M);
+        __m256 C[3];
+        for (int c = 0; c < 3; ++c)
+        {
+            C[c] = _mm256_set_m128(Cols.C[c], Cols.C[c]);
+        }
+        // the translation only applies to the origin (lower half)
+        __m256 Translation = _mm256_set_m128(_mm_setzero_ps(), Cols.C[3]);
+
+        for (std::size_t i = 0; i < N; ++i)
+        {
+            const float *O = In[i].GetOrigin().Data();
+            const float *D = In[i].GetDirection().Data();
+            __m256 X = _mm256_set_m128(_mm_set1_ps(D[0]), _mm_set1_ps(O[0]));
+            __m256 Y = _mm256_set_m128(_mm_set1_ps(D[1]), _mm_set1_ps(O[1]));
+            __m256 Z = _mm256_set_m128(_mm_set1_ps(D[2]), _mm_set1_ps(O[2]));
+            __m256 Res = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(C[0], X), _mm256_mul_ps(C[1], Y)),
+                                       _mm256_mul_ps(C[2], Z));
+            Res = _mm256_add_ps(Res, Translation);
+
+            Point ResO;
+            Vector ResD;
+            _mm_storeu_ps(ResO.Data(), _mm256_castps256_ps128(Res));
+            _mm_storeu_ps(ResD.Data(), _mm256_extractf128_ps(Res, 1));
+            ResO.SetW(1.f);
+            ResD.SetW(0.f);
+            Out[i] = Ray(ResO, ResD);
+        }
+    }
+
+    // packets: eight lanes per register. The triangle test keeps F, U, V and
+    // T in double like Triangles::LocalIntersect (1. / Determinant promotes
+    // them), one half of the lanes at a time.
+
+    __attribute__((target("avx2"))) LaneMask AVX2EnterBox(const RayPacket &P, const PacketSlabs &S, LaneMask Active,
+                                                          const float *Min, const float *Max, float TMin,
+                                                          const float *TMax, float Slack, float *Enter)
+    {
+        const __m256 Zero = _mm256_setzero_ps();
+        const __m256 SignBit = _mm256_set1_ps(-0.f);
+        const __m256 VSlack = _mm256_set1_ps(Slack);
+        LaneMask Hit = 0;
+        for (int i = 0; i < RayPacket::MaxSize; i += 8)
+        {
+            if (!(Active >> i & 0xFF))
+                continue;
+
+            __m256 T0 = _mm256_set1_ps(TMin);
+            __m256 T1 = _mm256_loadu_ps(TMax + i);
+            for (int a = 0; a < 3; ++a)
+            {
+                __m256 Inv = _mm256_load_ps(S.InvDirection[a] + i);
+                __m256 O = _mm256_load_ps(P.Origin[a] + i);
+                __m256 Negative = _mm256_cmp_ps(Inv, Zero, _CMP_LT_OQ);
+                __m256 Lo = _mm256_set1_ps(Min[a]);
+                __m256 Hi = _mm256_set1_ps(Max[a]);
+                __m256 Near = _mm256_blendv_ps(Lo, Hi, Negative);
+                __m256 Far = _mm256_blendv_ps(Hi, Lo, Negative);
+                T0 = _mm256_max_ps(_mm256_mul_ps(_mm256_sub_ps(Near, O), Inv), T0);
+                T1 = _mm256_min_ps(_mm256_mul_ps(_mm256_sub_ps(Far, O), Inv), T1);
+            }
+            T0 = _mm256_sub_ps(T0, _mm256_mul_ps(_mm256_andnot_ps(SignBit, T0), VSlack));
+            T1 = _mm256_add_ps(T1, _mm256_mul_ps(_mm256_andnot_ps(SignBit, T1), VSlack));
+            _mm256_storeu_ps(Enter + i, T0);
+            Hit |= static_cast<LaneMask>(_mm256_movemask_ps(_mm256_cmp_ps(T0, T1, _CMP_LE_OQ))) << i;
+        }
+        return Hit & Active;
+    }
+
+    __attribute__((target("avx2"))) inline __m256 AVX2Dot(const __m256 *A, const __m256 *B)
+    {
+        return _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(A[0], B[0]), _mm256_mul_ps(A[1], B[1])),
+                             _mm256_mul_ps(A[2], B[2]));
+    }
+
+    __attribute__((target("avx2"))) inline void AVX2Cross(const __m256 *A, const __m256 *B, __m256 *Out)
+    {
+        Out[0] = _mm256_sub_ps(_mm256_mul_ps(A[1], B[2]), _mm256_mul_ps(A[2], B[1]));
+        Out[1] = _mm256_sub_ps(_mm256_mul_ps(A[2], B[0]), _mm256_mul_ps(A[0], B[2]));
+        Out[2] = _mm256_sub_ps(_mm256_mul_ps(A[0], B[1]), _mm256_mul_ps(A[1], B[0]));
+    }
+
+    __attribute__((target("avx2"))) inline __m256d AVX2Half(__m256 X, int Half)
+    {
+        return _mm256_cvtps_pd(Half ? _mm256_extractf128_ps(X, 1) : _mm256_castps256_ps128(X));
+    }
+
+    __attribute__((target("avx2"))) LaneMask AVX2Triangle(const RayPacket &P, LaneMask Active, const float *P1,
+                                                          const float *E1, const float *E2, float TMin,
+                                                          const float *TMax, float *T, float *U, float *V)
+    {
+        const __m256d Zero = _mm256_setzero_pd();
+        const __m256d One = _mm256_set1_pd(1.);
+        const __m256 SignBit = _mm256_set1_ps(-0.f);
+        const __m256 Epsilon = _mm256_set1_ps(Util::EPSILON);
+        const __m256d VTMin = _mm256_set1_pd(TMin);
+        __m256 VP1[3], VE1[3], VE2[3];
+        for (int a = 0; a < 3; ++a)
+        {
+            VP1[a] = _mm256_set1_ps(P1[a]);
+            VE1[a] = _mm256_set1_ps(E1[a]);
+            VE2[a] = _mm256_set1_ps(E2[a]);
+        }
+
+        LaneMask Hit = 0;
+        for (int i = 0; i < RayPacket::MaxSize; i += 8)
+        {
+            if (!(Active >> i & 0xFF))
+                continue;
+
+            __m256 D[3], ToOrigin[3];
+            for (int a = 0; a < 3; ++a)
+            {
+                D[a] = _mm256_load_ps(P.Direction[a] + i);
+                ToOrigin[a] = _mm256_sub_ps(_mm256_load_ps(P.Origin[a] + i), VP1[a]);
+            }
+            __m256 DirCrossE2[3], OriginCrossE1[3];
+            AVX2Cross(D, VE2, DirCrossE2);
+            AVX2Cross(ToOrigin, VE1, OriginCrossE1);
+
+            __m256 Determinant = AVX2Dot(VE1, DirCrossE2);
+            __m256 DotU = AVX2Dot(ToOrigin, DirCrossE2);
+            __m256 DotV = AVX2Dot(D, OriginCrossE1);
+            __m256 DotT = AVX2Dot(VE2, OriginCrossE1);
+            int Flat = _mm256_movemask_ps(_mm256_cmp_ps(_mm256_andnot_ps(SignBit, Determinant), Epsilon, _CMP_LT_OQ));
+
+            for (int h = 0; h < 2; ++h)
+            {
+                int Lane = i + 4 * h;
+                if (!(Active >> Lane & 0xF))
+                    continue;
+
+                __m256d F = _mm256_div_pd(One, AVX2Half(Determinant, h));
+                __m256d LaneU = _mm256_mul_pd(F, AVX2Half(DotU, h));
+                __m256d LaneV = _mm256_mul_pd(F, AVX2Half(DotV, h));
+                // T is compared once rounded to Real, as it is stored
+                __m128 RealT = _mm256_cvtpd_ps(_mm256_mul_pd(F, AVX2Half(DotT, h)));
+                __m256d LaneT = _mm256_cvtps_pd(RealT);
+
+                __m256d Ok = _mm256_cmp_pd(LaneU, Zero, _CMP_NLT_UQ);
+                Ok = _mm256_and_pd(Ok, _mm256_cmp_pd(LaneU, One, _CMP_NGT_UQ));
+                Ok = _mm256_and_pd(Ok, _mm256_cmp_pd(LaneV, Zero, _CMP_NLT_UQ));
+                Ok = _mm256_and_pd(Ok, _mm256_cmp_pd(_mm256_add_pd(LaneU, LaneV), One, _CMP_NGT_UQ));
+                Ok = _mm256_and_pd(Ok, _mm256_cmp_pd(LaneT, VTMin, _CMP_GT_OQ));
+                Ok = _mm256_and_pd(Ok, _mm256_cmp_pd(LaneT, _mm256_cvtps_pd(_mm_loadu_ps(TMax + Lane)), _CMP_LT_OQ));
+
+                _mm_storeu_ps(T + Lane, RealT);
+                _mm_storeu_ps(U + Lane, _mm256_cvtpd_ps(LaneU));
+                _mm_storeu_ps(V + Lane, _mm256_cvtpd_ps(LaneV));
+                int Mask = _mm256_movemask_pd(Ok) & ~(Flat >> 4 * h);
+                Hit |= static_cast<LaneMask>(Mask & 0xF) << Lane;
+            }
+        }
+        return Hit & Active;
+    }
+
+    __attribute__((target("avx2"))) inline __m128 SSEDot(const __m128 *A, const __m128 *B)
+    {
+        return _mm_add_ps(_mm_add_ps(_mm_mul_ps(A[0], B[0]), _mm_mul_ps(A[1], B[1])), _mm_mul_ps(A[2], B[2]));
+    }
+
+    __attribute__((target("avx2"))) inline void SSECross(const __m128 *A, const __m128 *B, __m128 *Out)
+    {
+        Out[0] = _mm_sub_ps(_mm_mul_ps(A[1], B[2]), _mm_mul_ps(A[2], B[1]));
+        Out[1] = _mm_sub_ps(_mm_mul_ps(A[2], B[0]), _mm_mul_ps(A[0], B[2]));
+        Out[2] = _mm_sub_ps(_mm_mul_ps(A[0], B[1]), _mm_mul_ps(A[1], B[0]));
+    }
+
+    // one ray against four triangles: the products in float (one SSE
+    // register), F, U, V and T in double (one AVX register)
+    __attribute__((target("avx2"))) LaneMask AVX2Block(const Ray &R, const TriangleBlock &B, int Count, float TMin,
+                                                       float TMax, float *T, float *U, float *V)
+    {
+        const __m256d Zero = _mm256_setzero_pd();
+        const __m256d One = _mm256_set1_pd(1.);
+        const __m128 SignBit = _mm_set1_ps(-0.f);
+        __m128 D[3], ToOrigin[3], E1[3], E2[3];
+        for (int a = 0; a < 3; ++a)
+        {
+            D[a] = _mm_set1_ps(R.GetDirection()[a]);
+            ToOrigin[a] = _mm_sub_ps(_mm_set1_ps(R.GetOrigin()[a]), _mm_load_ps(B.P1[a]));
+            E1[a] = _mm_load_ps(B.E1[a]);
+            E2[a] = _mm_load_ps(B.E2[a]);
+        }
+        __m128 DirCrossE2[3], OriginCrossE1[3];
+        SSECross(D, E2, DirCrossE2);
+        SSECross(ToOrigin, E1, OriginCrossE1);
+
+        __m128 Determinant = SSEDot(E1, DirCrossE2);
+        int Flat = _mm_movemask_ps(_mm_cmplt_ps(_mm_andnot_ps(SignBit, Determinant), _mm_set1_ps(Util::EPSILON)));
+
+        __m256d F = _mm256_div_pd(One, _mm256_cvtps_pd(Determinant));
+        __m256d LaneU = _mm256_mul_pd(F, _mm256_cvtps_pd(SSEDot(ToOrigin, DirCrossE2)));
+        __m256d LaneV = _mm256_mul_pd(F, _mm256_cvtps_pd(SSEDot(D, OriginCrossE1)));
+        // T is compared once rounded to Real, as it is stored
+        __m128 RealT = _mm256_cvtpd_ps(_mm256_mul_pd(F, _mm256_cvtps_pd(SSEDot(E2, OriginCrossE1))));
+        __m256d LaneT = _mm256_cvtps_pd(RealT);
+
+        __m256d Ok = _mm256_cmp_pd(LaneU, Zero, _CMP_NLT_UQ);
+        Ok = _mm256_and_pd(Ok, _mm256_cmp_pd(LaneU, One, _CMP_NGT_UQ));
+        Ok = _mm256_and_pd(Ok, _mm256_cmp_pd(LaneV, Zero, _CMP_NLT_UQ));
+        Ok = _mm256_and_pd(Ok, _mm256_cmp_pd(_mm256_add_pd(LaneU, LaneV), One, _CMP_NGT_UQ));
+        Ok = _mm256_and_pd(Ok, _mm256_cmp_pd(LaneT, _mm256_set1_pd(TMin), _CMP_GT_OQ));
+        Ok = _mm256_and_pd(Ok, _mm256_cmp_pd(LaneT, _mm256_set1_pd(TMax), _CMP_LT_OQ));
+
+        _mm_storeu_ps(T, RealT);
+        _mm_storeu_ps(U, _mm256_cvtpd_ps(LaneU));
+        _mm_storeu_ps(V, _mm256_cvtpd_ps(LaneV));
+        return _mm256_movemask_pd(Ok) & ~Flat & ((1 << Count) - 1);
+    }
+#endif
+
+    Kernels KernelsFor(SIMD::Level L)
+    {
+#ifdef RAYTRACER_X86_KERNELS
+        if (L == SIMD::Level::AVX2)
+#ifdef RAYTRACER_FLOAT
+            return Kernels{SSE2Point, SSE2Vector, AVX2Rays, AVX2EnterBox, AVX2Triangle, AVX2Block};
+#else
+            return Kernels{AVX2Point, AVX2Vector, AVX2Rays, AVX2EnterBox, AVX2Triangle, AVX2Block};
+#endif
+        if (L == SIMD::Level::SSE2)
+            return Kernels{SSE2Point, SSE2Vector, SSE2Rays, ScalarEnterBox, ScalarTriangle, ScalarBlock};
+#endif
+        return Kernels{ScalarPoint, ScalarVector, ScalarRays, ScalarEnterBox, ScalarTriangle, ScalarBlock};
+    }
+
+    // start on the scalar kernels (constant-initialized, so they are valid even
+    // during static initialization) and switch to the best level at startup
+    SIMD::Level ActiveLevel = SIMD::Level::Scalar;
+    Kernels Active = {ScalarPoint, ScalarVector, ScalarRays, ScalarEnterBox, ScalarTriangle, ScalarBlock};
+    [[maybe_unused]] const bool Dispatched = (SIMD::SetLevel(SIMD::Detect()), true);
+}
+
+SIMD::Level SIMD::Detect()
+{
+#ifdef RAYTRACER_X86_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return Level::AVX2;
+    if (__builtin_cpu_supports("sse2"))
+        return Level::SSE2;
+#endif
+    return Level::Scalar;
+}
+
+SIMD::Level SIMD::GetLevel()
+{
+    return ActiveLevel;
+}
+
+void SIMD::SetLevel(Level L)
+{
+    if (static_cast<int>(L) > static_cast<int>(Detect()))
+        L = Detect();
+
+    ActiveLevel = L;
+    Active = KernelsFor(L);
+}
+
+const char *SIMD::LevelName(Level L)
+{
+    switch (L)
+    {
+    case Level::AVX2:
+        return "avx2";
+    case Level::SSE2:
+        return "sse2";
+    default:
+        return "scalar";
+    }
+}
+
+Point SIMD::TransformPoint(const Matrix &M, const Point &P)
+{
+    Point Res;
+    Active.Point(M.Data(), P.Data(), Res.Data());
+    return Res;
+}
+
+Vector SIMD::TransformVector(const Matrix &M, const Vector &V)
+{
+    Vector Res;
+    Active.Vector(M.Data(), V.Data(), Res.Data());
+    return Res;
+}
+
+Ray SIMD::TransformRay(const Matrix &M, const Ray &R)
+{
+    Ray Res;
+    Active.Rays(M.Data(), &R, &Res, 1);
+    return Res;
+}
+
+void SIMD::TransformRays(const Matrix &M, const Ray *In, Ray *Out, std::size_t N)
+{
+    Active.Rays(M.Data(), In, Out, N);
+}
+
+LaneMask SIMD::EnterBox(const RayPacket &P, const PacketSlabs &S, LaneMask Lanes, const float *Min, const float *Max,
+                        Real TMin, const Real *TMax, Real Slack, Real *Enter)
+{
+    return Active.EnterBox(P, S, Lanes, Min, Max, TMin, TMax, Slack, Enter);
+}
+
+LaneMask SIMD::IntersectTriangle(const RayPacket &P, LaneMask Lanes, const Real *P1, const Real *E1, const Real *E2,
+                                 Real TMin, const Real *TMax, Real *T, Real *U, Real *V)
+{
+    return Active.Triangle(P, Lanes, P1, E1, E2, TMin, TMax, T, U, V);
+}
+
+LaneMask SIMD::IntersectTriangles(const Ray &R, const TriangleBlock &B, int Count, Real TMin, Real TMax,
+                                  Real *T, Real *U, Real *V)
+{
+    return Active.Block(R, B, Count, TMin, TMax, T, U, V);
+}
@@ -3,6 +3,7 @@
 #include <stdexcept>
 #include <cmath>
 #include <memory>
+#include <utility>
 #include "include/Sphere.h"
 #include "include/Ray.h"
 #include "include/Intersection.h"
@@ -35,48 +36,34 @@ Vector Sphere::LocalNormalAt(Point &LocalPoint)
     return LocalPoint - Origin;
 }
 
-std::vector<Intersection<Object>> Sphere::Intersect(const Ray &R)
+void Sphere::LocalIntersect(const Ray &LocalRay, std::vector<Intersection<Object>> &XS)
 {
-    std::vector<Intersection<Object>> Intersections;
-
-    auto TransformedRay = R.Transform(TransformInverse);
-
-    // assume the origin of Sphere is always (0., 0., 0.)
-    Vector SphereToRay = TransformedRay.GetOrigin() - Point(0., 0., 0.);
-    double A = TransformedRay.GetDirection().Dot(TransformedRay.GetDirection());
-    double B = 2 * TransformedRay.GetDirection().Dot(SphereToRay);
-    double C = SphereToRay.Dot(SphereToRay) - 1.;
-
-    double Discriminant = B * B - 4 * A * C;
-
-    if (Discriminant >= 0.)
-    {
-        Intersections.push_back(Intersection<Object>((-B - std::sqrt(Discriminant)) / (2 * A), *this));
-        Intersections.push_back(Intersection<Object>((-B + std::sqrt(Discriminant)) / (2 * A), *this));
-    }
-
-    return Intersections;
-}
-
-std::vector<Intersection<Object>> Sphere::LocalIntersect(const Ray &LocalRay)
-{
-    std::vector<Intersection<Object>> Intersections;
-
     // assume the origin of Sphere is always (0., 0., 0.)
     Vector SphereToRay = LocalRay.GetOrigin() - Point(0., 0., 0.);
-    double A = LocalRay.GetDirection().Dot(LocalRay.GetDirection());
-    double B = 2 * LocalRay.GetDirection().Dot(SphereToRay);
-    double C = SphereToRay.Dot(SphereToRay) - 1.;
-
-    double Discriminant = B * B - 4 * A * C;
+    const Vector &Direction = LocalRay.GetDirection();
+    Real A = Direction.Dot(Direction);
+    Real HalfB = Direction.Dot(SphereToRay);
+    Real C = SphereToRay.Dot(SphereToRay) - 1.;
+
+    // B * B - 4 * A * C over 4, from the point of the ray closest to the
+    // center rather than as a difference of two large terms: flattened
+    // spheres stretch the local rays, and the hits would lose their
+    // precision well before float runs out of it
+    Vector Closest = SphereToRay - Direction * (HalfB / A);
+    Real Discriminant = A * (1. - Closest.Dot(Closest));
 
     if (Discriminant >= 0.)
     {
-        Intersections.push_back(Intersection<Object>((-B - std::sqrt(Discriminant)) / (2 * A), this));
-        Intersections.push_back(Intersection<Object>((-B + std::sqrt(Discriminant)) / (2 * A), this));
+        // -B and the root of the discriminant are never subtracted: the root
+        // closer to zero comes from the product of the roots, C / A
+        Real Q = -(HalfB + std::copysign(std::sqrt(Discriminant), HalfB));
+        Real T0 = Q / A;
+        Real T1 = Q != 0. ? C / Q : T0;
+        if (T0 > T1)
+            std::swap(T0, T1);
+        XS.push_back(Intersection<Object>(T0, this));
+        XS.push_back(Intersection<Object>(T1, this));
     }
-
-    return Intersections;
 }
 
 Sphere Sphere::GlassSphere()
@@ -26,7 +26,7 @@ Matrix Transformations::ViewTransform(Point &&From, Point &&To, Vector &&Up)
     return ViewTransform(From, To, Up);
 }
 
-Matrix Transformations::Translation(double X, double Y, double Z)
+Matrix Transformations::Translation(Real X, Real Y, Real Z)
 {
     Matrix Res = Matrix::Identity(4);
     Res(0, 3) = X;
@@ -35,7 +35,7 @@ Matrix Transformations::Translation(double X, double Y, double Z)
     return Res;
 }
 
-Matrix Transformations::Scaling(double X, double Y, double Z)
+Matrix Transformations::Scaling(Real X, Real Y, Real Z)
 {
     Matrix Res = Matrix::Identity(4);
     Res(0, 0) = X;
@@ -44,11 +44,11 @@ Matrix Transformations::Scaling(double X, double Y, double Z)
     return Res;
 }
 
-Matrix Transformations::RotationX(double Rad)
+Matrix Transformations::RotationX(Real Rad)
 {
     Matrix Res = Matrix::Identity(4);
-    double Sin = std::sin(Rad);
-    double Cos = std::cos(Rad);
+    Real Sin = std::sin(Rad);
+    Real Cos = std::cos(Rad);
     Res(1, 1) = Cos;
     Res(1, 2) = -Sin;
     Res(2, 1) = Sin;
@@ -56,11 +56,11 @@ Matrix Transformations::RotationX(double Rad)
     return Res;
 }
 
-Matrix Transformations::RotationY(double Rad)
+Matrix Transformations::RotationY(Real Rad)
 {
     Matrix Res = Matrix::Identity(4);
-    double Sin = std::sin(Rad);
-    double Cos = std::cos(Rad);
+    Real Sin = std::sin(Rad);
+    Real Cos = std::cos(Rad);
     Res(0, 0) = Cos;
     Res(0, 2) = Sin;
     Res(2, 0) = -Sin;
@@ -68,11 +68,11 @@ Matrix Transformations::RotationY(double Rad)
     return Res;
 }
 
-Matrix Transformations::RotationZ(double Rad)
+Matrix Transformations::RotationZ(Real Rad)
 {
     Matrix Res = Matrix::Identity(4);
-    double Sin = std::sin(Rad);
-    double Cos = std::cos(Rad);
+    Real Sin = std::sin(Rad);
+    Real Cos = std::cos(Rad);
     Res(0, 0) = Cos;
     Res(0, 1) = -Sin;
     Res(1, 0) = Sin;
@@ -80,7 +80,7 @@ Matrix Transformations::RotationZ(double Rad)
     return Res;
 }
 
-Matrix Transformations::Shearing(double XY, double XZ, double YX, double YZ, double ZX, double ZY)
+Matrix Transformations::Shearing(Real XY, Real XZ, Real YX, Real YZ, Real ZX, Real ZY)
 {
     Matrix Res = Matrix::Identity(4);
     Res(0, 1) = XY;
@@ -0,0 +1,820 @@
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include "include/TriangleMesh.h"
+#include "include/BoundingBoxes.h"
+#include "include/SIMD.h"
+
+using namespace BVHTraversal;
+using namespace BVHBuild;
+
+namespace
+{
+    // triangle being sorted into the hierarchy
+    struct MeshItem
+    {
+        uint32_t Triangle;
+        BoundingBoxes Box;
+        Point Centroid;
+    };
+
+    // append Sub, a hierarchy built on its own, to Nodes; the offsets of its
+    // leaves are moved by LeafBase
+    void AppendNodes(std::vector<BVHNode> &Nodes, const std::vector<BVHNode> &Sub, uint32_t LeafBase = 0)
+    {
+        auto Base = static_cast<uint32_t>(Nodes.size());
+        for (auto N : Sub)
+        {
+            N.Offset += N.Count == 0 ? Base : LeafBase;
+            Nodes.push_back(N);
+        }
+    }
+
+    // append the subtree of Items[Begin, End) to Nodes and return its depth;
+    // a large left half is built on a thread of its own
+    int EmitNodes(std::vector<BVHNode> &Nodes, std::vector<MeshItem> &Items, std::size_t Begin, std::size_t End,
+                  const BVHCost &Cost, int Threads)
+    {
+        BoundingBoxes Box;
+        for (auto i = Begin; i < End; ++i)
+        {
+            Box.AddBox(Items[i].Box);
+        }
+
+        BVHNode Node;
+        Node.SetBounds(Box);
+        auto Mid = End - Begin > 1 ? SplitItems(Items, Begin, End, Box, Cost) : End;
+        if (Mid == End)
+        {
+            Node.Offset = Begin;
+            Node.Count = End - Begin;
+            Nodes.push_back(Node);
+            return 1;
+        }
+
+        auto Index = Nodes.size();
+        Node.Count = 0;
+        Nodes.push_back(Node);
+
+        int Depth;
+        if (Threads > 1 && Mid - Begin >= ParallelGrain)
+        {
+            std::vector<BVHNode> Left, Right;
+            int LeftDepth = 0;
+            ThreadPool::TaskGroup Pending{ThreadPool::shared()};
+            Pending.run([&]() { LeftDepth = EmitNodes(Left, Items, Begin, Mid, Cost, Threads - Threads / 2); });
+            auto RightDepth = EmitNodes(Right, Items, Mid, End, Cost, Threads / 2);
+            Pending.wait();
+            Depth = std::max(LeftDepth, RightDepth);
+
+            AppendNodes(Nodes, Left);
+            Nodes[Index].Offset = Nodes.size();
+            AppendNodes(Nodes, Right);
+        }
+        else
+        {
+            Depth = EmitNodes(Nodes, Items, Begin, Mid, Cost, 1);
+            Nodes[Index].Offset = Nodes.size();
+            Depth = std::max(Depth, EmitNodes(Nodes, Items, Mid, End, Cost, 1));
+        }
+        return Depth + 1;
+    }
+
+    bool IsEmpty(const BoundingBoxes &Box)
+    {
+        for (int a = 0; a < 3; ++a)
+        {
+            if (!(Box.Min[a] <= Box.Max[a]))
+                return true;
+        }
+        return false;
+    }
+
+    BoundingBoxes Overlap(const BoundingBoxes &A, const BoundingBoxes &B)
+    {
+        BoundingBoxes Box;
+        for (int a = 0; a < 3; ++a)
+        {
+            Box.Min[a] = std::max(A.Min[a], B.Min[a]);
+            Box.Max[a] = std::min(A.Max[a], B.Max[a]);
+        }
+        return Box;
+    }
+
+    // bounds of the part of triangle P between Lo and Hi along Axis
+    BoundingBoxes ClipTriangle(const Point (&P)[3], int Axis, Real Lo, Real Hi)
+    {
+        BoundingBoxes Box;
+        for (int c = 0; c < 3; ++c)
+        {
+            auto &A = P[c];
+            auto &B = P[(c + 1) % 3];
+            if (A[Axis] >= Lo && A[Axis] <= Hi)
+                Box.AddPoint(A);
+            for (auto Plane : {Lo, Hi})
+            {
+                if ((A[Axis] < Plane && B[Axis] > Plane) || (A[Axis] > Plane && B[Axis] < Plane))
+                {
+                    auto Q = A + (B - A) * ((Plane - A[Axis]) / (B[Axis] - A[Axis]));
+                    Q[Axis] = Plane;
+                    Box.AddPoint(Q);
+                }
+            }
+        }
+        return Box;
+    }
+
+    // split at Plane along Axis, Cost as in BVHBuild::ObjectSplit
+    struct SpatialSplit
+    {
+        Real Cost = Util::Inf;
+        int Axis = -1;
+        Real Plane = 0;
+    };
+
+    // binned SAH build that also tries spatial splits (Stich et al., "Spatial
+    // Splits in Bounding Volume Hierarchies"): a triangle straddling the plane
+    // is referenced by both halves, each with the box of its own part. The
+    // references of a leaf are appended to Leaves, which its Offset indexes
+    class SpatialBuilder
+    {
+        const TriangleMesh &Mesh;
+        const BVHCost &Cost;
+        // spatial splits are only tried where the halves of the best object
+        // split overlap by more than this area
+        Real MinOverlap;
+
+    public:
+        SpatialBuilder(const TriangleMesh &M, const BVHCost &C, Real RootArea)
+            : Mesh(M), Cost(C), MinOverlap(1e-5 * RootArea)
+        {
+        }
+
+        // append the subtree of Items to Nodes and return its depth; Budget
+        // is the number of references its splits may still duplicate
+        int Emit(std::vector<BVHNode> &Nodes, std::vector<uint32_t> &Leaves, std::vector<MeshItem> &Items,
+                 std::size_t Budget, int Threads)
+        {
+            auto N = Items.size();
+            BoundingBoxes Box;
+            for (auto &It : Items)
+            {
+                Box.AddBox(It.Box);
+            }
+
+            BVHNode Node;
+            Node.SetBounds(Box);
+            std::vector<MeshItem> Left, Right;
+            if (N > 1)
+                Split(Items, Box, Budget, Left, Right);
+            if (Left.empty())
+            {
+                Node.Offset = Leaves.size();
+                Node.Count = N;
+                for (auto &It : Items)
+                    Leaves.push_back(It.Triangle);
+                Nodes.push_back(Node);
+                return 1;
+            }
+
+            // what is left of the budget is shared by the halves by size
+            Budget -= Left.size() + Right.size() - N;
+            auto LeftBudget = Budget * Left.size() / (Left.size() + Right.size());
+            auto RightBudget = Budget - LeftBudget;
+            std::vector<MeshItem>().swap(Items);
+
+            auto Index = Nodes.size();
+            Node.Count = 0;
+            Nodes.push_back(Node);
+
+            int Depth;
+            if (Threads > 1 && Left.size() >= ParallelGrain)
+            {
+                std::vector<BVHNode> LeftNodes, RightNodes;
+                std::vector<uint32_t> LeftLeaves, RightLeaves;
+                int LeftDepth = 0;
+                ThreadPool::TaskGroup Pending{ThreadPool::shared()};
+                Pending.run([&]() { LeftDepth = Emit(LeftNodes, LeftLeaves, Left, LeftBudget, Threads - Threads / 2); });
+                auto RightDepth = Emit(RightNodes, RightLeaves, Right, RightBudget, Threads / 2);
+                Pending.wait();
+                Depth = std::max(LeftDepth, RightDepth);
+
+                AppendNodes(Nodes, LeftNodes, Leaves.size());
+                Leaves.insert(Leaves.end(), LeftLeaves.begin(), LeftLeaves.end());
+                Nodes[Index].Offset = Nodes.size();
+                AppendNodes(Nodes, RightNodes, Leaves.size());
+                Leaves.insert(Leaves.end(), RightLeaves.begin(), RightLeaves.end());
+            }
+            else
+            {
+                Depth = Emit(Nodes, Leaves, Left, LeftBudget, 1);
+                Nodes[Index].Offset = Nodes.size();
+                Depth = std::max(Depth, Emit(Nodes, Leaves, Right, RightBudget, 1));
+            }
+            return Depth + 1;
+        }
+
+    private:
+        // sort Items (bounded by Box) into Left and Right, or leave both empty
+        // when keeping a leaf is cheaper
+        void Split(const std::vector<MeshItem> &Items, const BoundingBoxes &Box, std::size_t Budget,
+                   std::vector<MeshItem> &Left, std::vector<MeshItem> &Right)
+        {
+            auto N = Items.size();
+            auto Object = FindObjectSplit(Items, 0, N, Cost);
+            auto Area = Box.SurfaceArea();
+
+            SpatialSplit Spatial;
+            if (Area > 0 && Budget > 0 && (Object.Axis < 0 || ObjectOverlap(Items, Object) > MinOverlap))
+                Spatial = FindSpatialSplit(Items, Box);
+
+            auto BestCost = std::min(Object.Cost, Spatial.Cost);
+            if (Area > 0 && BestCost < Util::Inf)
+            {
+                auto SplitCost = Cost.Traversal + Cost.Intersection * BestCost / Area;
+                if (N <= static_cast<std::size_t>(Cost.MaxLeafSize) &&
+                    Cost.Intersection * LeafBlocks(Cost, N) <= SplitCost)
+                    return;
+                if (Spatial.Cost < Object.Cost && SplitAtPlane(Items, Spatial, Budget, Left, Right))
+                    return;
+                if (Object.Axis >= 0)
+                {
+                    for (auto &It : Items)
+                        (Object.GoesLeft(It) ? Left : Right).push_back(It);
+                    return;
+                }
+            }
+
+            if (N <= static_cast<std::size_t>(Cost.MaxLeafSize))
+                return;
+
+            // all centroids coincide (or the boxes are flat), split by count
+            Left.assign(Items.begin(), Items.begin() + N / 2);
+            Right.assign(Items.begin() + N / 2, Items.end());
+        }
+
+        // surface area shared by the halves of an object split
+        Real ObjectOverlap(const std::vector<MeshItem> &Items, const ObjectSplit &Object) const
+        {
+            BoundingBoxes Left, Right;
+            for (auto &It : Items)
+                (Object.GoesLeft(It) ? Left : Right).AddBox(It.Box);
+            auto Shared = Overlap(Left, Right);
+            return IsEmpty(Shared) ? 0 : Shared.SurfaceArea();
+        }
+
+        // best of the planes between Cost.Bins equal bins along each axis of
+        // Box: a reference counts in every bin its triangle crosses, with the
+        // bounds of the part inside
+        SpatialSplit FindSpatialSplit(const std::vector<MeshItem> &Items, const BoundingBoxes &Box) const
+        {
+            SpatialSplit Best;
+            auto Bins = std::max(Cost.Bins, 2);
+            std::vector<BoundingBoxes> Bin(Bins);
+            std::vector<std::size_t> Entries(Bins), Exits(Bins);
+            std::vector<Real> RightArea(Bins);
+            Point P[3];
+            for (int Axis = 0; Axis < 3; ++Axis)
+            {
+                auto Min = Box.Min[Axis];
+                auto Extent = Box.Max[Axis] - Min;
+                if (!(Extent > 0))
+                    continue;
+
+                std::fill(Bin.begin(), Bin.end(), BoundingBoxes());
+                std::fill(Entries.begin(), Entries.end(), 0);
+                std::fill(Exits.begin(), Exits.end(), 0);
+                auto Scale = Bins / Extent;
+                auto BinAt = [&](Real X) { return std::min(std::max(static_cast<int>((X - Min) * Scale), 0), Bins - 1); };
+                for (auto &It : Items)
+                {
+                    auto First = BinAt(It.Box.Min[Axis]);
+                    auto Last = BinAt(It.Box.Max[Axis]);
+                    ++Entries[First];
+                    ++Exits[Last];
+                    if (First == Last)
+                    {
+                        Bin[First].AddBox(It.Box);
+                        continue;
+                    }
+
+                    for (int c = 0; c < 3; ++c)
+                        P[c] = Mesh.GetVertex(It.Triangle, c);
+                    for (auto b = First; b <= Last; ++b)
+                    {
+                        auto Lo = b == First ? It.Box.Min[Axis] : Min + b / Scale;
+                        auto Hi = b == Last ? It.Box.Max[Axis] : Min + (b + 1) / Scale;
+                        auto Part = Overlap(ClipTriangle(P, Axis, Lo, Hi), It.Box);
+                        if (!IsEmpty(Part))
+                            Bin[b].AddBox(Part);
+                    }
+                }
+
+                // same sweeps as the object split, counting the references
+                // that enter a bin on the left and leave one on the right
+                BoundingBoxes Right;
+                for (int i = Bins - 1; i > 0; --i)
+                {
+                    if (!IsEmpty(Bin[i]))
+                        Right.AddBox(Bin[i]);
+                    RightArea[i] = Right.SurfaceArea();
+                }
+                BoundingBoxes Left;
+                std::size_t LeftCount = 0, RightCount = Items.size();
+                for (int i = 0; i < Bins - 1; ++i)
+                {
+                    if (!IsEmpty(Bin[i]))
+                        Left.AddBox(Bin[i]);
+                    LeftCount += Entries[i];
+                    RightCount -= Exits[i];
+                    if (LeftCount == 0 || RightCount == 0)
+                        continue;
+                    auto SplitCost = LeafBlocks(Cost, LeftCount) * Left.SurfaceArea() +
+                                     LeafBlocks(Cost, RightCount) * RightArea[i + 1];
+                    if (SplitCost < Best.Cost)
+                    {
+                        Best.Cost = SplitCost;
+                        Best.Axis = Axis;
+                        Best.Plane = Min + (i + 1) / Scale;
+                    }
+                }
+            }
+            return Best;
+        }
+
+        // sort Items to the sides of the plane of Split, clipping the ones that
+        // straddle it; fails when that duplicates more than Budget references
+        // or leaves a side empty
+        bool SplitAtPlane(const std::vector<MeshItem> &Items, const SpatialSplit &Split, std::size_t Budget,
+                          std::vector<MeshItem> &Left, std::vector<MeshItem> &Right) const
+        {
+            auto Axis = Split.Axis;
+            auto Plane = Split.Plane;
+            auto Straddling = std::count_if(Items.begin(), Items.end(), [&](const MeshItem &It) {
+                return It.Box.Min[Axis] < Plane && It.Box.Max[Axis] > Plane;
+            });
+            if (static_cast<std::size_t>(Straddling) > Budget)
+                return false;
+
+            Point P[3];
+            for (auto &It : Items)
+            {
+                if (It.Box.Max[Axis] <= Plane)
+                {
+                    Left.push_back(It);
+                    continue;
+                }
+                if (It.Box.Min[Axis] >= Plane)
+                {
+                    Right.push_back(It);
+                    continue;
+                }
+
+                for (int c = 0; c < 3; ++c)
+                    P[c] = Mesh.GetVertex(It.Triangle, c);
+                auto LeftPart = Overlap(ClipTriangle(P, Axis, It.Box.Min[Axis], Plane), It.Box);
+                auto RightPart = Overlap(ClipTriangle(P, Axis, Plane, It.Box.Max[Axis]), It.Box);
+                if (!IsEmpty(LeftPart))
+                    Left.push_back({It.Triangle, LeftPart, LeftPart.Centroid()});
+                if (!IsEmpty(RightPart))
+                    Right.push_back({It.Triangle, RightPart, RightPart.Centroid()});
+            }
+
+            if (Left.empty() || Right.empty())
+            {
+                Left.clear();
+                Right.clear();
+                return false;
+            }
+            return true;
+        }
+    };
+}
+
+TriangleMesh::TriangleMesh(int ID)
+{
+    Transform = Matrix::Identity();
+    TransformInverse = Matrix::Identity();
+    Origin = Point(0., 0., 0.);
+    AMaterial = Material();
+    UseShadow = true;
+    this->ID = ID;
+    Parent = nullptr;
+}
+
+TriangleMesh::TriangleMesh() : TriangleMesh(0)
+{
+}
+
+int TriangleMesh::GetID()
+{
+    return ID;
+}
+
+uint32_t TriangleMesh::AddVertex(const Point &P)
+{
+    for (int a = 0; a < 3; ++a)
+    {
+        Vertices[a].push_back(P[a]);
+    }
+    Changed();
+    return VertexCount() - 1;
+}
+
+uint32_t TriangleMesh::AddNormal(const Vector &N)
+{
+    for (int a = 0; a < 3; ++a)
+    {
+        Normals[a].push_back(N[a]);
+    }
+    return NormalCount() - 1;
+}
+
+uint32_t TriangleMesh::AddTriangle(uint32_t A, uint32_t B, uint32_t C)
+{
+    return AddTriangle(A, B, C, Flat, Flat, Flat);
+}
+
+uint32_t TriangleMesh::AddTriangle(uint32_t A, uint32_t B, uint32_t C, uint32_t NA, uint32_t NB, uint32_t NC)
+{
+    for (auto V : {A, B, C})
+    {
+        if (V >= VertexCount())
+            throw std::invalid_argument("vertex index is invalid");
+    }
+
+    bool Smooth = NA != Flat || NB != Flat || NC != Flat;
+    if (Smooth)
+    {
+        for (auto N : {NA, NB, NC})
+        {
+            if (N >= NormalCount())
+                throw std::invalid_argument("normal index is invalid");
+        }
+
+        // the earlier triangles were all flat
+        if (NormalIndices.empty())
+            NormalIndices.assign(VertexIndices.size(), Flat);
+    }
+
+    VertexIndices.insert(VertexIndices.end(), {A, B, C});
+    if (!NormalIndices.empty())
+        NormalIndices.insert(NormalIndices.end(), {NA, NB, NC});
+
+    Changed();
+    return TriangleCount() - 1;
+}
+
+Point TriangleMesh::GetVertex(uint32_t Triangle, int Corner) const
+{
+    auto V = VertexIndices[3 * Triangle + Corner];
+    return Point(Vertices[0][V], Vertices[1][V], Vertices[2][V]);
+}
+
+Vector TriangleMesh::GetNormal(uint32_t Triangle, int Corner) const
+{
+    auto N = NormalIndices[3 * Triangle + Corner];
+    return Vector(Normals[0][N], Normals[1][N], Normals[2][N]);
+}
+
+bool TriangleMesh::IsSmooth(uint32_t Triangle) const
+{
+    return !NormalIndices.empty() && NormalIndices[3 * Triangle] != Flat;
+}
+
+size_t TriangleMesh::MemoryUsage() const
+{
+    return 3 * (Vertices[0].capacity() + Normals[0].capacity()) * sizeof(Real) +
+           (VertexIndices.capacity() + NormalIndices.capacity() + Order.capacity()) * sizeof(uint32_t) +
+           Nodes.capacity() * sizeof(BVHNode) + Blocks.capacity() * sizeof(TriangleBlock);
+}
+
+Vector TriangleMesh::LocalNormalAt(Point &LocalPoint, Intersection<Object> &I)
+{
+    auto Triangle = I.GetIndex();
+    if (IsSmooth(Triangle))
+    {
+        return GetNormal(Triangle, 1) * I.GetU() +
+               GetNormal(Triangle, 2) * I.GetV() +
+               GetNormal(Triangle, 0) * (1 - I.GetU() - I.GetV());
+    }
+
+    auto P1 = GetVertex(Triangle, 0);
+    Vector E1 = GetVertex(Triangle, 1) - P1;
+    Vector E2 = GetVertex(Triangle, 2) - P1;
+    return E2.Cross(E1).Normalize();
+}
+
+Vector TriangleMesh::LocalNormalAt(Point &&LocalPoint, Intersection<Object> &I)
+{
+    return LocalNormalAt(LocalPoint, I);
+}
+
+bool TriangleMesh::IntersectTriangle(uint32_t Triangle, const Ray &R, Real &T, Real &U, Real &V) const
+{
+    auto P1 = GetVertex(Triangle, 0);
+    Vector E1 = GetVertex(Triangle, 1) - P1;
+    Vector E2 = GetVertex(Triangle, 2) - P1;
+
+    auto DirCrossE2 = R.GetDirection().Cross(E2);
+    auto Determinant = E1.Dot(DirCrossE2);
+
+    if (std::abs(Determinant) < Util::EPSILON)
+        return false;
+
+    auto F = 1. / Determinant;
+    auto P1ToOrigin = R.GetOrigin() - P1;
+    auto HitU = F * P1ToOrigin.Dot(DirCrossE2);
+
+    if (HitU < 0. || HitU > 1.)
+        return false;
+
+    auto OriginCrossE1 = P1ToOrigin.Cross(E1);
+    auto HitV = F * R.GetDirection().Dot(OriginCrossE1);
+
+    if (HitV < 0. || (HitU + HitV) > 1.)
+        return false;
+
+    T = F * E2.Dot(OriginCrossE1);
+    U = HitU;
+    V = HitV;
+    return true;
+}
+
+void TriangleMesh::GetEdges(uint32_t Slot, Real *P1, Real *E1, Real *E2) const
+{
+    auto &B = Blocks[Slot / TriangleBlock::Width];
+    auto Lane = Slot % TriangleBlock::Width;
+    for (int a = 0; a < 3; ++a)
+    {
+        P1[a] = B.P1[a][Lane];
+        E1[a] = B.E1[a][Lane];
+        E2[a] = B.E2[a][Lane];
+    }
+}
+
+void TriangleMesh::LocalIntersect(const Ray &LocalRay, std::vector<Intersection<Object>> &XS)
+{
+    if (Nodes.empty())
+    {
+        for (uint32_t i = 0; i < TriangleCount(); ++i)
+        {
+            Real T, U, V;
+            if (IntersectTriangle(i, LocalRay, T, U, V))
+                XS.push_back(Intersection<Object>(T, this, U, V, i));
+        }
+        return;
+    }
+
+    auto First = XS.size();
+    const Real TMax = std::numeric_limits<Real>::infinity();
+    Traverse(Nodes, 0, LocalRay, -TMax, TMax, [&](const BVHNode &N) {
+        Real T[TriangleBlock::Width], U[TriangleBlock::Width], V[TriangleBlock::Width];
+        for (auto b = N.Offset; b < N.Offset + N.Count; b += TriangleBlock::Width)
+        {
+            auto Hit = TestBlock(b, N, LocalRay, -TMax, TMax, T, U, V);
+            for (int l = 0; Hit >> l; ++l)
+            {
+                if (Hit >> l & 1)
+                    XS.push_back(Intersection<Object>(T[l], this, U[l], V[l], Order[b + l]));
+            }
+        }
+        return true;
+    });
+
+    // a triangle split between leaves is hit in each of them
+    if (SplitTriangles)
+    {
+        auto ByIndex = [](const Intersection<Object> &A, const Intersection<Object> &B) {
+            return A.GetIndex() < B.GetIndex();
+        };
+        auto SameIndex = [](const Intersection<Object> &A, const Intersection<Object> &B) {
+            return A.GetIndex() == B.GetIndex();
+        };
+        std::sort(XS.begin() + First, XS.end(), ByIndex);
+        XS.erase(std::unique(XS.begin() + First, XS.end(), SameIndex), XS.end());
+    }
+}
+
+bool TriangleMesh::LocalClosestHit(const Ray &LocalRay, Real TMin, Real &TMax, Intersection<Object> &Hit)
+{
+    if (Nodes.empty())
+        return Object::LocalClosestHit(LocalRay, TMin, TMax, Hit);
+
+    return ClosestHitBelow(0, LocalRay, TMin, TMax, Hit);
+}
+
+bool TriangleMesh::ClosestHitBelow(uint32_t Root, const Ray &R, Real TMin, Real &TMax, Intersection<Object> &Hit)
+{
+    bool Found = false;
+    Traverse(Nodes, Root, R, TMin, TMax, [&](const BVHNode &N) {
+        Real T[TriangleBlock::Width], U[TriangleBlock::Width], V[TriangleBlock::Width];
+        for (auto b = N.Offset; b < N.Offset + N.Count; b += TriangleBlock::Width)
+        {
+            // in lane order with a shrinking TMax, as if tested one by one
+            auto Lanes = TestBlock(b, N, R, TMin, TMax, T, U, V);
+            for (int l = 0; Lanes >> l; ++l)
+            {
+                if ((Lanes >> l & 1) && T[l] < TMax)
+                {
+                    Hit = Intersection<Object>(T[l], this, U[l], V[l], Order[b + l]);
+                    TMax = T[l];
+                    Found = true;
+                }
+            }
+        }
+        return true;
+    });
+    return Found;
+}
+
+bool TriangleMesh::LocalAnyHit(const Ray &LocalRay, Real TMin, Real TMax)
+{
+    if (!ShadowOn())
+        return false;
+    if (Nodes.empty())
+        return Object::LocalAnyHit(LocalRay, TMin, TMax);
+
+    bool Found = false;
+    Traverse(Nodes, 0, LocalRay, TMin, TMax, [&](const BVHNode &N) {
+        Real T[TriangleBlock::Width], U[TriangleBlock::Width], V[TriangleBlock::Width];
+        for (auto b = N.Offset; b < N.Offset + N.Count; b += TriangleBlock::Width)
+        {
+            if (TestBlock(b, N, LocalRay, TMin, TMax, T, U, V))
+            {
+                Found = true;
+                return false;
+            }
+        }
+        return true;
+    });
+    return Found;
+}
+
+LaneMask TriangleMesh::LocalClosestHits(const RayPacket &LocalPacket, LaneMask Active, Real TMin, Real *TMax,
+                                        Intersection<Object> *Hits)
+{
+    if (Nodes.empty())
+        return Object::LocalClosestHits(LocalPacket, Active, TMin, TMax, Hits);
+
+    return TracePacket(Nodes, LocalPacket, Active, TMin, TMax,
+        [&](const BVHNode &N, LaneMask Lanes) {
+            LaneMask Found = 0;
+            Real P1[3], E1[3], E2[3];
+            Real T[RayPacket::MaxSize], U[RayPacket::MaxSize], V[RayPacket::MaxSize];
+            for (auto i = N.Offset; i < N.Offset + N.Count; ++i)
+            {
+                GetEdges(i, P1, E1, E2);
+                auto Hit = SIMD::IntersectTriangle(LocalPacket, Lanes, P1, E1, E2, TMin, TMax, T, U, V);
+                for (int l = 0; Hit >> l; ++l)
+                {
+                    if (Hit >> l & 1)
+                    {
+                        Hits[l] = Intersection<Object>(T[l], this, U[l], V[l], Order[i]);
+                        TMax[l] = T[l];
+                    }
+                }
+                Found |= Hit;
+            }
+            return Found;
+        },
+        [&](uint32_t Index, int i) { return ClosestHitBelow(Index, LocalPacket.GetRay(i), TMin, TMax[i], Hits[i]); });
+}
+
+LaneMask TriangleMesh::TestBlock(uint32_t Slot, const BVHNode &Leaf, const Ray &R, Real TMin, Real TMax,
+                                 Real *T, Real *U, Real *V) const
+{
+    int Count = std::min<uint32_t>(TriangleBlock::Width, Leaf.Offset + Leaf.Count - Slot);
+    return SIMD::IntersectTriangles(R, Blocks[Slot / TriangleBlock::Width], Count, TMin, TMax, T, U, V);
+}
+
+void TriangleMesh::Commit()
+{
+    Object::Commit();
+
+    if (Nodes.empty())
+        Divide(BVHCost());
+}
+
+BoundingBoxes TriangleMesh::BoundsOf()
+{
+    if (!IsBoundingBoxCached)
+    {
+        BoundingBoxes Box;
+        for (uint32_t i = 0; i < TriangleCount(); ++i)
+        {
+            for (int c = 0; c < 3; ++c)
+                Box.AddPoint(GetVertex(i, c));
+        }
+        BoxCache = Box;
+        IsBoundingBoxCached = true;
+    }
+    return BoxCache;
+}
+
+void TriangleMesh::Divide(const BVHCost &Cost)
+{
+    Nodes.clear();
+    Order.clear();
+    Blocks.clear();
+    SplitTriangles = false;
+    Dropped = BVH::Fallback::None;
+    if (TriangleCount() == 0)
+        return;
+
+    std::vector<MeshItem> Items(TriangleCount());
+    ParallelFor(Items.size(), Cost.Threads, [&](std::size_t i) {
+        BoundingBoxes Box;
+        for (int c = 0; c < 3; ++c)
+            Box.AddPoint(GetVertex(i, c));
+        Items[i] = {static_cast<uint32_t>(i), Box, Box.Centroid()};
+    });
+
+    // leaves are tested a block of triangles at a time
+    auto BlockCost = Cost;
+    BlockCost.LeafBlock = TriangleBlock::Width;
+
+    // the triangles of the leaves, in the order of their offsets
+    std::vector<uint32_t> Leaves;
+    int Depth;
+    if (Cost.SpatialSplits)
+    {
+        BoundingBoxes Root;
+        for (auto &It : Items)
+            Root.AddBox(It.Box);
+        auto Budget = static_cast<std::size_t>(std::max<Real>(Cost.DuplicateBudget, 0) * Items.size());
+        SpatialBuilder Builder(*this, BlockCost, Root.SurfaceArea());
+        Depth = Builder.Emit(Nodes, Leaves, Items, Budget, Cost.Threads);
+    }
+    else
+    {
+        Depth = EmitNodes(Nodes, Items, 0, Items.size(), BlockCost, Cost.Threads);
+        Leaves.reserve(Items.size());
+        for (auto &It : Items)
+            Leaves.push_back(It.Triangle);
+    }
+    SplitTriangles = Leaves.size() > TriangleCount();
+
+    // the traversal stack holds one entry per level, deeper meshes are
+    // tested triangle by triangle
+    if (Depth > BVH::StackSize)
+    {
+        Nodes.clear();
+        Dropped = BVH::Fallback::TooDeep;
+        return;
+    }
+
+    // every leaf starts a block, the lanes past its last triangle repeat it
+    // and are masked out when testing
+    const uint32_t Width = TriangleBlock::Width;
+    for (auto &N : Nodes)
+    {
+        if (N.Count == 0)
+            continue;
+
+        auto First = N.Offset;
+        N.Offset = Order.size();
+        for (auto i = First; i < First + N.Count; ++i)
+            Order.push_back(Leaves[i]);
+        while (Order.size() % Width)
+            Order.push_back(Order.back());
+    }
+
+    Blocks.resize(Order.size() / Width);
+    for (std::size_t i = 0; i < Order.size(); ++i)
+    {
+        auto &B = Blocks[i / Width];
+        auto Lane = i % Width;
+        auto P1 = GetVertex(Order[i], 0);
+        Vector E1 = GetVertex(Order[i], 1) - P1;
+        Vector E2 = GetVertex(Order[i], 2) - P1;
+        for (int a = 0; a < 3; ++a)
+        {
+            B.P1[a][Lane] = P1[a];
+            B.E1[a][Lane] = E1[a];
+            B.E2[a][Lane] = E2[a];
+        }
+    }
+
+    // the mesh is complete, give back what the buffers grew in excess
+    for (int a = 0; a < 3; ++a)
+    {
+        Vertices[a].shrink_to_fit();
+        Normals[a].shrink_to_fit();
+    }
+    VertexIndices.shrink_to_fit();
+    NormalIndices.shrink_to_fit();
+    Nodes.shrink_to_fit();
+    Order.shrink_to_fit();
+}
+
+void TriangleMesh::Changed()
+{
+    Nodes.clear();
+    Order.clear();
+    Blocks.clear();
+    SplitTriangles = false;
+    IsBoundingBoxCached = false;
+    Uncommit();
+    BoundsChanged();
+}
@@ -10,6 +10,7 @@
 #include "include/Intersection.h"
 #include "include/Util.h"
 #include "include/Functions.h"
+#include "include/SIMD.h"
 
 Triangles::Triangles(Point &&Point1, Point &&Point2, Point &&Point3) : Triangles()
 {
@@ -61,52 +62,54 @@ Vector Triangles::LocalNormalAt(Point &&LocalPoint)
     return LocalNormalAt(LocalPoint);
 }
 
-std::vector<Intersection<Object>> Triangles::LocalIntersect(const Ray &LocalRay)
+void Triangles::LocalIntersect(const Ray &LocalRay, std::vector<Intersection<Object>> &XS)
 {
-    std::vector<Intersection<Object>> Intersections;
-
     auto DirCrossE2 = LocalRay.GetDirection().Cross(E2);
     auto Determinant = E1.Dot(DirCrossE2);
 
     if (std::abs(Determinant) < Util::EPSILON)
-        return Intersections;
+        return;
     
     auto F = 1. / Determinant;
     auto P1ToOrigin = LocalRay.GetOrigin() - P1;
     auto U = F * P1ToOrigin.Dot(DirCrossE2);
 
     if (U < 0. || U > 1.)
-        return Intersections;
+        return;
 
     auto OriginCrossE1 = P1ToOrigin.Cross(E1);
     auto V = F * LocalRay.GetDirection().Dot(OriginCrossE1);
 
     if (V < 0. || (U + V) > 1.)
-        return Intersections;
+        return;
 
     auto T = F * E2.Dot(OriginCrossE1);
-    Intersections.push_back(Intersection<Object>(T, this));
-    return Intersections;
+    XS.push_back(Intersection<Object>(T, this));
 }
 
-BoundingBoxes Triangles::BoundsOf()
+LaneMask Triangles::LocalClosestHits(const RayPacket &LocalPacket, LaneMask Active, Real TMin, Real *TMax,
+                                     Intersection<Object> *Hits)
 {
-    Point Min(Util::Inf, Util::Inf, Util::Inf);
-    Point Max(-Util::Inf, -Util::Inf, -Util::Inf);
-
-    std::vector<Point> Points {P1, P2, P3};
-    for (auto P: Points)
+    Real T[RayPacket::MaxSize], U[RayPacket::MaxSize], V[RayPacket::MaxSize];
+    auto Found = SIMD::IntersectTriangle(LocalPacket, Active, P1.Data(), E1.Data(), E2.Data(), TMin, TMax, T, U, V);
+    for (int i = 0; i < LocalPacket.GetSize(); ++i)
     {
-        if (P.X() < Min.X()) Min.SetX(P.X());
-        if (P.Y() < Min.Y()) Min.SetY(P.Y());
-        if (P.Z() < Min.Z()) Min.SetZ(P.Z());
-
-        if (P.X() > Max.X()) Max.SetX(P.X());
-        if (P.Y() > Max.Y()) Max.SetY(P.Y());
-        if (P.Z() > Max.Z()) Max.SetZ(P.Z());
+        if (Found >> i & 1)
+        {
+            Hits[i] = Intersection<Object>(T[i], this);
+            TMax[i] = T[i];
+        }
     }
+    return Found;
+}
 
-    return BoundingBoxes {Min, Max};
+BoundingBoxes Triangles::BoundsOf()
+{
+    BoundingBoxes Box;
+    Box.AddPoint(P1);
+    Box.AddPoint(P2);
+    Box.AddPoint(P3);
+    return Box;
 }
 
 SmoothTriangles::SmoothTriangles(Point &&P1, Point &&P2, Point &&P3, Vector &&N1, Vector &&N2, Vector &&N3) : SmoothTriangles()
@@ -160,52 +163,54 @@ Vector SmoothTriangles::LocalNormalAt(Point &&LocalPoint, Intersection<Object> &
     return LocalNormalAt(LocalPoint, I);
 }
 
-std::vector<Intersection<Object>> SmoothTriangles::LocalIntersect(const Ray &LocalRay)
+void SmoothTriangles::LocalIntersect(const Ray &LocalRay, std::vector<Intersection<Object>> &XS)
 {
-    std::vector<Intersection<Object>> Intersections;
-
     auto DirCrossE2 = LocalRay.GetDirection().Cross(E2);
     auto Determinant = E1.Dot(DirCrossE2);
 
     if (std::abs(Determinant) < Util::EPSILON)
-        return Intersections;
+        return;
 
     auto F = 1. / Determinant;
     auto P1ToOrigin = LocalRay.GetOrigin() - P1;
     auto U = F * P1ToOrigin.Dot(DirCrossE2);
 
     if (U < 0. || U > 1.)
-        return Intersections;
+        return;
 
     auto OriginCrossE1 = P1ToOrigin.Cross(E1);
     auto V = F * LocalRay.GetDirection().Dot(OriginCrossE1);
 
     if (V < 0. || (U + V) > 1.)
-        return Intersections;
+        return;
 
     auto T = F * E2.Dot(OriginCrossE1);
-    Intersections.push_back(Intersection<Object>(T, this, U, V));
-    return Intersections;
+    XS.push_back(Intersection<Object>(T, this, U, V));
 }
 
-BoundingBoxes SmoothTriangles::BoundsOf()
+LaneMask SmoothTriangles::LocalClosestHits(const RayPacket &LocalPacket, LaneMask Active, Real TMin, Real *TMax,
+                                           Intersection<Object> *Hits)
 {
-    Point Min(Util::Inf, Util::Inf, Util::Inf);
-    Point Max(-Util::Inf, -Util::Inf, -Util::Inf);
-
-    std::vector<Point> Points {P1, P2, P3};
-    for (auto P: Points)
+    Real T[RayPacket::MaxSize], U[RayPacket::MaxSize], V[RayPacket::MaxSize];
+    auto Found = SIMD::IntersectTriangle(LocalPacket, Active, P1.Data(), E1.Data(), E2.Data(), TMin, TMax, T, U, V);
+    for (int i = 0; i < LocalPacket.GetSize(); ++i)
     {
-        if (P.X() < Min.X()) Min.SetX(P.X());
-        if (P.Y() < Min.Y()) Min.SetY(P.Y());
-        if (P.Z() < Min.Z()) Min.SetZ(P.Z());
-
-        if (P.X() > Max.X()) Max.SetX(P.X());
-        if (P.Y() > Max.Y()) Max.SetY(P.Y());
-        if (P.Z() > Max.Z()) Max.SetZ(P.Z());
+        if (Found >> i & 1)
+        {
+            Hits[i] = Intersection<Object>(T[i], this, U[i], V[i]);
+            TMax[i] = T[i];
+        }
     }
+    return Found;
+}
 
-    return BoundingBoxes {Min, Max};
+BoundingBoxes SmoothTriangles::BoundsOf()
+{
+    BoundingBoxes Box;
+    Box.AddPoint(P1);
+    Box.AddPoint(P2);
+    Box.AddPoint(P3);
+    return Box;
 }
 
 // TEST_CASE("Constructing a triangle")
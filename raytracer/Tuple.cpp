@@ -1,24 +1,12 @@
 #include <iostream>
-#include <exception>
-#include <stdexcept>
 #include "include/Tuple.h"
 
-Tuple::Tuple()
+Tuple::Tuple() : E{0., 0., 0., 0.}
 {
 }
 
-Tuple::Tuple(int NumRows, int NumCols) : Matrix(4, 1)
+Tuple::Tuple(Real X, Real Y, Real Z, Real W) : E{X, Y, Z, W}
 {
-    if (NumRows != 4 && NumCols != 1)
-        throw std::invalid_argument("size of a Tuple must be 4x1");
-}
-
-Tuple::Tuple(double X, double Y, double Z, double W) : Matrix(4, 1)
-{
-    this->Set(0, 0, X);
-    this->Set(1, 0, Y);
-    this->Set(2, 0, Z);
-    this->Set(3, 0, W);
 }
 
 std::ostream &operator<<(std::ostream &os, const Tuple &T)
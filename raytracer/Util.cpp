@@ -1,9 +1,16 @@
 #include "include/Util.h"
+#include <algorithm>
 #include <cmath>
 
 
-bool Util::Equal(const double &A, const double &B)
+bool Util::Equal(const Real &A, const Real &B)
 {
     if ( std::abs(A - B) <= EPSILON ) return true;
     return false;
-}
\ No newline at end of file
+}
+
+Real Util::SurfaceOffset(Real X, Real Y, Real Z)
+{
+    auto Magnitude = std::max({std::abs(X), std::abs(Y), std::abs(Z)});
+    return EPSILON + Precision<Real>::Relative * Magnitude;
+}
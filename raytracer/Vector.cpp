@@ -1,68 +1,38 @@
-#include "include/Matrix.h"
 #include "include/Util.h"
 #include <cmath>
 #include <iostream>
-#include <exception>
-#include <stdexcept>
 #include "include/Vector.h"
 
-Vector::Vector() {}
+Vector::Vector() : Tuple(0., 0., 0., 0.) {}
 
-Vector::Vector(int NumRows, int NumCols) : Matrix(4, 1)
+Vector::Vector(Real X, Real Y, Real Z) : Tuple(X, Y, Z, 0.)
 {
-    if (NumRows != 4 && NumCols != 1)
-        throw std::invalid_argument("size of a Vector must be 4x1");
 }
 
-Vector::Vector(double X, double Y, double Z) : Matrix(4, 1)
+Real Vector::Magnitude() const
 {
-    this->Set(0, 0, X);
-    this->Set(1, 0, Y);
-    this->Set(2, 0, Z);
-    this->Set(3, 0, 0.);
+    return std::sqrt(X() * X() + Y() * Y() + Z() * Z());
 }
 
-Vector::Vector(Matrix &M)
+Vector Vector::Normalize() const
 {
-    if (M.GetNumRows() != 4 && M.GetNumCols() != 1)
-        throw std::invalid_argument("size of a Vector must be 4x1");
-    if (!Util::Equal(M.At(3,0), 1.))
-        throw std::invalid_argument("W value must be 1.0");
-
-    this->Set(0, 0, M.At(0, 0));
-    this->Set(1, 0, M.At(1, 0));
-    this->Set(2, 0, M.At(2, 0));
-    this->Set(3, 0, M.At(3, 0));
-}
-
-Vector::Vector(Matrix &&M) : Vector(M)
-{
-}
-
-double Vector::Magnitude()
-{
-    return std::sqrt(pow(X(), 2.) + pow(Y(), 2.) + pow(Z(), 2.));
-}
-
-Vector Vector::Normalize()
-{
-    double Mag = this->Magnitude();
+    Real Mag = this->Magnitude();
     return Vector(X()/ Mag, Y() / Mag, Z() / Mag);
 }
 
-double Vector::Dot(const Vector &V)
+Real Vector::Dot(const Vector &V) const
 {
     return (X() * V.X() + Y() * V.Y() + Z() * V.Z());
 }
 
-Vector Vector::Cross(const Vector &V)
+Vector Vector::Cross(const Vector &V) const
 {
     return Vector(Y() * V.Z() - Z() * V.Y(),
                   Z() * V.X() - X() * V.Z(),
                   X() * V.Y() - Y() * V.X());
 }
 
-Vector Vector::Reflect(const Vector &N)
+Vector Vector::Reflect(const Vector &N) const
 {
     return *this - (N * 2 * this->Dot(N));
 }
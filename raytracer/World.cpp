@@ -6,6 +6,25 @@
 #include "include/Intersection.h"
 #include "include/Functions.h"
 #include <cmath>
+#include <algorithm>
+#include <limits>
+
+namespace
+{
+    // Per-thread intersection lists for refracted hits, reused from ray to ray
+    // so that rendering does not allocate once they have grown. ColorAt recurses
+    // with Remaining - 1 and still needs its list while the recursion runs, so
+    // every level has its own; nested calls only use lower levels, so the outer
+    // vector never grows while a reference into it is held.
+    thread_local std::vector<std::vector<Intersection<Object>>> ScratchBuffers;
+
+    std::vector<Intersection<Object>> &ScratchBuffer(int Level)
+    {
+        if (ScratchBuffers.size() <= static_cast<std::size_t>(Level))
+            ScratchBuffers.resize(Level + 1);
+        return ScratchBuffers[Level];
+    }
+}
 
 World::World(Light &NewLight, std::vector<std::shared_ptr<Object>> &NewObjects)
 {
@@ -24,6 +43,80 @@ World::World()
     Objects = std::vector<std::shared_ptr<Object>>();
 }
 
+World::World(const World &Other) : ALight(Other.ALight), Objects(Other.Objects)
+{
+}
+
+World &World::operator=(const World &Other)
+{
+    ALight = Other.ALight;
+    Objects = Other.Objects;
+    Top = std::make_unique<Root>();
+    return *this;
+}
+
+World::World(World &&Other)
+    : ALight(std::move(Other.ALight)), Objects(std::move(Other.Objects)), Top(std::move(Other.Top))
+{
+    Other.Objects.clear();
+    Other.Top = std::make_unique<Root>();
+}
+
+World &World::operator=(World &&Other)
+{
+    if (this == &Other)
+        return *this;
+    ALight = std::move(Other.ALight);
+    Objects = std::move(Other.Objects);
+    Top = std::move(Other.Top);
+    Other.ALight = nullptr;
+    Other.Objects.clear();
+    Other.Top = std::make_unique<Root>();
+    return *this;
+}
+
+World::Root::Root()
+{
+    // the identity, committed: the world transforms of the objects are what
+    // they were without a parent
+    Transform = Matrix::Identity(4);
+    TransformInverse = Matrix::Identity(4);
+    NormalTransform = Matrix::Identity(4);
+    Parent = nullptr;
+    IsCommitted = true;
+}
+
+World::Root::~Root()
+{
+    for (auto &O : Children)
+    {
+        if (O->GetParent() == this)
+            O->SetParent(nullptr);
+    }
+}
+
+void World::Root::ChildBoundsChanged(Object *Child)
+{
+    // the top-level object Child is in (the groups below refitted their own
+    // hierarchies already)
+    auto Moved = Child;
+    while (Moved->GetParent() && Moved->GetParent() != this)
+        Moved = Moved->GetParent();
+    if (Moved->GetParent() != this || Hierarchy.Empty())
+        return;
+
+    // an unbounded object that stays so is not in the hierarchy; one that
+    // becomes unbounded, or bounded, needs a new Commit
+    bool WasUnbounded = std::find(Unbounded.begin(), Unbounded.end(), Moved) != Unbounded.end();
+    bool IsUnbounded = !Moved->ParentSpaceBoundsOf().IsBounded();
+    if (WasUnbounded && IsUnbounded)
+        return;
+    if (WasUnbounded || IsUnbounded)
+        Hierarchy.Clear();
+    else
+        Hierarchy.Refit(Moved);
+}
+
 World World::DefaultWorld()
 {
     Light L(Color(1., 1., 1.), Point(-10., 10., -10.));
@@ -41,22 +134,125 @@ World World::DefaultWorld()
     return W;
 }
 
-std::vector<Intersection<Object>> World::Intersect(const Ray &R)
+void World::Commit()
 {
-    std::vector<Intersection<Object>> Intersections;
+    // the objects of a world committed before (a copy of this one) move over
+    // to this one; those in a group stay there
+    for (auto &O : Objects)
+    {
+        if (!O->GetParent() || dynamic_cast<Root *>(O->GetParent()))
+            O->SetParent(Top.get());
+    }
+    Top->Children = Objects;
 
-    // now all objects are sphere
+    std::vector<std::shared_ptr<Object>> Bounded;
+    Top->Unbounded.clear();
     for (auto &O : Objects)
     {
-        auto XS = O->Intersect(R);
+        O->Commit();
+        if (O->ParentSpaceBoundsOf().IsBounded())
+            Bounded.push_back(O);
+        else
+            Top->Unbounded.push_back(O.get());
+    }
+
+    Top->Hierarchy.Build(Bounded, BVHCost());
+}
 
-        Intersections.insert(Intersections.end(), XS.begin(), XS.end());
+std::vector<Intersection<Object>> World::Intersect(const Ray &R)
+{
+    std::vector<Intersection<Object>> Intersections;
+    Intersect(R, Intersections);
+    return Intersections;
+}
+
+void World::Intersect(const Ray &R, std::vector<Intersection<Object>> &XS)
+{
+    XS.clear();
+
+    if (Top->Hierarchy.Empty())
+    {
+        for (auto &O : Objects)
+        {
+            O->Intersect(R, XS);
+        }
+    }
+    else
+    {
+        Top->Hierarchy.Intersect(R, XS);
+        for (auto O : Top->Unbounded)
+        {
+            O->Intersect(R, XS);
+        }
     }
 
     // sort the intersections
-    std::sort(Intersections.begin(), Intersections.end());
+    std::sort(XS.begin(), XS.end());
+}
 
-    return Intersections;
+bool World::ClosestHit(const Ray &R, Real TMin, Real TMax, Intersection<Object> &Hit)
+{
+    if (Top->Hierarchy.Empty())
+    {
+        bool Found = false;
+        for (auto &O : Objects)
+        {
+            if (O->ClosestHit(R, TMin, TMax, Hit))
+                Found = true;
+        }
+        return Found;
+    }
+
+    // the planes first, a floor usually cuts the rays short
+    bool Found = false;
+    for (auto O : Top->Unbounded)
+    {
+        if (O->ClosestHit(R, TMin, TMax, Hit))
+            Found = true;
+    }
+    if (Top->Hierarchy.ClosestHit(R, TMin, TMax, Hit))
+        Found = true;
+
+    return Found;
+}
+
+bool World::AnyHit(const Ray &R, Real TMin, Real TMax)
+{
+    if (Top->Hierarchy.Empty())
+    {
+        for (auto &O : Objects)
+        {
+            if (O->AnyHit(R, TMin, TMax))
+                return true;
+        }
+        return false;
+    }
+
+    for (auto O : Top->Unbounded)
+    {
+        if (O->AnyHit(R, TMin, TMax))
+            return true;
+    }
+    return Top->Hierarchy.AnyHit(R, TMin, TMax);
+}
+
+LaneMask World::ClosestHits(const RayPacket &P, LaneMask Active, Real TMin, Real *TMax, Intersection<Object> *Hits)
+{
+    LaneMask Found = 0;
+    if (Top->Hierarchy.Empty())
+    {
+        for (auto &O : Objects)
+        {
+            Found |= O->ClosestHits(P, Active, TMin, TMax, Hits);
+        }
+        return Found;
+    }
+
+    for (auto O : Top->Unbounded)
+    {
+        Found |= O->ClosestHits(P, Active, TMin, TMax, Hits);
+    }
+    return Found | Top->Hierarchy.ClosestHits(P, Active, TMin, TMax, Hits);
 }
 
 Color World::ShadeHit(PreComputations<Object> &Comps, bool RenderShadow, int Remaining)
@@ -88,15 +284,40 @@ Color World::ShadeHit(PreComputations<Object> &Comps, bool RenderShadow, int Rem
 
 Color World::ColorAt(Ray &R, bool RenderShadow=true, int Remaining=5)
 {
-    auto Intersects = Intersect(R);
-    auto H = Hit(Intersects);
-    if (H != nullptr)
+    Intersection<Object> H;
+    if (!ClosestHit(R, 0., std::numeric_limits<Real>::infinity(), H))
+        return Color(0., 0., 0.);
+
+    return ColorOfHit(R, H, RenderShadow, Remaining);
+}
+
+void World::ColorsAt(const RayPacket &P, bool RenderShadow, int Remaining, Color *Out)
+{
+    Real TMax[RayPacket::MaxSize];
+    Intersection<Object> Hits[RayPacket::MaxSize];
+    std::fill(TMax, TMax + RayPacket::MaxSize, std::numeric_limits<Real>::infinity());
+
+    auto Found = ClosestHits(P, P.AllLanes(), 0., TMax, Hits);
+    for (int i = 0; i < P.GetSize(); ++i)
     {
-        auto Comps = TRay::PrepareComputations(*H, R, Intersects);
+        Ray R = P.GetRay(i);
+        Out[i] = (Found >> i & 1) ? ColorOfHit(R, Hits[i], RenderShadow, Remaining) : Color(0., 0., 0.);
+    }
+}
+
+Color World::ColorOfHit(Ray &R, Intersection<Object> &H, bool RenderShadow, int Remaining)
+{
+    // only refraction needs the whole list, to know which objects contain the hit
+    if (H.GetObject()->GetMaterial().GetTransparency() > 0.)
+    {
+        auto &Intersects = ScratchBuffer(std::max(Remaining, 0));
+        Intersect(R, Intersects);
+        auto Comps = TRay::PrepareComputations(H, R, Intersects);
         return ShadeHit(Comps, RenderShadow, Remaining);
     }
 
-    return Color(0., 0., 0.);
+    auto Comps = TRay::PrepareComputations(H, R);
+    return ShadeHit(Comps, RenderShadow, Remaining);
 }
 
 bool World::IsShadowed(Point &P)
@@ -109,24 +330,8 @@ bool World::IsShadowed(Point &P)
     auto Direction = Vec.Normalize();
 
     Ray R(P, Direction);
-    auto Intersections = Intersect(R);
-    std::shared_ptr<Intersection<Object>> AHit {nullptr};
-
-    for (auto &I : Intersections)
-    {
-        if (I.GetT() > 0. && I.GetObject()->ShadowOn())
-        {
-            AHit = std::make_shared<Intersection<Object>>(I);
-            break;
-        }
-    }
-
-    if (AHit && AHit->GetT() < Distance)
-    {
-        return true;
-    }
 
-    return false;
+    return AnyHit(R, 0., Distance);
 }
 
 Color World::ReflectedColor(PreComputations<Object> &Comps, bool RenderShadow=true, int Remaining=5)
@@ -0,0 +1,473 @@
+#pragma once
+
+#include "Ray.h"
+#include "RayPacket.h"
+#include "Util.h"
+#include "Intersection.h"
+#include "BoundingBoxes.h"
+#include "SIMD.h"
+#include "threadpool.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+class Object;
+class Groups;
+
+// node of a flattened hierarchy, 32 bytes so that a parent and its first
+// child (stored right after it) usually share a cache line
+struct alignas(32) BVHNode
+{
+    // bounds rounded outwards to float
+    float Min[3];
+    float Max[3];
+    // leaves: index of the first primitive; inner nodes: index of the second
+    // child, the first one follows the node
+    uint32_t Offset;
+    // number of primitives, 0 for inner nodes
+    uint32_t Count;
+
+    // store Box, rounded so that it only grows
+    void SetBounds(const BoundingBoxes &Box);
+};
+
+static_assert(sizeof(BVHNode) == 32, "BVHNode should fill half a cache line");
+
+// compiled form of a group tree used for traversal: nodes live in one array
+// and are walked with a small explicit stack instead of going through
+// shared_ptr children, virtual calls and BoundingBoxes at every level.
+// Subgroups without a transform are folded into the nodes; shapes and
+// transformed subgroups become the primitives of the leaves.
+class BVH
+{
+    std::vector<BVHNode> Nodes;
+    std::vector<Object *> Primitives;
+    // parent of every node (NoParent for the root) and the leaves holding
+    // each primitive, to refit the nodes above a primitive that moved
+    std::vector<uint32_t> Parents;
+    std::unordered_multimap<const Object *, uint32_t> Leaves;
+    // surface area heuristic cost of the nodes: the area of every node, times
+    // the primitives of the leaves, kept up to date by Refit; and that sum
+    // relative to the root area when the hierarchy was built
+    Real Area = 0;
+    Real BuiltCost = 0;
+    // built from a group tree, subgroups without a transform folded in
+    bool FoldsGroups = false;
+
+public:
+    // why the last Build or Refit left no nodes behind, the shapes being
+    // tested one by one until the next Build: the tree was deeper than
+    // StackSize, or a refit degraded it past MaxRefitGrowth
+    enum class Fallback
+    {
+        None,
+        TooDeep,
+        Degraded
+    };
+
+private:
+    Fallback Dropped = Fallback::None;
+
+public:
+    // deepest hierarchy that can be traversed; deeper trees are not compiled
+    static const int StackSize = 64;
+    // a refit hierarchy whose cost (relative to its root) grew past this
+    // factor of the cost it was built with is not worth keeping
+    static constexpr Real MaxRefitGrowth = 1.5;
+    static constexpr uint32_t NoParent = UINT32_MAX;
+
+    // the subgroup of Shape that can be folded into its parent's hierarchy
+    // (a group with an identity transform), or nullptr
+    static Groups *Inlined(Object *Shape);
+
+    // compile the current children of Root; the result reflects the tree at
+    // the time of the call, so it has to be rebuilt when the tree changes
+    void Build(Groups &Root);
+    // build over Shapes themselves (none of them unbounded) with the binned
+    // surface area heuristic, e.g. the top-level objects of a World; the
+    // shapes are not reparented, the boxes are those in their parent's space
+    void Build(const std::vector<std::shared_ptr<Object>> &Shapes, const BVHCost &Cost);
+    void Clear();
+    // update the bounds of the leaves holding Primitive, whose box changed,
+    // and of the nodes above them. Fails, and clears the hierarchy, when
+    // Primitive is not one of the primitives (the tree changed, it has to be
+    // rebuilt) or when the hierarchy degraded past MaxRefitGrowth
+    bool Refit(const Object *Primitive);
+
+    inline bool Empty() const { return Nodes.empty(); }
+    inline Fallback GetFallback() const { return Dropped; }
+    inline size_t NodeCount() const { return Nodes.size(); }
+    inline size_t PrimitiveCount() const { return Primitives.size(); }
+    inline const std::vector<BVHNode> &GetNodes() const { return Nodes; }
+
+    // same contracts as the Object methods of the same name, R being in the
+    // space of the root group. Nodes are visited front to back, so
+    // ClosestHit and AnyHit skip the subtrees behind the closest hit found
+    void Intersect(const Ray &R, std::vector<Intersection<Object>> &XS) const;
+    bool ClosestHit(const Ray &R, Real TMin, Real &TMax, Intersection<Object> &Hit) const;
+    bool AnyHit(const Ray &R, Real TMin, Real TMax) const;
+
+    // packet form of ClosestHit (see Object::ClosestHits): the lanes are
+    // tested together against the boxes, a subtree entered by a single lane
+    // is finished with the one ray traversal
+    LaneMask ClosestHits(const RayPacket &P, LaneMask Active, Real TMin, Real *TMax, Intersection<Object> *Hits) const;
+
+private:
+    // fill the parents, leaves and costs of the nodes just built, which are
+    // Depth levels deep (or drop them when they are too deep to traverse)
+    void Index(int Depth);
+    bool ClosestHitBelow(uint32_t Root, const Ray &R, Real TMin, Real &TMax, Intersection<Object> &Hit) const;
+    // surface area of node i, times its primitives for a leaf
+    Real WeightedArea(uint32_t i) const;
+    // the cost of the hierarchy relative to the area of its root
+    Real RelativeCost(Real Sum) const;
+};
+
+// traversal of a node array, shared by the BVH of groups and the hierarchies
+// of triangle meshes, which only differ in what their leaves hold
+namespace BVHTraversal
+{
+    // relative slack covering the rounding of the slab test (3 roundings per
+    // bound, twice), so that the test never rejects a box the ray touches
+    const Real Slack = 6 * std::numeric_limits<Real>::epsilon();
+
+    // entry and exit distances of S through the node, widened by Slack; the
+    // node is missed when the first is greater than the second
+    inline std::pair<Real, Real> EnterNode(const BVHNode &N, const RaySlabs &S, Real TMin, Real TMax)
+    {
+        auto T = SlabIntersect(S, N.Min, N.Max, TMin, TMax);
+        T.first -= std::abs(T.first) * Slack;
+        T.second += std::abs(T.second) * Slack;
+        return T;
+    }
+
+    // a subtree waiting on the traversal stack, with the distance at which
+    // the ray enters it
+    struct PendingNode
+    {
+        uint32_t Index;
+        Real Enter;
+    };
+
+    // a subtree waiting on the packet traversal stack, with the lanes that
+    // enter it and the nearest of their entry distances
+    struct PendingLanes
+    {
+        uint32_t Index;
+        LaneMask Lanes;
+        Real Enter;
+    };
+
+    inline int LowestLane(LaneMask Lanes)
+    {
+        int i = 0;
+        while (!(Lanes >> i & 1))
+            ++i;
+        return i;
+    }
+
+    // smallest of Values[i] over the (non empty) Lanes
+    inline Real LowestOf(const Real *Values, LaneMask Lanes)
+    {
+        auto Res = std::numeric_limits<Real>::infinity();
+        for (int i = LowestLane(Lanes); i < RayPacket::MaxSize; ++i)
+        {
+            if ((Lanes >> i & 1) && Values[i] < Res)
+                Res = Values[i];
+        }
+        return Res;
+    }
+
+    inline Real HighestOf(const Real *Values, LaneMask Lanes)
+    {
+        auto Res = -std::numeric_limits<Real>::infinity();
+        for (int i = LowestLane(Lanes); i < RayPacket::MaxSize; ++i)
+        {
+            if ((Lanes >> i & 1) && Values[i] > Res)
+                Res = Values[i];
+        }
+        return Res;
+    }
+
+    // visit the leaves below Root whose box the ray enters within
+    // [TMin, TMax], nearer child first. TMax is re-read after every leaf so closest-hit queries
+    // can shorten it: a subtree on the stack that starts beyond the closest
+    // hit found since it was pushed is dropped without being tested again.
+    // Leaf returns false to end the traversal.
+    template <class LeafFn>
+    void Traverse(const std::vector<BVHNode> &Nodes, uint32_t Root, const Ray &R, Real TMin, const Real &TMax,
+                  LeafFn Leaf)
+    {
+        RaySlabs S(R);
+        auto T = EnterNode(Nodes[Root], S, TMin, TMax);
+        if (T.first > T.second)
+            return;
+
+        PendingNode Stack[BVH::StackSize];
+        int Top = 0;
+        uint32_t Index = Root;
+
+        while (true)
+        {
+            auto &N = Nodes[Index];
+            if (N.Count == 0)
+            {
+                uint32_t Near = Index + 1;
+                uint32_t Far = N.Offset;
+                auto TNear = EnterNode(Nodes[Near], S, TMin, TMax);
+                auto TFar = EnterNode(Nodes[Far], S, TMin, TMax);
+                bool HitNear = TNear.first <= TNear.second;
+                bool HitFar = TFar.first <= TFar.second;
+
+                if (HitNear && HitFar)
+                {
+                    if (TFar.first < TNear.first)
+                    {
+                        std::swap(Near, Far);
+                        std::swap(TNear, TFar);
+                    }
+                    Stack[Top++] = {Far, TFar.first};
+                    Index = Near;
+                    continue;
+                }
+                if (HitNear || HitFar)
+                {
+                    Index = HitNear ? Near : Far;
+                    continue;
+                }
+            }
+            else if (!Leaf(N))
+                return;
+
+            do
+            {
+                if (Top == 0)
+                    return;
+                --Top;
+            } while (Stack[Top].Enter > TMax);
+            Index = Stack[Top].Index;
+        }
+    }
+
+    // closest-hit traversal of the Active lanes of a packet, lane i shrinking
+    // TMax[i]. Leaf(N, Lanes) tests a leaf for Lanes and returns those that
+    // found a hit; once a single lane is left in a subtree, Single(Index, i)
+    // finishes it for that lane with the one ray traversal
+    template <class LeafFn, class SingleFn>
+    LaneMask TracePacket(const std::vector<BVHNode> &Nodes, const RayPacket &P, LaneMask Active, Real TMin,
+                         Real *TMax, LeafFn Leaf, SingleFn Single)
+    {
+        PacketSlabs S(P);
+        Real Enter[RayPacket::MaxSize], EnterFar[RayPacket::MaxSize];
+        LaneMask Found = 0;
+
+        PendingLanes Stack[BVH::StackSize];
+        int Top = 0;
+        uint32_t Index = 0;
+        auto Lanes = SIMD::EnterBox(P, S, Active, Nodes[0].Min, Nodes[0].Max, TMin, TMax, Slack, Enter);
+        if (!Lanes)
+            return Found;
+
+        while (true)
+        {
+            auto &N = Nodes[Index];
+            if (!(Lanes & (Lanes - 1)))
+            {
+                // the rays went separate ways, the one left finishes this
+                // subtree on its own
+                auto i = LowestLane(Lanes);
+                if (Single(Index, i))
+                    Found |= LaneMask(1) << i;
+            }
+            else if (N.Count == 0)
+            {
+                uint32_t Near = Index + 1;
+                uint32_t Far = N.Offset;
+                auto NearLanes = SIMD::EnterBox(P, S, Lanes, Nodes[Near].Min, Nodes[Near].Max, TMin, TMax, Slack, Enter);
+                auto FarLanes = SIMD::EnterBox(P, S, Lanes, Nodes[Far].Min, Nodes[Far].Max, TMin, TMax, Slack, EnterFar);
+
+                if (NearLanes && FarLanes)
+                {
+                    auto TNear = LowestOf(Enter, NearLanes);
+                    auto TFar = LowestOf(EnterFar, FarLanes);
+                    if (TFar < TNear)
+                    {
+                        std::swap(Near, Far);
+                        std::swap(NearLanes, FarLanes);
+                        std::swap(TNear, TFar);
+                    }
+                    Stack[Top++] = {Far, FarLanes, TFar};
+                    Index = Near;
+                    Lanes = NearLanes;
+                    continue;
+                }
+                if (NearLanes || FarLanes)
+                {
+                    Index = NearLanes ? Near : Far;
+                    Lanes = NearLanes | FarLanes;
+                    continue;
+                }
+            }
+            else
+                Found |= Leaf(N, Lanes);
+
+            // drop the subtrees that start beyond the hits of all their lanes
+            do
+            {
+                if (Top == 0)
+                    return Found;
+                --Top;
+            } while (Stack[Top].Enter > HighestOf(TMax, Stack[Top].Lanes));
+            Index = Stack[Top].Index;
+            Lanes = Stack[Top].Lanes;
+        }
+    }
+}
+
+// binned SAH construction shared by Groups::Divide(const BVHCost &) and the
+// hierarchies of triangle meshes; an item has a Box and its Centroid
+namespace BVHBuild
+{
+    // below this many items a subtree is not worth a thread of its own
+    const std::size_t ParallelGrain = 4096;
+
+    struct BuildBin
+    {
+        BoundingBoxes Box;
+        int Count = 0;
+    };
+
+    template <class Item>
+    inline int BinOf(const Item &It, int Axis, Real Min, Real Scale, int Bins)
+    {
+        auto B = static_cast<int>((It.Centroid[Axis] - Min) * Scale);
+        return std::min(std::max(B, 0), Bins - 1);
+    }
+
+    // run Body(i) for i in [0, N) on up to Threads threads of the shared pool
+    template <class Fn>
+    void ParallelFor(std::size_t N, int Threads, Fn Body)
+    {
+        ThreadPool::shared().parallelFor(0, N, ParallelGrain, Body, std::max(Threads, 1));
+    }
+
+    // blocks of Cost.LeafBlock children needed to test Count of them
+    inline Real LeafBlocks(const BVHCost &Cost, std::size_t Count)
+    {
+        auto Block = static_cast<std::size_t>(std::max(Cost.LeafBlock, 1));
+        return static_cast<Real>((Count + Block - 1) / Block);
+    }
+
+    // best centroid bin split: the items of bins [0, Bin] of Axis go left.
+    // Cost is the sum over both halves of blocks times surface area, Axis is
+    // -1 when the centroids do not spread along any axis
+    struct ObjectSplit
+    {
+        Real Cost = Util::Inf;
+        int Axis = -1;
+        int Bin = 0;
+        int Bins = 0;
+        BoundingBoxes CentroidBox;
+
+        template <class Item>
+        inline bool GoesLeft(const Item &It) const
+        {
+            auto Min = CentroidBox.Min[Axis];
+            auto Scale = Bins / (CentroidBox.Max[Axis] - Min);
+            return BinOf(It, Axis, Min, Scale, Bins) <= Bin;
+        }
+    };
+
+    template <class Item>
+    ObjectSplit FindObjectSplit(const std::vector<Item> &Items, std::size_t Begin, std::size_t End,
+                                const BVHCost &Cost)
+    {
+        auto N = End - Begin;
+        ObjectSplit Best;
+        for (auto i = Begin; i < End; ++i)
+        {
+            Best.CentroidBox.AddPoint(Items[i].Centroid);
+        }
+
+        auto Bins = std::max(Cost.Bins, 2);
+        Best.Bins = Bins;
+        std::vector<BuildBin> Bin(Bins);
+        std::vector<Real> RightArea(Bins);
+        for (int Axis = 0; Axis < 3; ++Axis)
+        {
+            auto Min = Best.CentroidBox.Min[Axis];
+            auto Extent = Best.CentroidBox.Max[Axis] - Min;
+            if (!(Extent > 0))
+                continue;
+
+            std::fill(Bin.begin(), Bin.end(), BuildBin());
+            auto Scale = Bins / Extent;
+            for (auto i = Begin; i < End; ++i)
+            {
+                auto &B = Bin[BinOf(Items[i], Axis, Min, Scale, Bins)];
+                B.Box.AddBox(Items[i].Box);
+                ++B.Count;
+            }
+
+            // sweep from the right to get the area of every right half, then
+            // from the left to evaluate the cost of splitting after bin i
+            BoundingBoxes Right;
+            for (int i = Bins - 1; i > 0; --i)
+            {
+                Right.AddBox(Bin[i].Box);
+                RightArea[i] = Right.SurfaceArea();
+            }
+            BoundingBoxes Left;
+            int LeftCount = 0;
+            for (int i = 0; i < Bins - 1; ++i)
+            {
+                Left.AddBox(Bin[i].Box);
+                LeftCount += Bin[i].Count;
+                if (LeftCount == 0 || LeftCount == static_cast<int>(N))
+                    continue;
+                auto SplitCost = LeafBlocks(Cost, LeftCount) * Left.SurfaceArea() +
+                                 LeafBlocks(Cost, N - LeftCount) * RightArea[i + 1];
+                if (SplitCost < Best.Cost)
+                {
+                    Best.Cost = SplitCost;
+                    Best.Axis = Axis;
+                    Best.Bin = i;
+                }
+            }
+        }
+        return Best;
+    }
+
+    // split Items[Begin, End) (bounded by Box) in two and return the index of
+    // the first item of the right half, or End when keeping a leaf is cheaper
+    template <class Item>
+    std::size_t SplitItems(std::vector<Item> &Items, std::size_t Begin, std::size_t End,
+                           const BoundingBoxes &Box, const BVHCost &Cost)
+    {
+        auto N = End - Begin;
+        auto Split = FindObjectSplit(Items, Begin, End, Cost);
+
+        auto Area = Box.SurfaceArea();
+        if (Split.Axis >= 0 && Area > 0)
+        {
+            auto SplitCost = Cost.Traversal + Cost.Intersection * Split.Cost / Area;
+            if (N <= static_cast<std::size_t>(Cost.MaxLeafSize) && Cost.Intersection * LeafBlocks(Cost, N) <= SplitCost)
+                return End;
+
+            auto Mid = std::partition(Items.begin() + Begin, Items.begin() + End,
+                                      [&](const Item &It) { return Split.GoesLeft(It); });
+            return Mid - Items.begin();
+        }
+
+        if (N <= static_cast<std::size_t>(Cost.MaxLeafSize))
+            return End;
+
+        // all centroids coincide (or the boxes are flat), split by count
+        return Begin + N / 2;
+    }
+}
@@ -5,8 +5,74 @@
 #include "Intersection.h"
 #include "Ray.h"
 #include "Intersection.h"
+#include <limits>
+#include <utility>
 #include <vector>
 
+// a ray set up once for slab tests against any number of boxes: the
+// reciprocal of its direction and, per axis, whether it travels towards
+// negative coordinates (and so enters a box through its Max side)
+struct RaySlabs
+{
+    Real Origin[3];
+    Real InvDirection[3];
+    bool Negative[3];
+
+    explicit RaySlabs(const Ray &R)
+    {
+        for (int a = 0; a < 3; ++a)
+        {
+            Origin[a] = R.GetOrigin()[a];
+            InvDirection[a] = 1 / R.GetDirection()[a];
+            Negative[a] = InvDirection[a] < 0;
+        }
+    }
+};
+
+// distances at which S enters and leaves the box [Min, Max] (anything
+// indexable by axis), clipped to [TMin, TMax]; the box is missed when the
+// first is greater than the second. An axis yielding NaN (the origin lies on
+// a bound of an axis the ray is parallel to) leaves the range as it is.
+template <class Bound>
+inline std::pair<Real, Real> SlabIntersect(const RaySlabs &S, const Bound &Min, const Bound &Max, Real TMin, Real TMax)
+{
+    for (int a = 0; a < 3; ++a)
+    {
+        Real Near = S.Negative[a] ? Max[a] : Min[a];
+        Real Far = S.Negative[a] ? Min[a] : Max[a];
+        Real T0 = (Near - S.Origin[a]) * S.InvDirection[a];
+        Real T1 = (Far - S.Origin[a]) * S.InvDirection[a];
+        TMin = T0 > TMin ? T0 : TMin;
+        TMax = T1 < TMax ? T1 : TMax;
+    }
+    return {TMin, TMax};
+}
+
+// cost model of the surface area heuristic used to build hierarchies
+// (Groups::Divide(const BVHCost &)); only the ratio of the two costs matters
+struct BVHCost
+{
+    // cost of testing a ray against the box of one node
+    Real Traversal = 1.;
+    // cost of intersecting a ray with one child of a leaf
+    Real Intersection = 2.;
+    // leaves larger than this are split even when SAH would keep them
+    int MaxLeafSize = 8;
+    // leaves are tested this many children at a time, a leaf costs as much
+    // as its number of (partly filled) blocks
+    int LeafBlock = 1;
+    // let triangle meshes also split at spatial planes, putting a triangle
+    // that straddles the plane in both halves when that is cheaper (SBVH);
+    // slower to build, faster to trace meshes of long thin triangles
+    bool SpatialSplits = false;
+    // references duplicated by spatial splits, at most this many per triangle
+    Real DuplicateBudget = 0.5;
+    // number of centroid bins evaluated per axis
+    int Bins = 16;
+    // workers used to build (subtrees are built in parallel)
+    int Threads = 1;
+};
+
 class BoundingBoxes
 {
 public:
@@ -18,14 +84,26 @@ public:
 
     int GetID();
 
-    void AddPoint(Point P);
-    void AddBox(BoundingBoxes &B);
+    void AddPoint(const Point &P);
+    void AddBox(const BoundingBoxes &B);
+
+    bool ContainsPoint(const Point &P) const;
+    bool ContainsBox(const BoundingBoxes &B) const;
 
-    bool ContainsPoint(Point P);
-    bool ContainsBox(BoundingBoxes &B);
+    Point Centroid() const;
+    Real SurfaceArea() const;
+    // false for empty boxes and for boxes of infinite shapes (planes)
+    bool IsBounded() const;
 
-    BoundingBoxes Transform(Matrix &M);
+    BoundingBoxes Transform(const Matrix &M) const;
     std::pair<BoundingBoxes, BoundingBoxes> SplitBounds();
 
     bool Intersect(const Ray &R);
+    // entry and exit distances of S within [TMin, TMax], see SlabIntersect
+    inline std::pair<Real, Real> Intersect(const RaySlabs &S,
+                                           Real TMin = -std::numeric_limits<Real>::infinity(),
+                                           Real TMax = std::numeric_limits<Real>::infinity()) const
+    {
+        return SlabIntersect(S, Min, Max, TMin, TMax);
+    }
 };
\ No newline at end of file
@@ -31,12 +31,17 @@ public:
     inline auto GetRight() { return Right; }
     inline auto GetOp() { return Operator; }
 
-    virtual std::vector<Intersection<Object>> LocalIntersect(const Ray &LocalRay) override;
+    using Object::LocalIntersect;
+    virtual void LocalIntersect(const Ray &LocalRay, std::vector<Intersection<Object>> &XS) override;
 
     bool IntersectionAllowed(bool LHit, bool InL, bool InR);
     std::vector<Intersection<Object>> FilterIntersections(std::vector<Intersection<Object>> &XS);
+    // filter XS[First..] in place
+    void FilterIntersections(std::vector<Intersection<Object>> &XS, std::size_t First);
 
     virtual bool Include(Object *S) override;
+    virtual void Commit() override;
+    virtual void Uncommit() override;
 
     virtual BoundingBoxes BoundsOf() override;
 
@@ -6,39 +6,108 @@
 #include "Canvas.h"
 #include "World.h"
 #include "Ray.h"
+#include "RenderJob.h"
+#include <chrono>
+#include <functional>
+#include <utility>
+#include <vector>
+
+// order in which the tiles of an image are handed out to the workers: row
+// by row, along a Morton (Z-order) curve, which keeps consecutive tiles
+// close together, or in a spiral from the center of the image outwards
+enum class TileOrder
+{
+    Rows,
+    Morton,
+    Spiral
+};
 
 class Camera
 {
     int HSize;
     int VSize;
     // FOV is in radian
-    double FieldOfView;
+    Real FieldOfView;
     Matrix Transform;
     Matrix TransformInverse;
-    double PixelSize;
-    double HalfWidth;
-    double HalfHeight;
+    Real PixelSize;
+    Real HalfWidth;
+    Real HalfHeight;
+    // primary rays traced together (1: one at a time)
+    int PacketSize = 1;
+    // the image is rendered in square tiles of TileSize pixels a side
+    int TileSize = 16;
+    TileOrder Order = TileOrder::Morton;
+    // told of the progress of Render, at most once per ProgressInterval
+    RenderJob::Callback Progress;
+    std::chrono::milliseconds ProgressInterval{250};
+    // progressive rendering: the first pass traces 1 pixel in Stride x Stride,
+    // each pass halves it (1: a single pass)
+    int ProgressiveStride = 1;
+    std::function<void(Canvas &Image, int Stride)> Preview;
+    std::chrono::milliseconds PreviewInterval{1000};
 
 public:
     Camera();
-    Camera(int H, int V, double FOV);
+    Camera(int H, int V, Real FOV);
 
     void ComputePixelSize();
 
     inline int GetHSize() { return HSize; }
     inline int GetVSize() { return VSize; }
-    inline double GetFOV() { return FieldOfView; }
-    inline Matrix GetTransform() { return Transform; }
-    inline double GetPixelSize() { return PixelSize; }
+    inline Real GetFOV() { return FieldOfView; }
+    inline const Matrix &GetTransform() const { return Transform; }
+    inline Real GetPixelSize() { return PixelSize; }
+    inline int GetPacketSize() const { return PacketSize; }
+    inline int GetTileSize() const { return TileSize; }
+    inline TileOrder GetTileOrder() const { return Order; }
 
-    inline void SetPixelSize(double PS) { PixelSize = PS; }
+    inline void SetPixelSize(Real PS) { PixelSize = PS; }
     // inline void SetTransform(Matrix &M) { Transform = M; }
-    void SetTransform(Matrix &M); 
-    inline void SetTransform(Matrix &&M) { SetTransform(M); }
+    void SetTransform(const Matrix &M);
+    // trace the primary rays of blocks of 2x2, 4x2 or 4x4 pixels together
+    // (Size 4, 8 or 16); 1 traces every pixel on its own
+    void SetPacketSize(int Size);
+    // tiles of Size x Size pixels (at least 1)
+    void SetTileSize(int Size);
+    inline void SetTileOrder(TileOrder O) { Order = O; }
+    // Fn is called from the threads rendering with the pixels done, at most
+    // once per Interval and once at the end; it replaces the progress bar
+    // printed by Render(printLog=true). nullptr: no callback
+    void SetProgressCallback(RenderJob::Callback Fn,
+                             std::chrono::milliseconds Interval = std::chrono::milliseconds(250));
+
+    // render progressively, from 1 pixel in Stride x Stride (a power of 2)
+    // down to every pixel: each pass traces the pixels on a grid twice as
+    // fine as the one before that are not yet done, then fills the others
+    // with the pixel traced at the top left of their cell. Every pixel is
+    // traced once, the final image is the one of a single pass. The passes
+    // trace one ray at a time, whatever the packet size
+    void SetProgressiveStride(int Stride);
+    inline int GetProgressiveStride() const { return ProgressiveStride; }
+    // Fn is called from Render with the image filled after the first pass,
+    // then after the next ones when Interval has passed since the last call
+    // (never after the last pass: Render returns that image)
+    void SetPreviewCallback(std::function<void(Canvas &Image, int Stride)> Fn,
+                            std::chrono::milliseconds Interval = std::chrono::milliseconds(1000));
 
     // RayForPixel returns a ray that starts at the camera passes through the 
     // indicated (X, Y) pixel on the canvas.
     Ray RayForPixel(int X, int Y);
 
+    // up to numThreads threads of the shared pool (the caller being one of
+    // them) take the tiles one after the other, in the tile order, until none
+    // is left; returns once every tile is done
     Canvas Render(World &W, bool RenderShadow=true, bool printLog=false, int RayDepth=5, uint numThreads=1);
+
+    // upper left corners of the tiles of the image, in the tile order
+    std::vector<std::pair<int, int>> Tiles() const;
+
+private:
+    // render the pixels [X0, X1) x [Y0, Y1) of Image
+    void RenderTile(World &W, Canvas &Image, int X0, int Y0, int X1, int Y1, bool RenderShadow, int RayDepth);
+    // render the pixels of [X0, X1) x [Y0, Y1) on the grid of Step pixels
+    // but not on the one of Coarse pixels (0: none is), returns their count
+    int RenderTileOnGrid(World &W, Canvas &Image, int X0, int Y0, int X1, int Y1, int Step, int Coarse,
+                         bool RenderShadow, int RayDepth);
 };
\ No newline at end of file
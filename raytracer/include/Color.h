@@ -1,23 +1,28 @@
 #pragma once
 
 // #include "doctest.h"
+#include <iostream>
 #include <vector>
 #include "Util.h"
 
 class Color
 {
 public:
-    double R, G, B;
+    Real R, G, B;
 
     Color();
-    Color(double R, double G, double B);
+    Color(Real R, Real G, Real B);
     Color(int R, int G, int B);
+#ifdef RAYTRACER_FLOAT
+    // keep double literals unambiguous between the Real and the int overload
+    Color(double R, double G, double B) : Color(Real(R), Real(G), Real(B)) {}
+#endif
 
     Color operator-() const { return Color(-R, -G, -B); }
 
-    Color operator*(double Scalar) const { return Color(R * Scalar, G * Scalar, B * Scalar); }
+    Color operator*(Real Scalar) const { return Color(R * Scalar, G * Scalar, B * Scalar); }
 
-    Color operator/(double Scalar) const { return Color(R / Scalar, G / Scalar, B / Scalar); }
+    Color operator/(Real Scalar) const { return Color(R / Scalar, G / Scalar, B / Scalar); }
 
     // convert a Color object to a PPM int values
     std::vector<int> ToPPMVal(int MaxColorValue);
@@ -38,7 +43,7 @@ inline Color operator*(const Color &A, const Color &B)
     return Color(A.R * B.R, A.G * B.G, A.B * B.B);
 }
 
-inline Color operator*(double S, const Color &B)
+inline Color operator*(Real S, const Color &B)
 {
     return Color(S * B.R, S * B.G, S * B.B);
 }
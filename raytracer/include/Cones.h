@@ -10,28 +10,29 @@
 
 class Cones : public Object
 {
-    double Min;
-    double Max;
+    Real Min;
+    Real Max;
     bool Closed;
 
 public:
     Cones(int ID);
     Cones();
-    Cones(double Minimum, double Maximum, bool IsClosed=false);
+    Cones(Real Minimum, Real Maximum, bool IsClosed=false);
 
     int GetID();
 
     virtual Vector LocalNormalAt(Point &LocalPoint) override;
     virtual Vector LocalNormalAt(Point &&LocalPoint) override;
 
-    virtual std::vector<Intersection<Object>> LocalIntersect(const Ray &LocalRay) override;
+    using Object::LocalIntersect;
+    virtual void LocalIntersect(const Ray &LocalRay, std::vector<Intersection<Object>> &XS) override;
 
-    inline double GetMin() { return Min; }
-    inline double GetMax() { return Max; }
+    inline Real GetMin() { return Min; }
+    inline Real GetMax() { return Max; }
     inline bool IsClosed() { return Closed; }
 
-    inline void SetMin(double M) { Min = M; }
-    inline void SetMax(double M) { Max = M; }
+    inline void SetMin(Real M) { Min = M; }
+    inline void SetMax(Real M) { Max = M; }
     inline void SetClosed(bool IsClosed) { Closed = IsClosed; }
 
     virtual BoundingBoxes BoundsOf() override;
@@ -45,10 +46,9 @@ private:
     // a helper function to reduce duplication.
     // checks to see if the intersection at 't' is within a radius
     // of abs(Y) (the radius of your Cones) from the y axis
-    bool CheckCap(const Ray &R, double T, double AbsY);
+    bool CheckCap(const Ray &R, Real T, Real AbsY);
 
     void IntersectCaps(const Ray &R, std::vector<Intersection<Object>> &Intersections);
 };
 
-std::vector<double> CheckAxis(double Origin, double Direction);
 
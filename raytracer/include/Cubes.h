@@ -6,6 +6,7 @@
 #include "Vector.h"
 #include "Intersection.h"
 #include <vector>
+#include <utility>
 
 class Cubes : public Object
 {
@@ -19,7 +20,8 @@ public:
     virtual Vector LocalNormalAt(Point &LocalPoint) override;
     virtual Vector LocalNormalAt(Point &&LocalPoint) override;
 
-    virtual std::vector<Intersection<Object>> LocalIntersect(const Ray &LocalRay) override;
+    using Object::LocalIntersect;
+    virtual void LocalIntersect(const Ray &LocalRay, std::vector<Intersection<Object>> &XS) override;
 
     virtual BoundingBoxes BoundsOf() override;
 
@@ -29,4 +31,4 @@ public:
     }
 };
 
-std::vector<double> CheckAxis(double Origin, double Direction, double Min, double Max);
\ No newline at end of file
+std::pair<Real, Real> CheckAxis(Real Origin, Real Direction, Real Min, Real Max);
\ No newline at end of file
@@ -4,6 +4,8 @@
 #include "Object.h"
 #include "Pattern.h"
 #include "Point.h"
+#include <utility>
+#include <vector>
 
 namespace TRay
 {
@@ -11,19 +13,21 @@ namespace TRay
     inline Color PatternAtShape(std::shared_ptr<Pattern> &Pat, Object *Obj, Point &&P) { return PatternAtShape(Pat, Obj, P); }
     inline Color PatternAtShape(std::shared_ptr<Pattern> &&Pat, Object *Obj, Point &P) { return PatternAtShape(Pat, Obj, P); }
 
+    // IntersectionList (sorted, containing I) is only read for transparent
+    // materials, whose refractive indices N1/N2 depend on the objects the hit
+    // lies in; everything else gets N1 = N2 = 1
     template<class OT>
     PreComputations<OT> PrepareComputations(Intersection<OT> &I, Ray &R,
-        std::vector<Intersection<OT>> IntersectionList = std::vector<Intersection<OT>>{});
+        const std::vector<Intersection<OT>> &IntersectionList = std::vector<Intersection<OT>>{});
 
+    // refractive indices on both sides of the hit I: {N1, N2}
     template<class OT>
-    std::vector<double> ComputeRefractiveIndex(Intersection<OT> &I,
-        std::vector<Intersection<OT>> IntersectionList);
+    std::pair<Real, Real> ComputeRefractiveIndex(const Intersection<OT> &I,
+        const std::vector<Intersection<OT>> &IntersectionList);
 
     float Schlick(PreComputations<Object> &Comps);
 
-    Point WorldToObject(Object *O, Point &P);
-    inline Point WorldToObject(Object *O, Point &&P) { return WorldToObject(O, P); }
+    Point WorldToObject(Object *O, const Point &P);
 
-    Vector NormalToWorld(Object *O, Vector &N);
-    inline Vector NormalToWorld(Object *O, Vector &&N) { return NormalToWorld(O, N); }
+    Vector NormalToWorld(Object *O, const Vector &N);
 }
\ No newline at end of file
@@ -5,11 +5,23 @@
 #include "Point.h"
 #include "Vector.h"
 #include "Intersection.h"
+#include "BVH.h"
 #include <vector>
 
 class Groups : public Object
 {
     std::vector<std::shared_ptr<Object>> Shapes;
+    // built by Commit() and refit when a child moves, used for traversal
+    // until the children change
+    BVH Compiled;
+
+    void CommitTree();
+    // add S without telling the groups above, for builds that end with
+    // ChildrenChanged()
+    void Attach(std::shared_ptr<Object> &S);
+    // the children were added or removed: drop the hierarchy and the bounds,
+    // here and in the groups this one is folded into
+    void ChildrenChanged();
 
 public:
     Groups(int ID);
@@ -17,18 +29,48 @@ public:
 
     int GetID();
 
-    inline auto GetShapes() { return Shapes; }
-    inline void SetShapes(std::vector<std::shared_ptr<Object>> &S) { Shapes = S; }
+    inline const std::vector<std::shared_ptr<Object>> &GetShapes() const { return Shapes; }
+    inline const BVH &GetBVH() const { return Compiled; }
+    inline void SetShapes(std::vector<std::shared_ptr<Object>> &S)
+    {
+        Shapes = S;
+        ChildrenChanged();
+    }
 
     virtual void AddChild(std::shared_ptr<Object> &S) override;
-    virtual std::vector<Intersection<Object>> LocalIntersect(const Ray &LocalRay) override;
+    using Object::LocalIntersect;
+    virtual void LocalIntersect(const Ray &LocalRay, std::vector<Intersection<Object>> &XS) override;
+    virtual bool LocalClosestHit(const Ray &LocalRay, Real TMin, Real &TMax, Intersection<Object> &Hit) override;
+    virtual bool LocalAnyHit(const Ray &LocalRay, Real TMin, Real TMax) override;
+    virtual LaneMask LocalClosestHits(const RayPacket &LocalPacket, LaneMask Active, Real TMin, Real *TMax,
+                                      Intersection<Object> *Hits) override;
     virtual bool Include(Object *S) override;
+    // compose the transforms of the tree and build its hierarchy, unless the
+    // one built before is still valid (only refit since)
+    virtual void Commit() override;
+    virtual void Uncommit() override;
+    // refit the hierarchy holding Child; a refit that degrades it too much
+    // drops it, to be built again by the next Commit()
+    virtual void ChildBoundsChanged(Object *Child) override;
 
     virtual BoundingBoxes BoundsOf() override;
     virtual std::pair<std::vector<std::shared_ptr<Object>>, std::vector<std::shared_ptr<Object>>> PartitionChildren() override;
     virtual void MakeSubgroup(std::vector<std::shared_ptr<Object>> InShapes) override;
     virtual void Divide(int Threshold) override;
+    // rebuild the children into a bounding volume hierarchy with a binned
+    // surface area heuristic; unlike Divide(int) every bounded child is
+    // partitioned (by centroid), none is left behind at an inner node
+    virtual void Divide(const BVHCost &Cost) override;
     inline virtual int GetCount() override { return Shapes.size(); }
+
+    // child being sorted into the hierarchy by Divide(const BVHCost &)
+    struct BuildItem;
+
+private:
+    // fill this (empty) group with Items[Begin, End)
+    void BuildHierarchy(std::vector<BuildItem> &Items, std::size_t Begin, std::size_t End, const BVHCost &Cost, int Threads);
+
+public:
     inline virtual std::vector<std::shared_ptr<Object>> GetChildren() override
     {
         return Shapes;
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "Object.h"
+#include "Intersection.h"
+#include <memory>
+#include <vector>
+
+// a placement of a shared object (typically a mesh parsed from an obj file)
+// with its own transform, material and shadow flag. The prototype and its
+// hierarchy exist once however many instances use it, so it must not be
+// added to a group: it lives in its own space, the local space of every
+// instance. Hits are reported on the instance, the prototype primitive that
+// was hit is kept in Intersection::GetInner().
+class Instance : public Object
+{
+    std::shared_ptr<Object> Prototype;
+
+public:
+    Instance(int ID);
+    Instance();
+    Instance(const std::shared_ptr<Object> &Proto);
+
+    int GetID();
+
+    inline const std::shared_ptr<Object> &GetPrototype() const { return Prototype; }
+
+    using Object::NormalAt;
+    virtual Vector NormalAt(Point &P, Intersection<Object> &I) override;
+
+    using Object::LocalIntersect;
+    virtual void LocalIntersect(const Ray &LocalRay, std::vector<Intersection<Object>> &XS) override;
+    virtual bool LocalClosestHit(const Ray &LocalRay, Real TMin, Real &TMax, Intersection<Object> &Hit) override;
+    virtual bool LocalAnyHit(const Ray &LocalRay, Real TMin, Real TMax) override;
+    virtual LaneMask LocalClosestHits(const RayPacket &LocalPacket, LaneMask Active, Real TMin, Real *TMax,
+                                      Intersection<Object> *Hits) override;
+
+    // commits the prototype as well, the first instance to be committed does
+    // the work for all of them
+    virtual void Commit() override;
+
+    virtual BoundingBoxes BoundsOf() override;
+
+    inline virtual std::shared_ptr<Object> Clone() override
+    {
+        return std::make_shared<Instance>(*this);
+    }
+};
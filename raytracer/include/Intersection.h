@@ -3,6 +3,8 @@
 // #include "doctest.h"
 #include "Ray.h"
 #include "Util.h"
+#include <algorithm>
+#include <cstdint>
 #include <memory>
 #include <vector>
 
@@ -10,7 +12,7 @@ template <class ObjectType>
 struct PreComputations
 {
     ObjectType *AObject;
-    double T;
+    Real T;
     Point Position;
     Point OverPosition;
     Point UnderPosition;
@@ -18,33 +20,48 @@ struct PreComputations
     Vector NormalV;
     bool IsInside;
     Vector ReflectV;
-    double N1;
-    double N2;
+    Real N1;
+    Real N2;
 };
 
 template <class ObjectType>
 class Intersection
 {
-    double T;
-    double U;
-    double V;
+    Real T;
+    Real U;
+    Real V;
     ObjectType *O;
+    // primitive hit inside an instance, O being the instance
+    ObjectType *Inner = nullptr;
+    // part of O that was hit, for shapes made of many (the triangle of a mesh)
+    uint32_t Index = 0;
 
 public:
     Intersection();
-    Intersection(double T, ObjectType &O);
-    Intersection(double T, ObjectType *O);
-    Intersection(double T, ObjectType *O, double U, double V);
-
-    double GetT() const;
-    double GetU() const;
-    double GetV() const;
+    Intersection(Real T, ObjectType &O);
+    Intersection(Real T, ObjectType *O);
+    Intersection(Real T, ObjectType *O, Real U, Real V);
+    Intersection(Real T, ObjectType *O, Real U, Real V, uint32_t Index);
+
+    Real GetT() const;
+    Real GetU() const;
+    Real GetV() const;
     ObjectType *GetObject() const;
+    ObjectType *GetInner() const { return Inner; }
+    uint32_t GetIndex() const { return Index; }
+
+    // report a hit of a shared (prototype) primitive as a hit of the
+    // instance that placed it; instances do not nest
+    void SetInstance(ObjectType *Instance)
+    {
+        Inner = O;
+        O = Instance;
+    }
 
     bool operator<(const Intersection &RHS) const { return T < RHS.GetT(); }
 
     PreComputations<ObjectType> PrepareComputations(Ray &R,
-        std::vector<Intersection<ObjectType>> IntersectionList = std::vector<Intersection<ObjectType>>{}
+        const std::vector<Intersection<ObjectType>> &IntersectionList = std::vector<Intersection<ObjectType>>{}
     );
 };
 
@@ -66,6 +83,10 @@ std::ostream &operator<<(std::ostream &os, const Intersection<OT> &M);
 template <class OT>
 std::shared_ptr<Intersection<OT>> Hit(std::vector<Intersection<OT>> &Intersections);
 
+// same as Hit(), but points into the (sorted) list instead of allocating a copy
+template <class OT>
+Intersection<OT> *FirstHit(std::vector<Intersection<OT>> &Intersections);
+
 template <class OT>
 void Intersections(std::vector<Intersection<OT>> &I);
 
@@ -79,19 +100,19 @@ template <class OT>
 Intersection<OT>::Intersection() {}
 
 template <class OT>
-double Intersection<OT>::GetT() const
+Real Intersection<OT>::GetT() const
 {
     return T;
 }
 
 template <class OT>
-double Intersection<OT>::GetU() const
+Real Intersection<OT>::GetU() const
 {
     return U;
 }
 
 template <class OT>
-double Intersection<OT>::GetV() const
+Real Intersection<OT>::GetV() const
 {
     return V;
 }
@@ -103,21 +124,21 @@ OT *Intersection<OT>::GetObject() const
 }
 
 template<class OT>
-Intersection<OT>::Intersection(double T, OT &O)
+Intersection<OT>::Intersection(Real T, OT &O)
 {
     this->T = T;
     this->O = &O;
 }
 
 template<class OT>
-Intersection<OT>::Intersection(double T, OT *O)
+Intersection<OT>::Intersection(Real T, OT *O)
 {
     this->T = T;
     this->O = O;
 }
 
 template<class OT>
-Intersection<OT>::Intersection(double T, OT *O, double U, double V)
+Intersection<OT>::Intersection(Real T, OT *O, Real U, Real V)
 {
     this->T = T;
     this->O = O;
@@ -125,6 +146,12 @@ Intersection<OT>::Intersection(double T, OT *O, double U, double V)
     this->V = V;
 }
 
+template<class OT>
+Intersection<OT>::Intersection(Real T, OT *O, Real U, Real V, uint32_t Index) : Intersection(T, O, U, V)
+{
+    this->Index = Index;
+}
+
 template<class OT>
 std::ostream &operator<<(std::ostream &os, const Intersection<OT> &I)
 {
@@ -153,21 +180,27 @@ void Intersections(std::vector<Intersection<OT>> &I)
 
 template<class OT>
 std::shared_ptr<Intersection<OT>> Hit(std::vector<Intersection<OT>> &Intersections)
+{
+    auto H = FirstHit(Intersections);
+    if (H)
+        return std::make_shared<Intersection<OT>>(*H);
+    return nullptr;
+}
+
+template<class OT>
+Intersection<OT> *FirstHit(std::vector<Intersection<OT>> &Intersections)
 {
     for (auto &I : Intersections)
     {
         if (I.GetT() > 0.)
-            return std::make_shared<Intersection<OT>>(I);
+            return &I;
     }
     return nullptr;
 }
 
 template<class OT>
-PreComputations<OT> Intersection<OT>::PrepareComputations(Ray &R, std::vector<Intersection<OT>> IntersectionList)
+PreComputations<OT> Intersection<OT>::PrepareComputations(Ray &R, const std::vector<Intersection<OT>> &IntersectionList)
 {
-    if (IntersectionList.size() == 0)
-        IntersectionList.push_back(*this);
-
     PreComputations<OT> Comps;
     Comps.T = T;
     Comps.AObject = O;
@@ -182,7 +215,7 @@ PreComputations<OT> Intersection<OT>::PrepareComputations(Ray &R, std::vector<In
         Comps.NormalV = -Comps.NormalV;
     }
 
-    Comps.OverPosition = Comps.Position + Comps.NormalV * Util::EPSILON;
+    Comps.OverPosition = Comps.Position + Comps.NormalV * Util::SurfaceOffset(Comps.Position.X(), Comps.Position.Y(), Comps.Position.Z());
 
     Comps.ReflectV = R.GetDirection().Reflect(Comps.NormalV);
 
@@ -8,39 +8,39 @@
 class Material
 {
     Color AColor;
-    double Ambient;
-    double Diffuse;
-    double Specular;
-    double Shininess;
+    Real Ambient;
+    Real Diffuse;
+    Real Specular;
+    Real Shininess;
     std::shared_ptr<Pattern> APattern;
-    double Reflective;
-    double Transparency;
-    double RefractiveIndex;
+    Real Reflective;
+    Real Transparency;
+    Real RefractiveIndex;
 
 public:
     Material();
-    Material(Color &C, double Amb, double Dif, double Spec, double Shini);
-    Material(Color &&C, double Amb, double Dif, double Spec, double Shini);
-
-    inline double GetAmbient() const { return Ambient; }
-    inline double GetDiffuse() const { return Diffuse; }
-    inline double GetSpecular() const { return Specular; }
-    inline double GetShininess() const { return Shininess; }
-    inline double GetReflective() const { return Reflective; }
+    Material(Color &C, Real Amb, Real Dif, Real Spec, Real Shini);
+    Material(Color &&C, Real Amb, Real Dif, Real Spec, Real Shini);
+
+    inline Real GetAmbient() const { return Ambient; }
+    inline Real GetDiffuse() const { return Diffuse; }
+    inline Real GetSpecular() const { return Specular; }
+    inline Real GetShininess() const { return Shininess; }
+    inline Real GetReflective() const { return Reflective; }
     inline Color GetColor() const { return AColor; }
     inline std::shared_ptr<Pattern> GetPattern() const { return APattern; }
-    inline double GetTransparency() const { return Transparency; }
-    inline double GetRefractiveIndex() const { return RefractiveIndex; }
-
-    inline void SetAmbient(double Amb) { Ambient = Amb; }
-    inline void SetDiffuse(double Diff) { Diffuse = Diff; }
-    inline void SetSpecular(double Spec) { Specular = Spec; }
-    inline void SetShininess(double Shini) { Shininess = Shini; }
-    inline void SetReflective(double Reflect) { Reflective = Reflect; }
+    inline Real GetTransparency() const { return Transparency; }
+    inline Real GetRefractiveIndex() const { return RefractiveIndex; }
+
+    inline void SetAmbient(Real Amb) { Ambient = Amb; }
+    inline void SetDiffuse(Real Diff) { Diffuse = Diff; }
+    inline void SetSpecular(Real Spec) { Specular = Spec; }
+    inline void SetShininess(Real Shini) { Shininess = Shini; }
+    inline void SetReflective(Real Reflect) { Reflective = Reflect; }
     inline void SetColor(Color &C) { AColor = C; }
     inline void SetColor(Color &&C) { AColor = C; }
-    inline void SetTransparency(double Trans) { Transparency = Trans; }
-    inline void SetRefractiveIndex(double RIndex) { RefractiveIndex = RIndex; }
+    inline void SetTransparency(Real Trans) { Transparency = Trans; }
+    inline void SetRefractiveIndex(Real RIndex) { RefractiveIndex = RIndex; }
 
 
     inline void SetPattern(std::shared_ptr<Pattern> &P) { APattern = P; }
@@ -2,28 +2,39 @@
 
 // #include "doctest.h"
 #include <iostream>
-#include <vector>
+#include "Tuple.h"
+#include "Point.h"
+#include "Vector.h"
 
+// Matrix is a fixed-capacity value type: every matrix used by the renderer is
+// at most 4x4 (submatrices used by Determinant() are 3x3 and 2x2), so the
+// elements live in an inline array and copying a Matrix never allocates.
 class Matrix
 {
+public:
+    static const int MAX_SIZE = 4;
+
 private:
     int numRows, numCols;
-    std::vector<std::vector<double>> m;
+    alignas(4 * sizeof(Real)) Real m[MAX_SIZE][MAX_SIZE];
 
 public:
     Matrix();
-    Matrix(int NumRows, int NumCols, double Val);
+    Matrix(int NumRows, int NumCols, Real Val);
     Matrix(int NumRows, int NumCols);
 
     // create a 4x1 Tuple
-    Matrix(double X, double Y, double Z, double W);
+    Matrix(Real X, Real Y, Real Z, Real W);
 
-    double &operator()(const int R, const int C) { return m[R][C]; }
+    Real &operator()(const int R, const int C) { return m[R][C]; }
 
-    inline double At(const int R, const int C) const { return m[R][C]; }
-    inline void Set(const int R, const int C, double Val) { m[R][C] = Val; }
+    inline Real At(const int R, const int C) const { return m[R][C]; }
 
-    Matrix operator*(double S) const
+    // row-major view of the elements (used by the SIMD kernels)
+    inline const Real *Data() const { return &m[0][0]; }
+    inline void Set(const int R, const int C, Real Val) { m[R][C] = Val; }
+
+    Matrix operator*(Real S) const
     {
         Matrix Res = Matrix(numRows, numCols);
         for (int r = 0; r < numRows; ++r)
@@ -38,30 +49,35 @@ public:
 
     Matrix operator-() const { return (*this) * (-1.); }
 
-    Matrix operator/(double S) const { return (*this) * (1.f / S); }
+    Matrix operator/(Real S) const { return (*this) * (1.f / S); }
 
     inline bool IsValid(int Row, int Col) const
     {
         return Row >= 0 && Row < numRows && Col >= 0 && Col < numCols;
     }
 
-    template<class Derived>
-    Derived Mul(const Derived &RHS);
+    Matrix Mul(const Matrix &RHS) const;
+
+    // The transforms in this renderer are all affine (the bottom row is
+    // always 0 0 0 1), so points keep W = 1 and vectors ignore translation.
+    Point Mul(const Point &P) const;
+    Vector Mul(const Vector &V) const;
+    Tuple Mul(const Tuple &T) const;
 
     // transpose
-    Matrix T();
+    Matrix T() const;
 
-    double Determinant();
+    Real Determinant() const;
 
-    Matrix Submatrix(int RowRemoved, int ColRemoved);
+    Matrix Submatrix(int RowRemoved, int ColRemoved) const;
 
-    double Minor(int Row, int Col);
+    Real Minor(int Row, int Col) const;
 
-    double Cofactor(int Row, int Col);
+    Real Cofactor(int Row, int Col) const;
 
-    bool IsInvertible();
+    bool IsInvertible() const;
 
-    Matrix Inverse();
+    Matrix Inverse() const;
 
     int GetNumRows() const;
     int GetNumCols() const;
@@ -69,21 +85,21 @@ public:
     static Matrix Identity(int Size);
     static Matrix Identity();
 
-    static Matrix Translation(double X, double Y, double Z);
-    static Matrix Scaling(double X, double Y, double Z);
-    static Matrix RotationX(double Rad);
-    static Matrix RotationY(double Rad);
-    static Matrix RotationZ(double Rad);
+    static Matrix Translation(Real X, Real Y, Real Z);
+    static Matrix Scaling(Real X, Real Y, Real Z);
+    static Matrix RotationX(Real Rad);
+    static Matrix RotationY(Real Rad);
+    static Matrix RotationZ(Real Rad);
     
     // param XY means: how much we move X in proportion to Y
-    static Matrix Shearing(double XY, double XZ, double YX, double YZ, double ZX, double ZY);
+    static Matrix Shearing(Real XY, Real XZ, Real YX, Real YZ, Real ZX, Real ZY);
 
-    Matrix Translate(double X, double Y, double Z);
-    Matrix Scale(double X, double Y, double Z);
-    Matrix RotateX(double Rad);
-    Matrix RotateY(double Rad);
-    Matrix RotateZ(double Rad);
-    Matrix Shear(double XY, double XZ, double YX, double YZ, double ZX, double ZY);
+    Matrix Translate(Real X, Real Y, Real Z) const;
+    Matrix Scale(Real X, Real Y, Real Z) const;
+    Matrix RotateX(Real Rad) const;
+    Matrix RotateY(Real Rad) const;
+    Matrix RotateZ(Real Rad) const;
+    Matrix Shear(Real XY, Real XZ, Real YX, Real YZ, Real ZX, Real ZY) const;
 
 };
 
@@ -103,27 +119,3 @@ Matrix operator*(const Matrix &LHS, const Matrix &RHS);
 Matrix operator/(const Matrix &LHS, const Matrix &RHS);
 
 std::ostream &operator<<(std::ostream &os, const Matrix &M);
-
-template<class Derived>
-Derived Matrix::Mul(const Derived &RHS)
-{
-    static_assert(std::is_base_of<Matrix, Derived>::value, "Derived not derived from Matrix");
-
-    if (this->GetNumCols() != RHS.GetNumRows())
-        throw std::invalid_argument("LHS matrix's rows must match RHS matrix's columns.");
-
-    int Dim = this->GetNumCols();
-
-    Derived Res(this->GetNumRows(), RHS.GetNumCols());
-    for (int r = 0; r < Res.GetNumRows(); ++r)
-    {
-        for (int c = 0; c < Res.GetNumCols(); ++c)
-        {
-            for (int i = 0; i < Dim; ++i)
-            {
-                Res(r, c) += this->At(r, i) * RHS.At(i, c);
-            }
-        }
-    }
-    return Res;
-}
\ No newline at end of file
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "BoundingBoxes.h"
+#include "TriangleMesh.h"
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+
+// directory of divided triangle meshes, written once built so that later
+// runs map the file instead of parsing the obj and building the hierarchy
+// again. A file is named after a hash of everything its contents depend on
+// (the obj file, the build parameters, the format version, the Real type):
+// an edited model or another cost model simply gets a file of its own.
+// Files of another version or whose sizes do not add up are ignored.
+class MeshCache
+{
+    std::filesystem::path Directory;
+
+    // call F on every buffer of Mesh (a std::vector), in file order
+    template <class Mesh, class Fn>
+    static void ForEachBuffer(Mesh &M, Fn F);
+
+public:
+    // bumped whenever the file layout or the layout of a buffer changes
+    static constexpr uint32_t Version = 1;
+
+    MeshCache(const std::filesystem::path &Dir);
+
+    // key of the mesh built from the obj file at Path, parsed with Smoothing
+    // and divided with Cost; throws std::invalid_argument when the file
+    // cannot be read
+    static std::string Key(const std::filesystem::path &Path, bool Smoothing, const BVHCost &Cost);
+
+    std::filesystem::path PathOf(const std::string &Key) const;
+
+    // the mesh stored under Key, with its hierarchy, or nullptr when there is
+    // no usable file
+    std::shared_ptr<TriangleMesh> Load(const std::string &Key) const;
+    // write Mesh (divided) under Key, replacing the file atomically; false
+    // when it could not be written
+    bool Store(const std::string &Key, const TriangleMesh &Mesh) const;
+};
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <unordered_map>
 #include <vector>
 // #include "doctest.h"
@@ -8,27 +9,50 @@
 #include "Point.h"
 #include "Groups.h"
 #include "Triangles.h"
+#include "TriangleMesh.h"
 
 class ObjParser
 {
+public:
+    // triangle of a face by (0-based) vertex and normal indices; Triangles,
+    // SmoothTriangles or a TriangleMesh are made from them once parsed
+    struct FaceTriangle
+    {
+        uint32_t V[3];
+        uint32_t N[3];
+    };
+
+private:
     std::vector<Point> Vertices;
     std::vector<Vector> Normals;
     int IgnoredLines;
     std::string Filename;
-    std::unordered_map<std::string, std::vector<Triangles>> TriGroups;
-    std::unordered_map<std::string, std::vector<SmoothTriangles>> STriGroups;
+    std::unordered_map<std::string, std::vector<FaceTriangle>> TriGroups;
+    std::unordered_map<std::string, std::vector<FaceTriangle>> STriGroups;
     std::string LatestGroup;
     bool Smoothing;
 
-    std::vector<Triangles> FanTriangulation(std::vector<int>VertexIndices);
+    std::vector<FaceTriangle> FanTriangulation(std::vector<int>VertexIndices);
 
-    std::vector<SmoothTriangles> FanTriangulation(std::vector<int>VertexIndices,
+    std::vector<FaceTriangle> FanTriangulation(std::vector<int>VertexIndices,
                                             std::vector<int>TextureIndices,
                                             std::vector<int>NormalIndices);
 
     void ParseFace(std::vector<int> &VIndices, std::vector<int> &TIndices, std::vector<int> &NIndices,
                     std::string Str);
 
+    // the lines of a part of the file, parsed on their own and then added in
+    // file order (see Parse)
+    struct ParsedChunk;
+    void ParseChunk(const char *Begin, const char *End, ParsedChunk &Chunk);
+    void AddChunk(const ParsedChunk &Chunk);
+
+    // 0-based index of the 1-based ID of a face, checked
+    uint32_t VertexIndex(int ID);
+    uint32_t NormalIndex(int ID);
+    Triangles MakeTriangle(const FaceTriangle &F);
+    SmoothTriangles MakeSmoothTriangle(const FaceTriangle &F);
+
 public:
     ObjParser(std::string F, bool Smoothing=true);
 
@@ -42,6 +66,10 @@ public:
     inline void SetSmoothing(bool B) { Smoothing = B; }
 
     std::unordered_map<std::string, std::shared_ptr<Groups>> ObjToGroup();
+    // one mesh per group, holding the vertices and normals the group uses;
+    // much lighter than ObjToGroup for large models
+    std::unordered_map<std::string, std::shared_ptr<TriangleMesh>> ObjToMesh();
 
+    // large files are cut in parts parsed in parallel on the shared pool
     void Parse();
 };
\ No newline at end of file
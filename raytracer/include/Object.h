@@ -7,6 +7,7 @@
 #include "Util.h"
 #include "Material.h"
 #include "Ray.h"
+#include "RayPacket.h"
 #include "Intersection.h"
 #include "BoundingBoxes.h"
 #include <limits>
@@ -18,6 +19,16 @@ protected:
     int ID;
     Matrix Transform;
     Matrix TransformInverse;
+    // inverse-transpose of Transform, used to bring normals back to world space
+    Matrix NormalTransform = Matrix::Identity();
+    // world-to-object and normal-to-world matrices composed over the whole Parent
+    // chain by Commit(), so shading does not walk the group tree on every hit
+    Matrix WorldInverse = Matrix::Identity();
+    Matrix WorldNormalTransform = Matrix::Identity();
+    // false while Transform is exactly the identity: rays (and packets, once
+    // per primitive of a mesh) are then used as they are instead of copied
+    bool HasTransform = false;
+    bool IsCommitted = false;
     Point Origin;
     Material AMaterial;
     bool UseShadow;
@@ -30,19 +41,41 @@ public:
 
     int GetID();
 
-    Matrix GetTransform() const { return Transform; }
-    Matrix GetTransformInverse() const { return TransformInverse; }
+    const Matrix &GetTransform() const { return Transform; }
+    const Matrix &GetTransformInverse() const { return TransformInverse; }
+    const Matrix &GetNormalTransform() const { return NormalTransform; }
+    const Matrix &GetWorldInverse() const { return WorldInverse; }
+    const Matrix &GetWorldNormalTransform() const { return WorldNormalTransform; }
+    bool Committed() const { return IsCommitted; }
+    // false while the transform is exactly the identity
+    bool Transformed() const { return HasTransform; }
     Material GetMaterial() const { return AMaterial; }
     bool ShadowOn() const { return UseShadow; }
     Object *GetParent() { return Parent; }
 
-    void SetTransform(Matrix &M);
-    inline void SetTransform(Matrix &&M) { SetTransform(M); }
+    void SetTransform(const Matrix &M);
 
     inline virtual void SetMaterial(Material &M) { AMaterial = M; }
     inline virtual void SetMaterial(Material &&M) { SetMaterial(M); }
 
-    inline void SetParent(Object *P) { Parent = P; }
+    inline void SetParent(Object *P)
+    {
+        Parent = P;
+        Uncommit();
+    }
+
+    // compose the world transforms of this object (and its children) along the
+    // Parent chain; call once the scene is fully built
+    virtual void Commit();
+    // drop the composed transforms, e.g. after the transform or parent changed
+    inline virtual void Uncommit() { IsCommitted = false; }
+
+    // the box of this object in its parent's space changed (new transform,
+    // new shape): tell the parent, so the groups above refit their bounds
+    void BoundsChanged();
+    // called on the parent of Child by Child->BoundsChanged(); shapes whose
+    // bounds depend on their children pass it on
+    inline virtual void ChildBoundsChanged(Object *Child) { BoundsChanged(); }
 
     inline void SetShadowOn(bool Shadow) { UseShadow = Shadow; }
 
@@ -55,12 +88,31 @@ public:
     inline virtual Vector LocalNormalAt(Point &P, Intersection<Object> &I) { return LocalNormalAt(P); }
     inline virtual Vector LocalNormalAt(Point &&P, Intersection<Object> &I) { return LocalNormalAt(P); }
 
-    virtual std::vector<Intersection<Object>> Intersect(const Ray &R);
+    // append the intersections of R with this object to XS, unsorted. XS is
+    // owned by the caller and meant to be reused across rays, so rendering
+    // does not allocate once its buffers have grown to size.
+    void Intersect(const Ray &R, std::vector<Intersection<Object>> &XS);
+    inline virtual void LocalIntersect(const Ray &LocalRay, std::vector<Intersection<Object>> &XS) {}
 
-    inline virtual std::vector<Intersection<Object>> LocalIntersect(const Ray &R)
-    {
-        return std::vector<Intersection<Object>>();
-    }
+    // same as above, returning a fresh list sorted by T
+    std::vector<Intersection<Object>> Intersect(const Ray &R);
+    std::vector<Intersection<Object>> LocalIntersect(const Ray &LocalRay);
+
+    // nearest intersection with TMin < T < TMax; on a hit, Hit is set and TMax
+    // shrinks to its T, so later objects can be tested against a shorter ray
+    bool ClosestHit(const Ray &R, Real TMin, Real &TMax, Intersection<Object> &Hit);
+    virtual bool LocalClosestHit(const Ray &LocalRay, Real TMin, Real &TMax, Intersection<Object> &Hit);
+
+    // whether the ray hits anything that casts shadows with TMin < T < TMax
+    bool AnyHit(const Ray &R, Real TMin, Real TMax);
+    virtual bool LocalAnyHit(const Ray &LocalRay, Real TMin, Real TMax);
+
+    // ClosestHit for the lanes of Active of a packet, lane i with its own
+    // TMax[i] and Hits[i]; returns the lanes that found a hit. The lanes are
+    // traced one at a time unless the shape tests them together
+    LaneMask ClosestHits(const RayPacket &P, LaneMask Active, Real TMin, Real *TMax, Intersection<Object> *Hits);
+    virtual LaneMask LocalClosestHits(const RayPacket &LocalPacket, LaneMask Active, Real TMin, Real *TMax,
+                                      Intersection<Object> *Hits);
 
     inline virtual void AddChild(std::shared_ptr<Object> &S) {};
     inline virtual bool Include(Object *S) { return (this == S); }
@@ -78,6 +130,7 @@ public:
 
     inline virtual void MakeSubgroup(std::vector<std::shared_ptr<Object>> InShapes) {}
     inline virtual void Divide(int Threshold) {}
+    inline virtual void Divide(const BVHCost &Cost) {}
     inline virtual int GetCount() { return 1; }
     inline virtual std::vector<std::shared_ptr<Object>> GetChildren()
     {
@@ -97,7 +150,8 @@ public:
 
     std::unique_ptr<Ray> SavedRay;
 
-    virtual std::vector<Intersection<Object>> LocalIntersect(const Ray &R) override;
+    using Object::LocalIntersect;
+    virtual void LocalIntersect(const Ray &R, std::vector<Intersection<Object>> &XS) override;
     virtual Vector LocalNormalAt(Point &LocalPoint) override;
     virtual BoundingBoxes BoundsOf() override;
 };
\ No newline at end of file
@@ -15,16 +15,12 @@ class Ray
 
 public:
     Ray();
-    Ray(Point &&O, Vector &&D);
-    Ray(Point &O, Vector &&D);
-    Ray(Point &O, Vector &D);
-    Ray(Point &&O, Vector &D);
+    Ray(const Point &O, const Vector &D);
 
-    Point GetOrigin() const;
-    Vector GetDirection() const;
+    inline const Point &GetOrigin() const { return Origin; }
+    inline const Vector &GetDirection() const { return Direction; }
 
-    Point Position(double T);
+    Point Position(Real T) const;
 
-    Ray Transform(Matrix &M) const;
-    Ray Transform(Matrix &&M) const;
+    Ray Transform(const Matrix &M) const;
 };
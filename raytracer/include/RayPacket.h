@@ -0,0 +1,49 @@
+#pragma once
+
+#include "Matrix.h"
+#include "Ray.h"
+#include "Util.h"
+#include <cstdint>
+
+// lanes of a packet taking part in a query, bit i for lane i
+using LaneMask = uint32_t;
+
+// up to MaxSize rays traced together, typically the camera rays of a small
+// block of pixels, which mostly enter the same boxes and hit the same
+// primitives. Besides the rays, origins and directions are stored one axis
+// per array (lane i at index i) for the packet kernels of SIMD.h; lanes past
+// the size repeat the first ray so the kernels can work on whole registers.
+class RayPacket
+{
+public:
+    static const int MaxSize = 16;
+
+    alignas(32) Real Origin[3][MaxSize];
+    alignas(32) Real Direction[3][MaxSize];
+
+    // N (1 to MaxSize) rays taken from R
+    RayPacket(const Ray *R, int N);
+
+    inline int GetSize() const { return Size; }
+    inline const Ray &GetRay(int i) const { return Rays[i]; }
+    inline LaneMask AllLanes() const { return (LaneMask(1) << Size) - 1; }
+
+    // the packet in the space of M (same results as Ray::Transform)
+    RayPacket Transform(const Matrix &M) const;
+
+private:
+    int Size;
+    Ray Rays[MaxSize];
+
+    RayPacket() = default;
+    void Scatter();
+};
+
+// reciprocal directions of the lanes of a packet, for slab tests against any
+// number of boxes (see RaySlabs)
+struct PacketSlabs
+{
+    alignas(32) Real InvDirection[3][RayPacket::MaxSize];
+
+    explicit PacketSlabs(const RayPacket &P);
+};
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+// bookkeeping of a render cut in tiles: the thread that finishes a tile
+// reports it here, which counts the tile and the pixels done and, now and
+// then, calls the progress callback; Wait() returns once every tile is done.
+// Nothing runs between the reports, a render without a callback pays only
+// for a few atomic additions per tile
+class RenderJob
+{
+public:
+    // called with the pixels done so far and the pixels of the image
+    using Callback = std::function<void(int Done, int Total)>;
+
+private:
+    int TileCount;
+    int TotalPixels;
+    // times each tile was finished (1 once the render is done)
+    std::unique_ptr<std::atomic<int>[]> Completions;
+    std::atomic<int> TilesLeft;
+    std::atomic<int> PixelsDone{0};
+
+    // set once the last tile is done and reported
+    std::atomic<bool> Complete{false};
+    std::mutex WaitMutex;
+    std::condition_variable Finished;
+
+    Callback Progress;
+    std::chrono::steady_clock::duration Interval;
+    // taken by the thread reporting, the others skip the report
+    std::mutex ReportMutex;
+    std::chrono::steady_clock::time_point NextReport;
+
+    void Report();
+
+public:
+    // Fn (if any) is called at most once per Interval while the render goes
+    // on, and once at the end with Done == Total; the calls never overlap
+    RenderJob(int Tiles, int Pixels, Callback Fn = nullptr,
+              std::chrono::milliseconds Interval = std::chrono::milliseconds(250));
+
+    RenderJob(const RenderJob &) = delete;
+    RenderJob &operator=(const RenderJob &) = delete;
+
+    // the tile of index Tile, of Pixels pixels, is done
+    void Finish(int Tile, int Pixels);
+    // returns once every tile is done
+    void Wait();
+
+    bool Done() const { return Complete.load(std::memory_order_acquire); }
+    int GetPixelsDone() const { return PixelsDone.load(std::memory_order_relaxed); }
+    int GetCompletions(int Tile) const { return Completions[Tile].load(std::memory_order_relaxed); }
+};
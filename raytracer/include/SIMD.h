@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstddef>
+#include "Matrix.h"
+#include "Point.h"
+#include "Vector.h"
+#include "Ray.h"
+#include "RayPacket.h"
+
+// triangles tested together by SIMD::IntersectTriangles, one per lane: the
+// first corner and the two edges of each, one array per axis
+struct TriangleBlock
+{
+    static constexpr int Width = 4;
+
+    alignas(Width * sizeof(Real)) Real P1[3][Width];
+    alignas(Width * sizeof(Real)) Real E1[3][Width];
+    alignas(Width * sizeof(Real)) Real E2[3][Width];
+};
+
+// SIMD holds the vectorized kernels for the innermost transform math: 4x4 times
+// point, 4x4 times vector and whole-ray transforms. The instruction set is picked
+// once at runtime via CPUID (AVX2, then SSE2, then plain scalar code), so one
+// binary runs everywhere. All levels produce bit-identical results: the kernels
+// accumulate in the same order as the scalar code and do not use FMA. In the
+// single precision build a whole tuple fits one SSE register, and the AVX2
+// ray kernel transforms origin and direction together in its two halves.
+// The packet kernels run one lane per element of an AVX2 register (4 lanes
+// in double, 8 in float) and fall back to a loop over the lanes below AVX2.
+// The triangle block kernel has one lane per triangle: four, which fill a
+// register in double and, in float, the double precision half of the test.
+namespace SIMD
+{
+    enum class Level
+    {
+        Scalar,
+        SSE2,
+        AVX2
+    };
+
+    // the best level supported by this CPU
+    Level Detect();
+
+    // the level currently used by the kernels below
+    Level GetLevel();
+
+    // force a level (e.g. for tests or benchmarks); it is clamped to Detect()
+    void SetLevel(Level L);
+
+    const char *LevelName(Level L);
+
+    Point TransformPoint(const Matrix &M, const Point &P);
+    Vector TransformVector(const Matrix &M, const Vector &V);
+    Ray TransformRay(const Matrix &M, const Ray &R);
+
+    // transform N rays against the same matrix; In and Out may alias
+    void TransformRays(const Matrix &M, const Ray *In, Ray *Out, std::size_t N);
+
+    // packet kernels: only the lanes of Active are tested, the outputs of the
+    // others are left undefined
+
+    // slab test of the lanes of P against the box [Min, Max] (the bounds of a
+    // hierarchy node): Enter[i] gets the distance at which lane i enters the
+    // box, clipped to [TMin, TMax[i]]. Both ends are widened by Slack times
+    // their magnitude; returns the lanes entering the box (see SlabIntersect)
+    LaneMask EnterBox(const RayPacket &P, const PacketSlabs &S, LaneMask Active, const float *Min, const float *Max,
+                      Real TMin, const Real *TMax, Real Slack, Real *Enter);
+
+    // Moller-Trumbore test of the lanes of P against the triangle P1,
+    // P1 + E1, P1 + E2, with the arithmetic of Triangles::LocalIntersect;
+    // returns the lanes hitting it with TMin < T < TMax[i] and stores their
+    // T, U and V
+    LaneMask IntersectTriangle(const RayPacket &P, LaneMask Active, const Real *P1, const Real *E1, const Real *E2,
+                               Real TMin, const Real *TMax, Real *T, Real *U, Real *V);
+
+    // Moller-Trumbore test of R against the first Count triangles of B, with
+    // the arithmetic of Triangles::LocalIntersect; returns the triangles (bit
+    // i for lane i) hit with TMin < T < TMax and stores their T, U and V
+    LaneMask IntersectTriangles(const Ray &R, const TriangleBlock &B, int Count, Real TMin, Real TMax,
+                                Real *T, Real *U, Real *V);
+}
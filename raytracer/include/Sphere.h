@@ -21,8 +21,8 @@ public:
 
     virtual Vector LocalNormalAt(Point &LocalPoint) override;
 
-    virtual std::vector<Intersection<Object>> Intersect(const Ray &R) override;
-    virtual std::vector<Intersection<Object>> LocalIntersect(const Ray &LocalRay) override;
+    using Object::LocalIntersect;
+    virtual void LocalIntersect(const Ray &LocalRay, std::vector<Intersection<Object>> &XS) override;
 
     static Sphere GlassSphere();
 
@@ -16,4 +16,8 @@
 #include "Cubes.h"
 #include "Cylinders.h"
 #include "Triangles.h"
-#include "ObjParser.h"
\ No newline at end of file
+#include "TriangleMesh.h"
+#include "ObjParser.h"
+#include "Instance.h"
+#include "SIMD.h"
+#include "MeshCache.h"
\ No newline at end of file
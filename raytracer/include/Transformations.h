@@ -12,11 +12,11 @@ public:
     static Matrix ViewTransform(Point &From, Point &To, Vector &Up);
     static Matrix ViewTransform(Point &&From, Point &&To, Vector &&Up);
 
-    static Matrix Translation(double X, double Y, double Z);
-    static Matrix Scaling(double X, double Y, double Z);
-    static Matrix RotationX(double Rad);
-    static Matrix RotationY(double Rad);
-    static Matrix RotationZ(double Rad);
+    static Matrix Translation(Real X, Real Y, Real Z);
+    static Matrix Scaling(Real X, Real Y, Real Z);
+    static Matrix RotationX(Real Rad);
+    static Matrix RotationY(Real Rad);
+    static Matrix RotationZ(Real Rad);
     // param XY means: how much we move X in proportion to Y
-    static Matrix Shearing(double XY, double XZ, double YX, double YZ, double ZX, double ZY);
+    static Matrix Shearing(Real XY, Real XZ, Real YX, Real YZ, Real ZX, Real ZY);
 };
\ No newline at end of file
@@ -0,0 +1,114 @@
+#pragma once
+
+#include "Object.h"
+#include "Point.h"
+#include "Vector.h"
+#include "Intersection.h"
+#include "BVH.h"
+#include <cstdint>
+#include <vector>
+
+// a whole triangle mesh as one shape: vertex positions and normals are
+// shared by the triangles in structure-of-arrays buffers, a triangle is just
+// its index in the index buffers and costs a few tens of bytes (its corner
+// indices, its entry in the hierarchy) plus its copy in the leaf blocks
+// instead of a Triangles object each.
+// Hits report the triangle in Intersection::GetIndex(). Flat triangles shade
+// with the normal of their plane like Triangles, smooth ones interpolate
+// their corner normals like SmoothTriangles; both kinds can be mixed.
+class TriangleMesh : public Object
+{
+    // writes and reads the buffers as they are
+    friend class MeshCache;
+
+    // vertex positions and normals, one array per axis
+    std::vector<Real> Vertices[3];
+    std::vector<Real> Normals[3];
+    // corners of triangle i at 3i, 3i + 1 and 3i + 2
+    std::vector<uint32_t> VertexIndices;
+    // normals of the corners, same layout, Flat for flat triangles; empty
+    // as long as the mesh has no smooth triangle
+    std::vector<uint32_t> NormalIndices;
+    // hierarchy over the triangles, a leaf holds Order[Offset, Offset + Count).
+    // Every leaf starts on a new block of Blocks, which holds a copy of its
+    // triangles packed for SIMD::IntersectTriangles (slot i of Order is lane
+    // i % Width of block i / Width)
+    std::vector<BVHNode> Nodes;
+    std::vector<uint32_t> Order;
+    std::vector<TriangleBlock> Blocks;
+    // some triangles are in several leaves (BVHCost::SpatialSplits)
+    bool SplitTriangles = false;
+    // set when the last Divide built a hierarchy too deep to traverse
+    BVH::Fallback Dropped = BVH::Fallback::None;
+
+public:
+    // normal index of the corners of flat triangles
+    static constexpr uint32_t Flat = UINT32_MAX;
+
+    TriangleMesh(int ID);
+    TriangleMesh();
+
+    int GetID();
+
+    // indices of the new vertex and normal, used to add triangles
+    uint32_t AddVertex(const Point &P);
+    uint32_t AddNormal(const Vector &N);
+    // add a flat triangle or one with a normal per corner and return its
+    // index; the hierarchy is dropped until the next Divide or Commit
+    uint32_t AddTriangle(uint32_t A, uint32_t B, uint32_t C);
+    uint32_t AddTriangle(uint32_t A, uint32_t B, uint32_t C, uint32_t NA, uint32_t NB, uint32_t NC);
+
+    inline size_t VertexCount() const { return Vertices[0].size(); }
+    inline size_t NormalCount() const { return Normals[0].size(); }
+    inline size_t TriangleCount() const { return VertexIndices.size() / 3; }
+    inline const std::vector<BVHNode> &GetNodes() const { return Nodes; }
+    // BVH::Fallback::TooDeep when the triangles are tested one by one
+    // because the hierarchy could not be traversed
+    inline BVH::Fallback GetFallback() const { return Dropped; }
+
+    // corner (0 to 2) of a triangle
+    Point GetVertex(uint32_t Triangle, int Corner) const;
+    Vector GetNormal(uint32_t Triangle, int Corner) const;
+    bool IsSmooth(uint32_t Triangle) const;
+
+    // bytes held by the buffers and the hierarchy
+    size_t MemoryUsage() const;
+
+    using Object::LocalNormalAt;
+    virtual Vector LocalNormalAt(Point &LocalPoint, Intersection<Object> &I) override;
+    virtual Vector LocalNormalAt(Point &&LocalPoint, Intersection<Object> &I) override;
+
+    using Object::LocalIntersect;
+    virtual void LocalIntersect(const Ray &LocalRay, std::vector<Intersection<Object>> &XS) override;
+    virtual bool LocalClosestHit(const Ray &LocalRay, Real TMin, Real &TMax, Intersection<Object> &Hit) override;
+    virtual bool LocalAnyHit(const Ray &LocalRay, Real TMin, Real TMax) override;
+    virtual LaneMask LocalClosestHits(const RayPacket &LocalPacket, LaneMask Active, Real TMin, Real *TMax,
+                                      Intersection<Object> *Hits) override;
+
+    // builds the hierarchy with the default cost model unless Divide did
+    virtual void Commit() override;
+
+    virtual BoundingBoxes BoundsOf() override;
+    // build the hierarchy over the triangles with the binned surface area
+    // heuristic of Groups::Divide(const BVHCost &), also splitting triangles
+    // at spatial planes when Cost.SpatialSplits is set
+    virtual void Divide(const BVHCost &Cost) override;
+
+    inline virtual std::shared_ptr<Object> Clone() override
+    {
+        return std::make_shared<TriangleMesh>(*this);
+    }
+
+private:
+    // Moller-Trumbore, with the arithmetic of Triangles::LocalIntersect
+    bool IntersectTriangle(uint32_t Triangle, const Ray &R, Real &T, Real &U, Real &V) const;
+    // first corner and edges of the triangle in a slot of Order, for the
+    // packet kernel
+    void GetEdges(uint32_t Slot, Real *P1, Real *E1, Real *E2) const;
+    // the triangles of Leaf in the block starting at Slot hit by R
+    LaneMask TestBlock(uint32_t Slot, const BVHNode &Leaf, const Ray &R, Real TMin, Real TMax,
+                       Real *T, Real *U, Real *V) const;
+    bool ClosestHitBelow(uint32_t Root, const Ray &R, Real TMin, Real &TMax, Intersection<Object> &Hit);
+    // forget the hierarchy and the cached bounds after an edit
+    void Changed();
+};
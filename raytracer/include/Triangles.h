@@ -33,7 +33,11 @@ public:
     virtual Vector LocalNormalAt(Point &LocalPoint) override;
     virtual Vector LocalNormalAt(Point &&LocalPoint) override;
 
-    virtual std::vector<Intersection<Object>> LocalIntersect(const Ray &LocalRay) override;
+    using Object::LocalIntersect;
+    virtual void LocalIntersect(const Ray &LocalRay, std::vector<Intersection<Object>> &XS) override;
+    // all the lanes are tested at once (SIMD::IntersectTriangle)
+    virtual LaneMask LocalClosestHits(const RayPacket &LocalPacket, LaneMask Active, Real TMin, Real *TMax,
+                                      Intersection<Object> *Hits) override;
     virtual BoundingBoxes BoundsOf() override;
 };
 
@@ -68,6 +72,10 @@ public:
     virtual Vector LocalNormalAt(Point &LocalPoint, Intersection<Object> &I) override;
     virtual Vector LocalNormalAt(Point &&LocalPoint, Intersection<Object> &I) override;
 
-    virtual std::vector<Intersection<Object>> LocalIntersect(const Ray &LocalRay) override;
+    using Object::LocalIntersect;
+    virtual void LocalIntersect(const Ray &LocalRay, std::vector<Intersection<Object>> &XS) override;
+    // all the lanes are tested at once (SIMD::IntersectTriangle)
+    virtual LaneMask LocalClosestHits(const RayPacket &LocalPacket, LaneMask Active, Real TMin, Real *TMax,
+                                      Intersection<Object> *Hits) override;
     virtual BoundingBoxes BoundsOf() override;
 };
\ No newline at end of file
@@ -1,39 +1,52 @@
 #pragma once
 
 // #include "doctest.h"
-#include "Matrix.h"
+#include <iostream>
 #include "Util.h"
 
-class Tuple : public Matrix
+// Tuple is a fixed-size 4-element value type. It lives entirely on the stack
+// (no heap allocation), and is the common base of Point and Vector.
+class Tuple
 {
+protected:
+    alignas(4 * sizeof(Real)) Real E[4];
 
 public:
-    public:
     Tuple();
-    Tuple(double X, double Y, double Z, double W);
-    Tuple(int NumRows, int NumCols);
+    Tuple(Real X, Real Y, Real Z, Real W);
 
-    inline double X() const { return this->At(0, 0); }
-    inline double Y() const { return this->At(1, 0); }
-    inline double Z() const { return this->At(2, 0); }
-    inline double W() const { return this->At(3, 0); }
+    inline Real X() const { return E[0]; }
+    inline Real Y() const { return E[1]; }
+    inline Real Z() const { return E[2]; }
+    inline Real W() const { return E[3]; }
 
-    Tuple operator-() const { return Tuple(-this->X(), -this->Y(), -this->Z(), -this->W()); }
+    inline void SetX(Real Val) { E[0] = Val; }
+    inline void SetY(Real Val) { E[1] = Val; }
+    inline void SetZ(Real Val) { E[2] = Val; }
+    inline void SetW(Real Val) { E[3] = Val; }
+
+    inline Real operator[](int I) const { return E[I]; }
+    inline Real &operator[](int I) { return E[I]; }
 
-    Tuple operator*(double S) const { return Tuple(this->X() * S, this->Y() * S, this->Z() * S, this->W() * S); }
+    inline const Real *Data() const { return E; }
+    inline Real *Data() { return E; }
 
-    Tuple operator/(double S) const { return Tuple(this->X() / S, this->Y() / S, this->Z() / S, this->W() / S); }
+    Tuple operator-() const { return Tuple(-this->X(), -this->Y(), -this->Z(), -this->W()); }
 
-    void operator=(const Matrix &M)
-    {
-        if (M.GetNumRows() != 4 && M.GetNumCols() != 1)
-            throw std::invalid_argument("size of a Tuple must be 4x1");
+    Tuple operator*(Real S) const { return Tuple(this->X() * S, this->Y() * S, this->Z() * S, this->W() * S); }
 
-        this->Set(0, 0, M.At(0, 0));
-        this->Set(1, 0, M.At(1, 0));
-        this->Set(2, 0, M.At(2, 0));
-        this->Set(3, 0, M.At(3, 0));
-    }
+    Tuple operator/(Real S) const { return Tuple(this->X() / S, this->Y() / S, this->Z() / S, this->W() / S); }
 };
 
+inline bool operator==(const Tuple &LHS, const Tuple &RHS)
+{
+    return Util::Equal(LHS.X(), RHS.X()) && Util::Equal(LHS.Y(), RHS.Y())
+        && Util::Equal(LHS.Z(), RHS.Z()) && Util::Equal(LHS.W(), RHS.W());
+}
+
+inline bool operator!=(const Tuple &LHS, const Tuple &RHS)
+{
+    return (!(LHS == RHS));
+}
+
 std::ostream &operator<<(std::ostream &os, const Tuple &T);
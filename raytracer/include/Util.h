@@ -2,10 +2,43 @@
 
 #include <limits>
 
+// Real is the floating point type of the whole renderer (tuples, matrices,
+// colors, intersections). Build with RAYTRACER_FLOAT defined to get a single
+// precision renderer, which halves the size of mesh and hierarchy data.
+#ifdef RAYTRACER_FLOAT
+using Real = float;
+#else
+using Real = double;
+#endif
+
 namespace Util
 {
-    const double EPSILON = 0.00001;
-    const double Inf = std::numeric_limits<double>::max();
+    // tolerance used for comparisons and for offsetting hit points off surfaces
+    template <class T>
+    struct Precision;
+
+    template <>
+    struct Precision<float>
+    {
+        static constexpr float Epsilon = 0.001f;
+        // offset added per unit of the largest coordinate of a hit point: the
+        // rounding of float hit points grows with their distance to the origin
+        static constexpr float Relative = 1.f / 65536;
+    };
+
+    template <>
+    struct Precision<double>
+    {
+        static constexpr double Epsilon = 0.00001;
+        // the rounding of double hit points stays far below Epsilon
+        static constexpr double Relative = 0.;
+    };
+
+    const Real EPSILON = Precision<Real>::Epsilon;
+    const Real Inf = std::numeric_limits<Real>::max();
 
-    bool Equal(const double &A, const double &B);
+    bool Equal(const Real &A, const Real &B);
+    // distance by which a hit point at (X, Y, Z) is moved off its surface
+    // before tracing the rays leaving it
+    Real SurfaceOffset(Real X, Real Y, Real Z);
 }
@@ -6,42 +6,107 @@
 #include "Light.h"
 #include "Object.h"
 #include "Intersection.h"
+#include "RayPacket.h"
 #include "Color.h"
+#include "BVH.h"
 
 class World
 {
     std::shared_ptr<Light> ALight;
     std::vector<std::shared_ptr<Object>> Objects;
 
+    // parent of the top-level objects once committed, so that one moved
+    // afterwards refits the hierarchy as it does in a group. It holds the
+    // hierarchy built by Commit() over the bounded objects; the unbounded
+    // ones (planes, infinite cylinders) would make every box infinite and
+    // are tested on every ray instead. Rays go through Objects one by one
+    // while there is no hierarchy (before Commit, after AddObject, or once
+    // refitting gave up)
+    class Root : public Object
+    {
+    public:
+        BVH Hierarchy;
+        std::vector<Object *> Unbounded;
+        // the objects committed under this root, let go of when it goes
+        std::vector<std::shared_ptr<Object>> Children;
+
+        Root();
+        ~Root();
+        void ChildBoundsChanged(Object *Child) override;
+    };
+    // on the heap: the objects point to it, it must not move with the world
+    std::unique_ptr<Root> Top = std::make_unique<Root>();
+
 public:
     World();
     World(Light &NewLight, std::vector<std::shared_ptr<Object>> &NewObjects);
     World(Light &&NewLight, std::vector<std::shared_ptr<Object>> &&NewObjects);
     static World DefaultWorld();
 
+    // a copy shares the objects but not the hierarchy, it is to be committed
+    // on its own (an object refits the world committed last); a move takes
+    // the hierarchy and leaves Other empty, with a root of its own
+    World(const World &Other);
+    World &operator=(const World &Other);
+    World(World &&Other);
+    World &operator=(World &&Other);
+
     inline void SetLight(Light &NewLight) { ALight = std::make_shared<Light>(NewLight); }
     inline void SetLight(Light &&NewLight) { SetLight(NewLight); };
 
     template <class Derived>
-    inline void AddObject(Derived &NewObject) { Objects.push_back(std::make_shared<Derived>(NewObject)); }
+    inline void AddObject(Derived &NewObject)
+    {
+        std::shared_ptr<Object> ObjectPtr = std::make_shared<Derived>(NewObject);
+        AddObject(ObjectPtr);
+    }
     template <class Derived>
     void AddObject(std::shared_ptr<Derived> &NewObjectPtr);
 
-    inline void AddObject(std::shared_ptr<Object> &NewObjectPtr) { Objects.push_back(NewObjectPtr); }
+    inline void AddObject(std::shared_ptr<Object> &NewObjectPtr)
+    {
+        Objects.push_back(NewObjectPtr);
+        Top->Hierarchy.Clear();
+    }
 
     inline std::shared_ptr<Light> GetLight() const { return ALight; }
     inline std::shared_ptr<Object> GetObjectAt(int Idx) const { return Objects[Idx]; }
     inline std::vector<std::shared_ptr<Object>> GetObjects() const { return Objects; }
 
+    // precompute per-object data that depends on the finished scene (composed
+    // group transforms) and build the hierarchy over the objects; call after
+    // the last object is added, before rendering; objects moved afterwards
+    // refit the hierarchy
+    void Commit();
+
+    inline const BVH &GetBVH() const { return Top->Hierarchy; }
+
     std::vector<Intersection<Object>> Intersect(const Ray &R);
+    // fill XS with the sorted intersections of R, reusing its storage
+    void Intersect(const Ray &R, std::vector<Intersection<Object>> &XS);
+
+    // nearest intersection with TMin < T < TMax, without building the full list
+    bool ClosestHit(const Ray &R, Real TMin, Real TMax, Intersection<Object> &Hit);
+    // whether anything casting shadows lies on the ray with TMin < T < TMax;
+    // stops at the first such hit
+    bool AnyHit(const Ray &R, Real TMin, Real TMax);
+    // ClosestHit for the lanes of a packet (see Object::ClosestHits)
+    LaneMask ClosestHits(const RayPacket &P, LaneMask Active, Real TMin, Real *TMax, Intersection<Object> *Hits);
     std::vector<Intersection<Object>> Intersect(const Ray &R, std::shared_ptr<Object> &ObjectPtr);
 
     Color ShadeHit(PreComputations<Object> &Comps, bool RenderShadow=true, int Remaining=5);
 
     Color ColorAt(Ray &R, bool RenderShadow, int Remaining);
+    // the colors of all the rays of P, Out[i] being ColorAt(P.GetRay(i)); the
+    // closest hits are found for the whole packet at once
+    void ColorsAt(const RayPacket &P, bool RenderShadow, int Remaining, Color *Out);
 
     bool IsShadowed(Point &P);
 
     Color ReflectedColor(PreComputations<Object> &Comps, bool RenderShadow, int Remaining);
     Color RefractedColor(PreComputations<Object> &Comps, bool RenderShadow=true, int Remaining=5);
+
+private:
+    // shade H, the closest hit of R
+    Color ColorOfHit(Ray &R, Intersection<Object> &H, bool RenderShadow, int Remaining);
 };
\ No newline at end of file
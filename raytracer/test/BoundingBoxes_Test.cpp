@@ -10,13 +10,14 @@
 #include "Triangles.h"
 #include "Groups.h"
 #include "CSG.h"
+#include <cmath>
 #include "gtest/gtest.h"
 #include <limits>
 #include <memory>
 
 TEST(BoundingBoxes, EmptyBoundingBox)
 {
-    double Inf = std::numeric_limits<double>::max();
+    Real Inf = std::numeric_limits<Real>::max();
 
     BoundingBoxes Box;
     EXPECT_EQ(Box.Min, Point(Inf, Inf, Inf));
@@ -108,6 +109,11 @@ TEST(BoundingBoxes, AddingOneBoundingBoxToAnother)
     Box1.AddBox(Box2);
     EXPECT_EQ(Box1.Min, Point(-5., -7., -2.));
     EXPECT_EQ(Box1.Max, Point(14., 4., 8.));
+
+    // an empty box adds nothing
+    Box1.AddBox(BoundingBoxes());
+    EXPECT_EQ(Box1.Min, Point(-5., -7., -2.));
+    EXPECT_EQ(Box1.Max, Point(14., 4., 8.));
 }
 
 TEST(BoundingBoxes, BoxContainsPoint)
@@ -390,4 +396,31 @@ TEST(BoundingBoxes, SplitZWideBox)
     EXPECT_EQ(Left.Max, Point(5., 3., 2.));
     EXPECT_EQ(Right.Min, Point(-1., -2., 2.));
     EXPECT_EQ(Right.Max, Point(5., 3., 7.));
-}
\ No newline at end of file
+}
+
+TEST(BoundingBoxes, EntryAndExitDistances)
+{
+    BoundingBoxes Box {Point(5., -2., 0.), Point(11, 4., 7.)};
+
+    auto T = Box.Intersect(RaySlabs(Ray(Point(15., 1., 2.), Vector(-1., 0., 0.))));
+    EXPECT_EQ(4., T.first);
+    EXPECT_EQ(10., T.second);
+
+    // starting inside, the entry lies behind the origin
+    T = Box.Intersect(RaySlabs(Ray(Point(7., 0., 3.), Vector(0., 0., 1.))));
+    EXPECT_EQ(-3., T.first);
+    EXPECT_EQ(4., T.second);
+
+    // clipped to the range the caller is interested in
+    T = Box.Intersect(RaySlabs(Ray(Point(7., 0., 3.), Vector(0., 0., 1.))), 0., 2.);
+    EXPECT_EQ(0., T.first);
+    EXPECT_EQ(2., T.second);
+    T = Box.Intersect(RaySlabs(Ray(Point(15., 1., 2.), Vector(-1., 0., 0.))), 0., 3.);
+    EXPECT_GT(T.first, T.second);
+
+    // parallel to a face, on its plane and outside of it
+    T = Box.Intersect(RaySlabs(Ray(Point(15., 4., 2.), Vector(-1., 0., 0.))));
+    EXPECT_LE(T.first, T.second);
+    T = Box.Intersect(RaySlabs(Ray(Point(15., 4.5, 2.), Vector(-1., 0., 0.))));
+    EXPECT_GT(T.first, T.second);
+}
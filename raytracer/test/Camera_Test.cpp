@@ -1,9 +1,15 @@
 #include "Camera.h"
 #include "Util.h"
 #include "Transformations.h"
+#include "Groups.h"
+#include "Triangles.h"
+#include <stdexcept>
 #include <iostream>
 #include <cmath>
 #include <chrono>
+#include <set>
+#include <algorithm>
+#include <vector>
 #include "gtest/gtest.h"
 
 TEST(Camera, ConstructingACamera) {
@@ -14,6 +20,163 @@ TEST(Camera, ConstructingACamera) {
   EXPECT_EQ(Cam.GetTransform(), Matrix::Identity(4));
 }
 
+TEST(Camera, PacketsRenderTheSameImage) {
+  // the default spheres behind a mesh-like hierarchy of triangles
+  auto W = World::DefaultWorld();
+  auto G = std::make_shared<Groups>(Groups());
+  for (int i = 0; i < 6; ++i)
+  {
+    for (int j = 0; j < 6; ++j)
+    {
+      std::shared_ptr<Object> T = std::make_shared<Triangles>(Triangles(Point(i * 0.3 - 1., j * 0.3 - 1., -2.),
+                                                                        Point(i * 0.3 - 0.7, j * 0.3 - 1., -2.1),
+                                                                        Point(i * 0.3 - 1., j * 0.3 - 0.75, -1.9)));
+      G->AddChild(T);
+    }
+  }
+  G->Divide(BVHCost());
+  std::shared_ptr<Object> GObj = G;
+  W.AddObject(GObj);
+  W.Commit();
+
+  // odd sizes, so that the last blocks are not full
+  Camera Cam(21, 11, M_PI/2);
+  Cam.SetTransform(Transformations::ViewTransform(Point(0., 0., -5.), Point(0., 0., 0.), Vector(0., 1., 0.)));
+  auto Expected = Cam.Render(W);
+
+  for (int Size : {4, 8, 16})
+  {
+    Cam.SetPacketSize(Size);
+    auto Image = Cam.Render(W, true, false, 5, 2);
+    for (int Y = 0; Y < 11; ++Y)
+    {
+      for (int X = 0; X < 21; ++X)
+      {
+        EXPECT_EQ(*Expected.GetPixel(X, Y), *Image.GetPixel(X, Y)) << Size << ' ' << X << ' ' << Y;
+      }
+    }
+  }
+
+  EXPECT_THROW(Cam.SetPacketSize(2), std::invalid_argument);
+}
+
+TEST(Camera, TilesCoverTheImageOnce) {
+  auto W = World::DefaultWorld();
+  Camera Cam(23, 13, M_PI/2);
+  Cam.SetTransform(Transformations::ViewTransform(Point(0., 0., -5.), Point(0., 0., 0.), Vector(0., 1., 0.)));
+  auto Expected = Cam.Render(W);
+
+  for (auto Order : {TileOrder::Rows, TileOrder::Morton, TileOrder::Spiral})
+  {
+    for (int Size : {1, 4, 5, 32})
+    {
+      Cam.SetTileOrder(Order);
+      Cam.SetTileSize(Size);
+      auto Tiles = Cam.Tiles();
+      std::set<std::pair<int, int>> Unique(Tiles.begin(), Tiles.end());
+      EXPECT_EQ(Unique.size(), Tiles.size());
+      EXPECT_EQ(Tiles.size(), static_cast<size_t>(((23 + Size - 1) / Size) * ((13 + Size - 1) / Size)));
+      for (auto &T : Tiles)
+      {
+        EXPECT_EQ(T.first % Size, 0);
+        EXPECT_EQ(T.second % Size, 0);
+        EXPECT_LT(T.first, 23);
+        EXPECT_LT(T.second, 13);
+      }
+
+      Cam.SetPacketSize(Size == 5 ? 16 : 1);
+      auto Image = Cam.Render(W, true, false, 5, 3);
+      for (int Y = 0; Y < 13; ++Y)
+      {
+        for (int X = 0; X < 23; ++X)
+        {
+          EXPECT_EQ(*Expected.GetPixel(X, Y), *Image.GetPixel(X, Y)) << Size << ' ' << X << ' ' << Y;
+        }
+      }
+    }
+  }
+
+  // the spiral starts in the middle
+  Cam.SetTileSize(5);
+  EXPECT_EQ(Cam.Tiles()[0], std::make_pair(10, 5));
+  EXPECT_THROW(Cam.SetTileSize(0), std::invalid_argument);
+}
+
+TEST(Camera, ProgressIsReportedUntilTheEnd) {
+  auto W = World::DefaultWorld();
+  Camera Cam(23, 13, M_PI/2);
+  Cam.SetTransform(Transformations::ViewTransform(Point(0., 0., -5.), Point(0., 0., 0.), Vector(0., 1., 0.)));
+  Cam.SetTileSize(4);
+
+  // with no interval every tile may report, the reports never go backwards
+  // and the last one is the whole image
+  std::vector<int> Reports;
+  Cam.SetProgressCallback([&](int Done, int Total) {
+    EXPECT_EQ(Total, 23 * 13);
+    Reports.push_back(Done);
+  }, std::chrono::milliseconds(0));
+  for (int Round = 0; Round < 20; ++Round)
+  {
+    Reports.clear();
+    Cam.Render(W, true, false, 5, 3);
+    ASSERT_FALSE(Reports.empty());
+    EXPECT_TRUE(std::is_sorted(Reports.begin(), Reports.end()));
+    EXPECT_EQ(Reports.back(), 23 * 13);
+    EXPECT_EQ(std::count(Reports.begin(), Reports.end(), 23 * 13), 1);
+  }
+
+  // every tile is done once before the job is
+  RenderJob Job(3, 30);
+  Job.Finish(2, 10);
+  Job.Finish(0, 10);
+  EXPECT_FALSE(Job.Done());
+  Job.Finish(1, 10);
+  Job.Wait();
+  EXPECT_TRUE(Job.Done());
+  EXPECT_EQ(Job.GetPixelsDone(), 30);
+  for (int t = 0; t < 3; ++t)
+    EXPECT_EQ(Job.GetCompletions(t), 1);
+}
+
+TEST(Camera, ProgressivePassesEndOnTheSameImage) {
+  auto W = World::DefaultWorld();
+  Camera Cam(23, 13, M_PI/2);
+  Cam.SetTransform(Transformations::ViewTransform(Point(0., 0., -5.), Point(0., 0., 0.), Vector(0., 1., 0.)));
+  Cam.SetTileSize(5);
+  auto Expected = Cam.Render(W);
+
+  // every pass shows a full image, whose pixels on the grid are final
+  std::vector<int> Strides;
+  Cam.SetProgressiveStride(4);
+  Cam.SetPreviewCallback([&](Canvas &Image, int Stride) {
+    Strides.push_back(Stride);
+    for (int Y = 0; Y < 13; ++Y)
+    {
+      for (int X = 0; X < 23; ++X)
+      {
+        int CX = X / Stride * Stride, CY = Y / Stride * Stride;
+        EXPECT_EQ(*Expected.GetPixel(CX, CY), *Image.GetPixel(X, Y)) << Stride << ' ' << X << ' ' << Y;
+      }
+    }
+  }, std::chrono::milliseconds(0));
+  int Traced = 0;
+  Cam.SetProgressCallback([&](int Done, int) { Traced = Done; }, std::chrono::milliseconds(0));
+
+  auto Image = Cam.Render(W, true, false, 5, 3);
+  EXPECT_EQ(Strides, std::vector<int>({4, 2}));
+  EXPECT_EQ(Traced, 23 * 13);
+  for (int Y = 0; Y < 13; ++Y)
+  {
+    for (int X = 0; X < 23; ++X)
+    {
+      EXPECT_EQ(*Expected.GetPixel(X, Y), *Image.GetPixel(X, Y)) << X << ' ' << Y;
+    }
+  }
+
+  EXPECT_THROW(Cam.SetProgressiveStride(3), std::invalid_argument);
+  EXPECT_THROW(Cam.SetProgressiveStride(0), std::invalid_argument);
+}
+
 // TEST_CASE("Constructing a camera")
 // {
 //     Camera Cam(160, 120, M_PI/2);
@@ -3,8 +3,10 @@
 #include "Intersection.h"
 #include "Util.h"
 #include "Sphere.h"
+#include "Plane.h"
 #include "Transformations.h"
 #include "Functions.h"
+#include <cmath>
 #include "gtest/gtest.h"
 
 TEST(Groups, IntersectingRayGroupMissBoundingBox)
@@ -121,4 +123,397 @@ TEST(Groups, SubdividingGroupWithoutPartitions)
     EXPECT_EQ(Subgroup->GetChildren()[0].get(), S1->GetParent());
     EXPECT_EQ(Subgroup->GetChildren()[1].get(), S2->GetParent());
     EXPECT_EQ(Subgroup->GetChildren()[1].get(), S2->GetParent());
-}
\ No newline at end of file
+}
+
+TEST(Groups, CommittedChildUsesComposedTransforms)
+{
+    auto G1 = std::make_shared<Groups>(Groups());
+    G1->SetTransform(Transformations::RotationY(M_PI / 2));
+    auto G2 = std::make_shared<Groups>(Groups());
+    G2->SetTransform(Transformations::Scaling(1., 2., 3.));
+    std::shared_ptr<Object> G2Obj = G2;
+    G1->AddChild(G2Obj);
+    std::shared_ptr<Object> S = std::make_shared<Sphere>(Sphere());
+    S->SetTransform(Transformations::Translation(5., 0., 0.));
+    G2->AddChild(S);
+
+    Point P(1.7321, 1.1547, -5.5774);
+    auto Expected = S->NormalAt(P);
+
+    G1->Commit();
+    EXPECT_TRUE(S->Committed());
+    EXPECT_EQ(S->GetTransformInverse().Mul(G2->GetTransformInverse()).Mul(G1->GetTransformInverse()),
+              S->GetWorldInverse());
+    EXPECT_EQ(Expected, S->NormalAt(P));
+    EXPECT_EQ(Vector(0.2857, 0.42854, -0.85716), S->NormalAt(P));
+
+    // changing a group transform drops the composed matrices of its subtree
+    G2->SetTransform(Transformations::Scaling(2., 2., 2.));
+    EXPECT_FALSE(S->Committed());
+    EXPECT_EQ(Point(0., 0., -1.), TRay::WorldToObject(S.get(), Point(-2., 0., -10.)));
+
+    G1->Commit();
+    EXPECT_EQ(Point(0., 0., -1.), TRay::WorldToObject(S.get(), Point(-2., 0., -10.)));
+}
+
+TEST(Groups, IntersectingIntoACallerOwnedBuffer)
+{
+    auto G = std::make_shared<Groups>(Groups());
+    std::shared_ptr<Object> S1 = std::make_shared<Sphere>(Sphere());
+    std::shared_ptr<Object> S2 = std::make_shared<Sphere>(Sphere());
+    S2->SetTransform(Transformations::Translation(0., 0., -3.));
+    G->AddChild(S1);
+    G->AddChild(S2);
+
+    Ray R(Point(0., 0., -5.), Vector(0., 0., 1.));
+    std::vector<Intersection<Object>> XS;
+    XS.push_back(Intersection<Object>(-1., S1.get()));
+    G->Intersect(R, XS);
+
+    // hits are appended after what the caller already had
+    ASSERT_EQ(5, XS.size());
+    EXPECT_EQ(-1., XS[0].GetT());
+
+    auto Sorted = G->Intersect(R);
+    ASSERT_EQ(4, Sorted.size());
+    EXPECT_EQ(S2.get(), Sorted[0].GetObject());
+    EXPECT_EQ(S2.get(), Sorted[1].GetObject());
+    EXPECT_EQ(S1.get(), Sorted[2].GetObject());
+    EXPECT_EQ(S1.get(), Sorted[3].GetObject());
+}
+
+namespace
+{
+    // depth-first walk collecting the primitives of the hierarchy, checking
+    // that every child of a subgroup lies inside the subgroup's box
+    void CollectLeaves(Object *G, int MaxLeafSize, std::vector<Object *> &Leaves)
+    {
+        auto Box = G->BoundsOf();
+        for (auto &C : G->GetChildren())
+        {
+            EXPECT_TRUE(Box.ContainsBox(C->ParentSpaceBoundsOf()));
+            if (dynamic_cast<Groups *>(C.get()))
+            {
+                CollectLeaves(C.get(), MaxLeafSize, Leaves);
+            }
+            else
+            {
+                Leaves.push_back(C.get());
+            }
+        }
+        EXPECT_LE(G->GetCount(), std::max(MaxLeafSize, 2));
+    }
+
+    // whether the boxes of A and B are apart along some axis
+    bool Disjoint(const BoundingBoxes &A, const BoundingBoxes &B)
+    {
+        for (int a = 0; a < 3; ++a)
+        {
+            if (A.Max[a] < B.Min[a] || B.Max[a] < A.Min[a])
+                return true;
+        }
+        return false;
+    }
+
+    // the subgroups side by side in the hierarchy below G do not overlap, as
+    // a surface area split of well separated shapes leaves them
+    void ExpectSubgroupsApart(Object *G)
+    {
+        std::vector<Object *> Subgroups;
+        for (auto &C : G->GetChildren())
+        {
+            if (dynamic_cast<Groups *>(C.get()))
+                Subgroups.push_back(C.get());
+        }
+        for (size_t i = 0; i < Subgroups.size(); ++i)
+        {
+            for (size_t j = i + 1; j < Subgroups.size(); ++j)
+                EXPECT_TRUE(Disjoint(Subgroups[i]->ParentSpaceBoundsOf(), Subgroups[j]->ParentSpaceBoundsOf()));
+            ExpectSubgroupsApart(Subgroups[i]);
+        }
+    }
+}
+
+TEST(Groups, SurfaceAreaHeuristicPartitionsEveryChild)
+{
+    auto G = std::make_shared<Groups>(Groups());
+    std::vector<Object *> Spheres;
+    for (int i = 0; i < 64; ++i)
+    {
+        // a 4x4x4 grid, added out of order so that splitting by count does not
+        // happen to separate the spheres
+        int Cell = i * 37 % 64;
+        std::shared_ptr<Object> S = std::make_shared<Sphere>(Sphere());
+        S->SetTransform(Transformations::Translation(Cell % 4 * 3., Cell / 4 % 4 * 3., Cell / 16 * 3.)
+                            .Mul(Transformations::Scaling(0.5, 0.5, 0.5)));
+        G->AddChild(S);
+        Spheres.push_back(S.get());
+    }
+    std::shared_ptr<Object> P = std::make_shared<Plane>(Plane());
+    G->AddChild(P);
+
+    BVHCost Cost;
+    Cost.MaxLeafSize = 4;
+    G->Divide(Cost);
+
+    // the unbounded plane stays at the top, next to the two halves
+    auto Children = G->GetChildren();
+    ASSERT_EQ(3, Children.size());
+    EXPECT_EQ(P.get(), Children[0].get());
+
+    std::vector<Object *> Leaves;
+    for (size_t i = 1; i < Children.size(); ++i)
+    {
+        ASSERT_NE(nullptr, dynamic_cast<Groups *>(Children[i].get()));
+        CollectLeaves(Children[i].get(), Cost.MaxLeafSize, Leaves);
+    }
+    std::sort(Leaves.begin(), Leaves.end());
+    std::sort(Spheres.begin(), Spheres.end());
+    EXPECT_EQ(Spheres, Leaves);
+    ExpectSubgroupsApart(G.get());
+
+    G->Commit();
+    Ray R(Point(3., 3., -5.), Vector(0., 0., 1.));
+    auto XS = G->Intersect(R);
+    ASSERT_EQ(8, XS.size());
+    EXPECT_TRUE(Util::Equal(-0.5 + 5., XS[0].GetT()));
+}
+
+TEST(Groups, CommitCompilesTheHierarchy)
+{
+    // an identity subgroup is folded into the nodes, a transformed one is
+    // kept as a primitive with a hierarchy of its own
+    auto G = std::make_shared<Groups>(Groups());
+    auto Inner = std::make_shared<Groups>(Groups());
+    auto Moved = std::make_shared<Groups>(Groups());
+    Moved->SetTransform(Transformations::Translation(0., 0., 10.));
+    std::vector<std::shared_ptr<Object>> Spheres;
+    for (int i = 0; i < 6; ++i)
+    {
+        std::shared_ptr<Object> S = std::make_shared<Sphere>(Sphere());
+        S->SetTransform(Transformations::Translation(0., 0., 3. * i));
+        Spheres.push_back(S);
+        (i < 2 ? G : i < 4 ? Inner : Moved)->AddChild(S);
+    }
+    std::shared_ptr<Object> InnerObj = Inner;
+    std::shared_ptr<Object> MovedObj = Moved;
+    G->AddChild(InnerObj);
+    G->AddChild(MovedObj);
+
+    Ray R(Point(0., 0., -5.), Vector(0., 0., 1.));
+    auto Expected = G->Intersect(R);
+    ASSERT_EQ(12, Expected.size());
+
+    G->Commit();
+    EXPECT_EQ(5, G->GetBVH().PrimitiveCount());
+    EXPECT_TRUE(Inner->GetBVH().Empty());
+    EXPECT_EQ(2, Moved->GetBVH().PrimitiveCount());
+
+    auto XS = G->Intersect(R);
+    ASSERT_EQ(Expected.size(), XS.size());
+    for (size_t i = 0; i < XS.size(); ++i)
+    {
+        EXPECT_EQ(Expected[i].GetObject(), XS[i].GetObject());
+        EXPECT_EQ(Expected[i].GetT(), XS[i].GetT());
+    }
+
+    Real TMax = Util::Inf;
+    Intersection<Object> Hit;
+    ASSERT_TRUE(G->ClosestHit(R, 9.5, TMax, Hit));
+    EXPECT_EQ(Spheres[2].get(), Hit.GetObject());
+    EXPECT_TRUE(G->AnyHit(R, 25., 27.));
+    EXPECT_FALSE(G->AnyHit(R, 16., 25.5));
+
+    // adding a child drops the compiled hierarchy until the next commit
+    std::shared_ptr<Object> S = std::make_shared<Sphere>(Sphere());
+    S->SetTransform(Transformations::Translation(0., 0., -3.));
+    G->AddChild(S);
+    EXPECT_TRUE(G->GetBVH().Empty());
+    EXPECT_EQ(14, G->Intersect(R).size());
+}
+
+TEST(Groups, ParallelBuildMatchesSerialBuild)
+{
+    // enough children for the builder to hand subtrees to other threads
+    std::vector<std::shared_ptr<Groups>> Built;
+    for (int Threads : {1, 4})
+    {
+        auto G = std::make_shared<Groups>(Groups());
+        for (int i = 0; i < 10000; ++i)
+        {
+            std::shared_ptr<Object> S = std::make_shared<Sphere>(Sphere());
+            S->SetTransform(Transformations::Translation(i % 100, (i * 37) % 101, i / 100)
+                                .Mul(Transformations::Scaling(0.25, 0.25, 0.25)));
+            G->AddChild(S);
+        }
+        BVHCost Cost;
+        Cost.Threads = Threads;
+        G->Divide(Cost);
+        G->Commit();
+        Built.push_back(G);
+    }
+
+    auto &Serial = Built[0]->GetBVH();
+    auto &Parallel = Built[1]->GetBVH();
+    ASSERT_EQ(Serial.NodeCount(), Parallel.NodeCount());
+    EXPECT_EQ(10000, Parallel.PrimitiveCount());
+    for (size_t i = 0; i < Serial.NodeCount(); ++i)
+    {
+        EXPECT_EQ(Serial.GetNodes()[i].Offset, Parallel.GetNodes()[i].Offset);
+        EXPECT_EQ(Serial.GetNodes()[i].Count, Parallel.GetNodes()[i].Count);
+    }
+}
+
+TEST(Groups, ClosestHitSkipsChildrenBehindTheHit)
+{
+    // the shapes behind the sphere are added first, a traversal in insertion
+    // order would test all of them
+    auto G = std::make_shared<Groups>(Groups());
+    std::vector<std::shared_ptr<TestShape>> Behind;
+    for (int i = 1; i <= 8; ++i)
+    {
+        auto Child = std::make_shared<TestShape>(TestShape());
+        Child->SetTransform(Transformations::Translation(0., 0., 10. * i));
+        std::shared_ptr<Object> ChildObj = Child;
+        G->AddChild(ChildObj);
+        Behind.push_back(Child);
+    }
+    std::shared_ptr<Object> S = std::make_shared<Sphere>(Sphere());
+    G->AddChild(S);
+
+    BVHCost Cost;
+    Cost.MaxLeafSize = 1;
+    G->Divide(Cost);
+    G->Commit();
+
+    Ray R(Point(0., 0., -5.), Vector(0., 0., 1.));
+    Real TMax = Util::Inf;
+    Intersection<Object> Hit;
+    ASSERT_TRUE(G->ClosestHit(R, 0., TMax, Hit));
+    EXPECT_EQ(S.get(), Hit.GetObject());
+    // the nearest one ends up in the leaf of the sphere
+    for (size_t i = 1; i < Behind.size(); ++i)
+        EXPECT_EQ(nullptr, Behind[i]->SavedRay);
+
+    // all the hits still go through every box the ray enters
+    G->Intersect(R);
+    for (auto &Child : Behind)
+        EXPECT_NE(nullptr, Child->SavedRay);
+}
+
+namespace
+{
+    // a row of spheres divided into nested subgroups, and a transformed
+    // subgroup (with a hierarchy of its own) holding Inner
+    std::shared_ptr<Groups> MakeRow(std::vector<std::shared_ptr<Object>> &Spheres, std::shared_ptr<Object> &Inner)
+    {
+        auto G = std::make_shared<Groups>(Groups());
+        for (int i = 0; i < 16; ++i)
+        {
+            std::shared_ptr<Object> S = std::make_shared<Sphere>(Sphere());
+            S->SetTransform(Transformations::Translation(3. * i, 0., 0.));
+            G->AddChild(S);
+            Spheres.push_back(S);
+        }
+        auto Sub = std::make_shared<Groups>(Groups());
+        Sub->SetTransform(Transformations::Translation(0., 10., 0.));
+        Inner = std::make_shared<Sphere>(Sphere());
+        Sub->AddChild(Inner);
+        std::shared_ptr<Object> SubObj = Sub;
+        G->AddChild(SubObj);
+
+        G->Divide(BVHCost());
+        G->Commit();
+        return G;
+    }
+}
+
+TEST(Groups, MovingAChildRefitsTheHierarchy)
+{
+    std::vector<std::shared_ptr<Object>> Spheres;
+    std::shared_ptr<Object> Inner;
+    auto G = MakeRow(Spheres, Inner);
+    auto Nodes = G->GetBVH().NodeCount();
+    ASSERT_LT(0u, Nodes);
+    EXPECT_EQ(11., G->BoundsOf().Max.Y());
+
+    // no new commit, the nodes above the sphere follow it
+    Spheres[5]->SetTransform(Transformations::Translation(15., 5., 0.));
+    EXPECT_EQ(Nodes, G->GetBVH().NodeCount());
+    Real TMax = Util::Inf;
+    Intersection<Object> Hit;
+    ASSERT_TRUE(G->ClosestHit(Ray(Point(15., 5., -5.), Vector(0., 0., 1.)), 0., TMax, Hit));
+    EXPECT_EQ(Spheres[5].get(), Hit.GetObject());
+
+    // and so do the ones above the transformed subgroup
+    Inner->SetTransform(Transformations::Translation(0., 20., 0.));
+    EXPECT_EQ(31., G->BoundsOf().Max.Y());
+    EXPECT_TRUE(G->AnyHit(Ray(Point(0., 30., -5.), Vector(0., 0., 1.)), 0., Util::Inf));
+    EXPECT_EQ(Nodes, G->GetBVH().NodeCount());
+}
+
+TEST(Groups, ScramblingTheChildrenRebuildsTheHierarchy)
+{
+    std::vector<std::shared_ptr<Object>> Spheres;
+    std::shared_ptr<Object> Inner;
+    auto G = MakeRow(Spheres, Inner);
+
+    // neighbours end up far apart, refitting would leave boxes spanning the
+    // whole row: the hierarchy is dropped and the children tested one by one
+    for (int i = 0; i < 16; ++i)
+        Spheres[i]->SetTransform(Transformations::Translation(3. * ((i * 7 + 3) % 16), 0., 0.));
+    EXPECT_TRUE(G->GetBVH().Empty());
+    EXPECT_EQ(BVH::Fallback::Degraded, G->GetBVH().GetFallback());
+
+    Ray R(Point(-5., 0., 0.), Vector(1., 0., 0.));
+    Real TMax = Util::Inf;
+    Intersection<Object> Hit;
+    ASSERT_TRUE(G->ClosestHit(R, 0., TMax, Hit));
+    EXPECT_EQ(Spheres[11].get(), Hit.GetObject());
+
+    G->Commit();
+    EXPECT_FALSE(G->GetBVH().Empty());
+    EXPECT_EQ(BVH::Fallback::None, G->GetBVH().GetFallback());
+    TMax = Util::Inf;
+    ASSERT_TRUE(G->ClosestHit(R, 0., TMax, Hit));
+    EXPECT_EQ(Spheres[11].get(), Hit.GetObject());
+}
+
+TEST(Groups, HierarchyTooDeepToTraverseFallsBack)
+{
+    // every group holds a sphere and the next group, folded in one level
+    // deeper than the last: the nodes would not fit the traversal stack
+    const int Depth = BVH::StackSize + 8;
+    std::vector<std::shared_ptr<Object>> Spheres;
+    auto Top = std::make_shared<Groups>(Groups());
+    auto G = Top;
+    for (int i = 0; i < Depth; ++i)
+    {
+        std::shared_ptr<Object> S = std::make_shared<Sphere>(Sphere());
+        S->SetTransform(Transformations::Translation(3. * i, 0., 0.));
+        Spheres.push_back(S);
+        G->AddChild(S);
+        auto Next = std::make_shared<Groups>(Groups());
+        std::shared_ptr<Object> Child = Next;
+        G->AddChild(Child);
+        G = Next;
+    }
+    Top->Commit();
+    EXPECT_TRUE(Top->GetBVH().Empty());
+    EXPECT_EQ(BVH::Fallback::TooDeep, Top->GetBVH().GetFallback());
+
+    // the children are tested one by one, and still found
+    for (int i = 0; i < Depth; i += 7)
+    {
+        Ray R(Point(3. * i, 0., -5.), Vector(0., 0., 1.));
+        Real TMax = Util::Inf;
+        Intersection<Object> Hit;
+        ASSERT_TRUE(Top->ClosestHit(R, 0., TMax, Hit));
+        EXPECT_EQ(Spheres[i].get(), Hit.GetObject());
+        EXPECT_TRUE(Util::Equal(4., TMax));
+        EXPECT_TRUE(Top->AnyHit(R, 0., Util::Inf));
+    }
+    std::vector<Intersection<Object>> XS;
+    Top->Intersect(Ray(Point(-5., 0., 0.), Vector(1., 0., 0.)), XS);
+    EXPECT_EQ(2u * Depth, XS.size());
+}
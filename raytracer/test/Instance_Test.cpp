@@ -0,0 +1,63 @@
+#include "Instance.h"
+#include "Groups.h"
+#include "Sphere.h"
+#include "Transformations.h"
+#include "Functions.h"
+#include "Util.h"
+#include <cmath>
+#include "gtest/gtest.h"
+
+namespace
+{
+    std::shared_ptr<Groups> MakePrototype()
+    {
+        auto Proto = std::make_shared<Groups>(Groups());
+        std::shared_ptr<Object> S = std::make_shared<Sphere>(Sphere());
+        S->SetTransform(Transformations::Translation(0., 0., 1.));
+        Proto->AddChild(S);
+        return Proto;
+    }
+}
+
+TEST(Instance, InstancesShareOnePrototype)
+{
+    auto Proto = MakePrototype();
+    auto Sphere1 = Proto->GetShapes()[0];
+    std::shared_ptr<Object> A = std::make_shared<Instance>(Proto);
+    A->SetTransform(Transformations::Translation(5., 0., 0.));
+    A->SetMaterial(Material(Color(1., 0., 0.), 0.1, 0.9, 0.9, 200.));
+    auto B = A->Clone();
+    B->SetTransform(Transformations::Translation(-5., 0., 0.).Mul(Transformations::Scaling(2., 2., 2.)));
+    B->SetMaterial(Material(Color(0., 0., 1.), 0.1, 0.9, 0.9, 200.));
+
+    auto G = std::make_shared<Groups>(Groups());
+    G->AddChild(A);
+    G->AddChild(B);
+    G->Commit();
+    EXPECT_TRUE(Proto->Committed());
+    EXPECT_EQ(Proto.get(), Sphere1->GetParent());
+
+    // hits are reported on the instance, with the prototype primitive inside
+    Ray R(Point(5., 0., -5.), Vector(0., 0., 1.));
+    auto XS = G->Intersect(R);
+    ASSERT_EQ(2, XS.size());
+    EXPECT_EQ(A.get(), XS[0].GetObject());
+    EXPECT_EQ(Sphere1.get(), XS[0].GetInner());
+    EXPECT_TRUE(Util::Equal(5., XS[0].GetT()));
+
+    Real TMax = Util::Inf;
+    Intersection<Object> Hit;
+    ASSERT_TRUE(G->ClosestHit(Ray(Point(-5., 0., -5.), Vector(0., 0., 1.)), 0., TMax, Hit));
+    EXPECT_EQ(B.get(), Hit.GetObject());
+    EXPECT_TRUE(Util::Equal(5., TMax));
+    EXPECT_EQ(Color(0., 0., 1.), Hit.GetObject()->GetMaterial().GetColor());
+    EXPECT_EQ(Color(1., 0., 0.), XS[0].GetObject()->GetMaterial().GetColor());
+
+    // normals go through the transform of the instance that was hit
+    auto P = Point(-5. + std::sqrt(2.), 0., 2. - std::sqrt(2.));
+    EXPECT_EQ(Vector(std::sqrt(2.) / 2, 0., -std::sqrt(2.) / 2), B->NormalAt(P, Hit));
+
+    B->SetShadowOn(false);
+    EXPECT_TRUE(G->AnyHit(R, 0., 10.));
+    EXPECT_FALSE(G->AnyHit(Ray(Point(-5., 0., -5.), Vector(0., 0., 1.)), 0., 10.));
+}
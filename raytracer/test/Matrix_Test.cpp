@@ -0,0 +1,132 @@
+#include "Matrix.h"
+#include "Sphere.h"
+#include "Groups.h"
+#include "Transformations.h"
+#include "Functions.h"
+#include "Util.h"
+#include <cmath>
+#include <stdexcept>
+#include "gtest/gtest.h"
+
+namespace
+{
+    Matrix Make4x4(std::initializer_list<double> Values)
+    {
+        Matrix M(4, 4);
+        int i = 0;
+        for (auto V : Values)
+        {
+            M(i / 4, i % 4) = V;
+            ++i;
+        }
+        return M;
+    }
+
+    // the textbook definition, kept here to check the closed form against
+    Matrix CofactorInverse(const Matrix &A)
+    {
+        Matrix Res(4, 4);
+        for (int r = 0; r < 4; ++r)
+        {
+            for (int c = 0; c < 4; ++c)
+            {
+                Res(c, r) = A.Cofactor(r, c) / A.Determinant();
+            }
+        }
+        return Res;
+    }
+}
+
+TEST(Matrix, DeterminantOfA4x4Matrix)
+{
+    auto A = Make4x4({-2., -8., 3., 5.,
+                      -3., 1., 7., 3.,
+                      1., 2., -9., 6.,
+                      -6., 7., 7., -9.});
+    EXPECT_DOUBLE_EQ(-4071., A.Determinant());
+    EXPECT_TRUE(A.IsInvertible());
+}
+
+TEST(Matrix, NoninvertibleMatrixThrows)
+{
+    auto A = Make4x4({-4., 2., -2., -3.,
+                      9., 6., 2., 6.,
+                      0., -5., 1., -5.,
+                      0., 0., 0., 0.});
+    EXPECT_FALSE(A.IsInvertible());
+    EXPECT_THROW(A.Inverse(), std::invalid_argument);
+}
+
+TEST(Matrix, CalculatingTheInverseOfAMatrix)
+{
+    auto A = Make4x4({-5., 2., 6., -8.,
+                      1., -5., 1., 8.,
+                      7., 7., -6., -7.,
+                      1., -3., 7., 4.});
+    auto B = Make4x4({0.21805, 0.45113, 0.24060, -0.04511,
+                      -0.80827, -1.45677, -0.44361, 0.52068,
+                      -0.07895, -0.22368, -0.05263, 0.19737,
+                      -0.52256, -0.81391, -0.30075, 0.30639});
+
+    EXPECT_DOUBLE_EQ(532., A.Determinant());
+    EXPECT_EQ(B, A.Inverse());
+}
+
+TEST(Matrix, ClosedFormInverseMatchesCofactorExpansion)
+{
+    std::vector<Matrix> Samples {
+        Make4x4({8., -5., 9., 2., 7., 5., 6., 1., -6., 0., 9., 6., -3., 0., -9., -4.}),
+        Make4x4({9., 3., 0., 9., -5., -2., -6., -3., -4., 9., 6., 4., -7., 6., 6., 2.}),
+        Transformations::Translation(1., -3., 5.).Mul(Transformations::RotationX(M_PI / 3))
+            .Mul(Transformations::Shearing(1., 0.5, 0., 0.25, 0., 2.)).Mul(Transformations::Scaling(0.5, 2., 4.)),
+        Transformations::ViewTransform(Point(1., 3., 2.), Point(4., -2., 8.), Vector(1., 1., 0.)),
+    };
+
+    for (auto &A : Samples)
+    {
+        EXPECT_EQ(CofactorInverse(A), A.Inverse());
+        EXPECT_EQ(Matrix::Identity(), A.Mul(A.Inverse()));
+    }
+}
+
+TEST(Matrix, InverseOfSmallerMatrices)
+{
+    Matrix A(3, 3);
+    A(0, 0) = 2.;
+    A(1, 1) = 4.;
+    A(2, 2) = 0.5;
+    A(0, 2) = 1.;
+
+    auto Inv = A.Inverse();
+    EXPECT_EQ(3, Inv.GetNumRows());
+    EXPECT_EQ(Matrix::Identity(3), A.Mul(Inv));
+}
+
+TEST(Matrix, ObjectCachesItsNormalTransform)
+{
+    Sphere S;
+    auto M = Transformations::Scaling(1., 0.5, 1.).Mul(Transformations::RotationZ(M_PI / 5));
+    S.SetTransform(M);
+
+    EXPECT_EQ(M.Inverse(), S.GetTransformInverse());
+    EXPECT_EQ(M.Inverse().T(), S.GetNormalTransform());
+
+    auto N = S.NormalAt(Point(0., std::sqrt(2.) / 2, -std::sqrt(2.) / 2));
+    EXPECT_EQ(Vector(0., 0.97014, -0.24254), N);
+}
+
+TEST(Matrix, NormalOnAChildObject)
+{
+    auto G1 = std::make_shared<Groups>(Groups());
+    G1->SetTransform(Transformations::RotationY(M_PI / 2));
+    auto G2 = std::make_shared<Groups>(Groups());
+    G2->SetTransform(Transformations::Scaling(1., 2., 3.));
+    std::shared_ptr<Object> G2Obj = G2;
+    G1->AddChild(G2Obj);
+    std::shared_ptr<Object> S = std::make_shared<Sphere>(Sphere());
+    S->SetTransform(Transformations::Translation(5., 0., 0.));
+    G2->AddChild(S);
+
+    auto N = TRay::NormalToWorld(S.get(), Vector(std::sqrt(3.) / 3, std::sqrt(3.) / 3, std::sqrt(3.) / 3));
+    EXPECT_EQ(Vector(0.28571, 0.42857, -0.85714), N);
+}
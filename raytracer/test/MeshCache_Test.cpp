@@ -0,0 +1,117 @@
+#include "MeshCache.h"
+#include "ObjParser.h"
+#include "Util.h"
+#include <cmath>
+#include <fstream>
+#include <stdexcept>
+#include "gtest/gtest.h"
+
+namespace
+{
+    // a fresh directory with a small obj model (a fan of flat triangles and
+    // one smooth triangle), removed at the end of the test
+    struct Workspace
+    {
+        std::filesystem::path Directory;
+        std::filesystem::path Model;
+
+        Workspace()
+        {
+            auto Test = ::testing::UnitTest::GetInstance()->current_test_info();
+            Directory = std::filesystem::temp_directory_path() / (std::string("MeshCache_") + Test->name());
+            std::filesystem::remove_all(Directory);
+            std::filesystem::create_directories(Directory);
+
+            Model = Directory / "fan.obj";
+            std::ofstream File(Model);
+            File << "v 0 0 0\n";
+            for (int i = 0; i <= 40; ++i)
+                File << "v " << std::cos(i * 0.15) << " " << std::sin(i * 0.15) << " " << 0.01 * i << "\n";
+            for (int i = 2; i <= 41; ++i)
+                File << "f 1 " << i << " " << i + 1 << "\n";
+            File << "vn 0 0 1\nvn 0 1 0\nvn 1 0 0\n";
+            File << "f 2//1 3//2 4//3\n";
+        }
+
+        ~Workspace()
+        {
+            std::filesystem::remove_all(Directory);
+        }
+
+        std::shared_ptr<TriangleMesh> Parse(const BVHCost &Cost)
+        {
+            ObjParser Parser(Model, true);
+            Parser.Parse();
+            std::shared_ptr<TriangleMesh> Mesh;
+            for (auto &Group : Parser.ObjToMesh())
+                Mesh = Group.second;
+            Mesh->Divide(Cost);
+            return Mesh;
+        }
+    };
+}
+
+TEST(MeshCache, LoadsTheDividedMesh)
+{
+    Workspace W;
+    MeshCache Cache(W.Directory / "cache");
+    auto Key = MeshCache::Key(W.Model, true, BVHCost());
+    EXPECT_EQ(Cache.Load(Key), nullptr);
+
+    auto Mesh = W.Parse(BVHCost());
+    ASSERT_TRUE(Cache.Store(Key, *Mesh));
+    auto Loaded = Cache.Load(Key);
+    ASSERT_NE(Loaded, nullptr);
+    EXPECT_EQ(Loaded->TriangleCount(), Mesh->TriangleCount());
+    EXPECT_EQ(Loaded->MemoryUsage(), Mesh->MemoryUsage());
+    EXPECT_EQ(Loaded->GetNodes().size(), Mesh->GetNodes().size());
+    EXPECT_TRUE(Loaded->IsSmooth(Loaded->TriangleCount() - 1));
+
+    for (int k = 0; k < 50; ++k)
+    {
+        Ray R(Point(std::sin(k * 0.7) * 0.8, std::cos(k * 0.3) * 0.8, -1.), Vector(0., 0., 1.));
+        auto XS = Mesh->Intersect(R);
+        auto Again = Loaded->Intersect(R);
+        ASSERT_EQ(XS.size(), Again.size());
+        for (std::size_t i = 0; i < XS.size(); ++i)
+        {
+            EXPECT_EQ(XS[i].GetT(), Again[i].GetT());
+            EXPECT_EQ(XS[i].GetIndex(), Again[i].GetIndex());
+        }
+    }
+}
+
+TEST(MeshCache, KeysFollowTheModelAndTheBuild)
+{
+    Workspace W;
+    auto Key = MeshCache::Key(W.Model, true, BVHCost());
+    EXPECT_EQ(Key, MeshCache::Key(W.Model, true, BVHCost()));
+    EXPECT_NE(Key, MeshCache::Key(W.Model, false, BVHCost()));
+
+    BVHCost Split;
+    Split.SpatialSplits = true;
+    EXPECT_NE(Key, MeshCache::Key(W.Model, true, Split));
+    // the build does not depend on the threads
+    BVHCost Threads;
+    Threads.Threads = 4;
+    EXPECT_EQ(Key, MeshCache::Key(W.Model, true, Threads));
+
+    std::ofstream(W.Model, std::ios::app) << "f 5 6 7\n";
+    EXPECT_NE(Key, MeshCache::Key(W.Model, true, BVHCost()));
+    EXPECT_THROW(MeshCache::Key(W.Directory / "missing.obj", true, BVHCost()), std::invalid_argument);
+}
+
+TEST(MeshCache, DamagedFilesAreIgnored)
+{
+    Workspace W;
+    MeshCache Cache(W.Directory);
+    auto Key = MeshCache::Key(W.Model, true, BVHCost());
+    ASSERT_TRUE(Cache.Store(Key, *W.Parse(BVHCost())));
+    auto Size = std::filesystem::file_size(Cache.PathOf(Key));
+
+    std::filesystem::resize_file(Cache.PathOf(Key), Size - 100);
+    EXPECT_EQ(Cache.Load(Key), nullptr);
+
+    std::filesystem::resize_file(Cache.PathOf(Key), 16);
+    EXPECT_EQ(Cache.Load(Key), nullptr);
+}
@@ -0,0 +1,266 @@
+#include "SIMD.h"
+#include "Matrix.h"
+#include "Ray.h"
+#include "Transformations.h"
+#include "Triangles.h"
+#include "BoundingBoxes.h"
+#include "Util.h"
+#include <vector>
+#include <limits>
+#include <algorithm>
+#include <cmath>
+#include "gtest/gtest.h"
+
+namespace
+{
+    Matrix SampleTransform()
+    {
+        return Transformations::Translation(1., -3., 5.)
+            .Mul(Transformations::RotationY(M_PI / 5))
+            .Mul(Transformations::Shearing(0.5, 0., 0.25, 0., 0., 1.))
+            .Mul(Transformations::Scaling(0.5, 2., 4.));
+    }
+
+    std::vector<SIMD::Level> SupportedLevels()
+    {
+        std::vector<SIMD::Level> Levels {SIMD::Level::Scalar};
+        if (static_cast<int>(SIMD::Detect()) >= static_cast<int>(SIMD::Level::SSE2))
+            Levels.push_back(SIMD::Level::SSE2);
+        if (SIMD::Detect() == SIMD::Level::AVX2)
+            Levels.push_back(SIMD::Level::AVX2);
+        return Levels;
+    }
+}
+
+TEST(SIMD, TransformingAPointMatchesEveryLevel)
+{
+    auto M = SampleTransform();
+    Point P(-3., 4., 5.);
+    auto Saved = SIMD::GetLevel();
+
+    SIMD::SetLevel(SIMD::Level::Scalar);
+    auto Expected = SIMD::TransformPoint(M, P);
+    EXPECT_EQ(Expected, M.Mul(Tuple(P.X(), P.Y(), P.Z(), 1.)));
+
+    for (auto L : SupportedLevels())
+    {
+        SIMD::SetLevel(L);
+        auto Res = SIMD::TransformPoint(M, P);
+        EXPECT_EQ(Expected.X(), Res.X()) << SIMD::LevelName(L);
+        EXPECT_EQ(Expected.Y(), Res.Y()) << SIMD::LevelName(L);
+        EXPECT_EQ(Expected.Z(), Res.Z()) << SIMD::LevelName(L);
+        EXPECT_EQ(1., Res.W()) << SIMD::LevelName(L);
+    }
+    SIMD::SetLevel(Saved);
+}
+
+TEST(SIMD, TransformingAVectorIgnoresTranslation)
+{
+    auto M = SampleTransform();
+    Vector V(0.5, -1., 2.);
+    auto Saved = SIMD::GetLevel();
+
+    SIMD::SetLevel(SIMD::Level::Scalar);
+    auto Expected = SIMD::TransformVector(M, V);
+    EXPECT_EQ(Expected, M.Mul(Tuple(V.X(), V.Y(), V.Z(), 0.)));
+
+    for (auto L : SupportedLevels())
+    {
+        SIMD::SetLevel(L);
+        auto Res = SIMD::TransformVector(M, V);
+        EXPECT_EQ(Expected.X(), Res.X()) << SIMD::LevelName(L);
+        EXPECT_EQ(Expected.Y(), Res.Y()) << SIMD::LevelName(L);
+        EXPECT_EQ(Expected.Z(), Res.Z()) << SIMD::LevelName(L);
+        EXPECT_EQ(0., Res.W()) << SIMD::LevelName(L);
+    }
+    SIMD::SetLevel(Saved);
+}
+
+TEST(SIMD, TransformingABatchOfRays)
+{
+    auto M = SampleTransform();
+    std::vector<Ray> Rays;
+    for (int i = 0; i < 7; ++i)
+    {
+        Rays.push_back(Ray(Point(i, -i * 0.5, 2.), Vector(0.1 * i, 1., -0.3).Normalize()));
+    }
+    auto Saved = SIMD::GetLevel();
+
+    // the scalar kernels are the reference every level must match
+    SIMD::SetLevel(SIMD::Level::Scalar);
+    std::vector<Ray> Expected;
+    for (auto &R : Rays)
+    {
+        Expected.push_back(Ray(SIMD::TransformPoint(M, R.GetOrigin()), SIMD::TransformVector(M, R.GetDirection())));
+        EXPECT_EQ(M.Mul(R.GetOrigin()), Expected.back().GetOrigin());
+    }
+
+    for (auto L : SupportedLevels())
+    {
+        SIMD::SetLevel(L);
+        std::vector<Ray> Out(Rays.size());
+        SIMD::TransformRays(M, Rays.data(), Out.data(), Rays.size());
+        for (size_t i = 0; i < Rays.size(); ++i)
+        {
+            auto Single = SIMD::TransformRay(M, Rays[i]);
+            for (int a = 0; a < 3; ++a)
+            {
+                EXPECT_EQ(Expected[i].GetOrigin()[a], Single.GetOrigin()[a]) << SIMD::LevelName(L);
+                EXPECT_EQ(Expected[i].GetDirection()[a], Single.GetDirection()[a]) << SIMD::LevelName(L);
+                EXPECT_EQ(Expected[i].GetOrigin()[a], Out[i].GetOrigin()[a]) << SIMD::LevelName(L);
+                EXPECT_EQ(Expected[i].GetDirection()[a], Out[i].GetDirection()[a]) << SIMD::LevelName(L);
+            }
+        }
+
+        // transforming in place
+        auto InPlace = Rays;
+        SIMD::TransformRays(M, InPlace.data(), InPlace.data(), InPlace.size());
+        for (size_t i = 0; i < Rays.size(); ++i)
+        {
+            EXPECT_EQ(Out[i].GetOrigin(), InPlace[i].GetOrigin());
+            EXPECT_EQ(Out[i].GetDirection(), InPlace[i].GetDirection());
+        }
+    }
+    SIMD::SetLevel(Saved);
+}
+
+TEST(SIMD, PacketKernelsMatchTheSingleRayTests)
+{
+    std::vector<Ray> Rays;
+    for (int i = 0; i < 13; ++i)
+    {
+        Rays.push_back(Ray(Point(0.15 * i - 0.9, 0.1 * i - 0.2, -5.), Vector(0.02 * (i - 6), -0.01 * i, 1.).Normalize()));
+    }
+    RayPacket P(Rays.data(), Rays.size());
+    PacketSlabs S(P);
+    // lane 1 is left out, lane 3 already has a hit in front of everything
+    LaneMask Active = P.AllLanes() & ~LaneMask(2);
+    Real TMax[RayPacket::MaxSize];
+    std::fill(TMax, TMax + RayPacket::MaxSize, std::numeric_limits<Real>::infinity());
+    TMax[3] = 4.;
+
+    float Min[3] = {-0.5f, -0.25f, -1.f};
+    float Max[3] = {0.5f, 0.5f, 1.f};
+    Triangles Tri(Point(0., 1., 0.), Point(-1., 0., 0.), Point(1., 0., 0.));
+
+    auto Saved = SIMD::GetLevel();
+    SIMD::SetLevel(SIMD::Level::Scalar);
+    Real Enter[RayPacket::MaxSize], T[RayPacket::MaxSize], U[RayPacket::MaxSize], V[RayPacket::MaxSize];
+    auto Boxes = SIMD::EnterBox(P, S, Active, Min, Max, 0., TMax, 0., Enter);
+    auto Hits = SIMD::IntersectTriangle(P, Active, Tri.GetP1().Data(), Tri.GetE1().Data(), Tri.GetE2().Data(), 0.,
+                                        TMax, T, U, V);
+    EXPECT_NE(0, Hits);
+    EXPECT_NE(Active, Hits);
+
+    for (int i = 0; i < P.GetSize(); ++i)
+    {
+        if (!(Active >> i & 1))
+        {
+            EXPECT_FALSE(Boxes >> i & 1);
+            EXPECT_FALSE(Hits >> i & 1);
+            continue;
+        }
+
+        auto Slabs = SlabIntersect(RaySlabs(Rays[i]), Min, Max, 0., TMax[i]);
+        ASSERT_EQ(Slabs.first <= Slabs.second, bool(Boxes >> i & 1)) << i;
+        if (Boxes >> i & 1)
+        {
+            EXPECT_EQ(Slabs.first, Enter[i]);
+        }
+
+        std::vector<Intersection<Object>> XS;
+        Tri.LocalIntersect(Rays[i], XS);
+        bool Expected = !XS.empty() && XS[0].GetT() > 0. && XS[0].GetT() < TMax[i];
+        ASSERT_EQ(Expected, bool(Hits >> i & 1)) << i;
+        if (Expected)
+        {
+            EXPECT_EQ(XS[0].GetT(), T[i]);
+        }
+    }
+
+    for (auto L : SupportedLevels())
+    {
+        SIMD::SetLevel(L);
+        Real LevelEnter[RayPacket::MaxSize], LevelT[RayPacket::MaxSize];
+        Real LevelU[RayPacket::MaxSize], LevelV[RayPacket::MaxSize];
+        EXPECT_EQ(Boxes, SIMD::EnterBox(P, S, Active, Min, Max, 0., TMax, 0., LevelEnter)) << SIMD::LevelName(L);
+        EXPECT_EQ(Hits, SIMD::IntersectTriangle(P, Active, Tri.GetP1().Data(), Tri.GetE1().Data(),
+                                                Tri.GetE2().Data(), 0., TMax, LevelT, LevelU, LevelV))
+            << SIMD::LevelName(L);
+        for (int i = 0; i < P.GetSize(); ++i)
+        {
+            if (Boxes >> i & 1)
+            {
+                EXPECT_EQ(Enter[i], LevelEnter[i]) << SIMD::LevelName(L);
+            }
+            if (Hits >> i & 1)
+            {
+                EXPECT_EQ(T[i], LevelT[i]) << SIMD::LevelName(L);
+                EXPECT_EQ(U[i], LevelU[i]) << SIMD::LevelName(L);
+                EXPECT_EQ(V[i], LevelV[i]) << SIMD::LevelName(L);
+            }
+        }
+    }
+    SIMD::SetLevel(Saved);
+}
+
+TEST(SIMD, BlockKernelMatchesTheSingleTriangleTest)
+{
+    // hit, hit further away, parallel to the ray, behind the origin
+    std::vector<Triangles> Tris {
+        Triangles(Point(0., 1., 0.), Point(-1., 0., 0.), Point(1., 0., 0.)),
+        Triangles(Point(0., 2., 3.), Point(-2., -1., 3.5), Point(2., -1., 2.5)),
+        Triangles(Point(0., 1., 0.), Point(0., 0., 1.), Point(0., -1., 0.)),
+        Triangles(Point(0., 1., -9.), Point(-1., 0., -9.), Point(1., 0., -9.)),
+    };
+    TriangleBlock B;
+    for (int l = 0; l < TriangleBlock::Width; ++l)
+    {
+        for (int a = 0; a < 3; ++a)
+        {
+            B.P1[a][l] = Tris[l].GetP1()[a];
+            B.E1[a][l] = Tris[l].GetE1()[a];
+            B.E2[a][l] = Tris[l].GetE2()[a];
+        }
+    }
+    Ray R(Point(0.1, 0.3, -5.), Vector(0.01, -0.02, 1.).Normalize());
+
+    auto Saved = SIMD::GetLevel();
+    SIMD::SetLevel(SIMD::Level::Scalar);
+    Real T[TriangleBlock::Width], U[TriangleBlock::Width], V[TriangleBlock::Width];
+    auto Hits = SIMD::IntersectTriangles(R, B, TriangleBlock::Width, 0., Util::Inf, T, U, V);
+    EXPECT_EQ(3, Hits);
+    for (int l = 0; l < TriangleBlock::Width; ++l)
+    {
+        std::vector<Intersection<Object>> XS;
+        Tris[l].LocalIntersect(R, XS);
+        bool Expected = !XS.empty() && XS[0].GetT() > 0.;
+        ASSERT_EQ(Expected, bool(Hits >> l & 1)) << l;
+        if (Expected)
+        {
+            EXPECT_EQ(XS[0].GetT(), T[l]);
+        }
+    }
+
+    for (auto L : SupportedLevels())
+    {
+        SIMD::SetLevel(L);
+        Real LevelT[TriangleBlock::Width], LevelU[TriangleBlock::Width], LevelV[TriangleBlock::Width];
+        EXPECT_EQ(Hits, SIMD::IntersectTriangles(R, B, TriangleBlock::Width, 0., Util::Inf, LevelT, LevelU, LevelV))
+            << SIMD::LevelName(L);
+        for (int l = 0; l < TriangleBlock::Width; ++l)
+        {
+            if (Hits >> l & 1)
+            {
+                EXPECT_EQ(T[l], LevelT[l]) << SIMD::LevelName(L);
+                EXPECT_EQ(U[l], LevelU[l]) << SIMD::LevelName(L);
+                EXPECT_EQ(V[l], LevelV[l]) << SIMD::LevelName(L);
+            }
+        }
+
+        // lanes past Count and hits past TMax are left out
+        EXPECT_EQ(1, SIMD::IntersectTriangles(R, B, 1, 0., Util::Inf, LevelT, LevelU, LevelV)) << SIMD::LevelName(L);
+        EXPECT_EQ(1, SIMD::IntersectTriangles(R, B, 4, 0., 6., LevelT, LevelU, LevelV)) << SIMD::LevelName(L);
+    }
+    SIMD::SetLevel(Saved);
+}
@@ -0,0 +1,98 @@
+#include "threadpool.h"
+#include <atomic>
+#include <numeric>
+#include <stdexcept>
+#include <vector>
+#include "gtest/gtest.h"
+
+namespace
+{
+    // sum of [Begin, End) computed by splitting the range in nested tasks,
+    // as the hierarchy builders do
+    long long SumBelow(ThreadPool &Pool, long long Begin, long long End)
+    {
+        if (End - Begin <= 64)
+        {
+            long long Sum = 0;
+            for (auto i = Begin; i < End; ++i)
+                Sum += i;
+            return Sum;
+        }
+
+        auto Mid = Begin + (End - Begin) / 2;
+        long long Left = 0;
+        ThreadPool::TaskGroup Group{Pool};
+        Group.run([&]() { Left = SumBelow(Pool, Begin, Mid); });
+        auto Right = SumBelow(Pool, Mid, End);
+        Group.wait();
+        return Left + Right;
+    }
+}
+
+TEST(ThreadPool, ParallelForVisitsEveryIndexOnce)
+{
+    ThreadPool Pool{4};
+    std::vector<std::atomic<int>> Visits(100000);
+    for (int Round = 0; Round < 20; ++Round)
+    {
+        Pool.parallelFor(0, Visits.size(), 7 + Round, [&](std::size_t i) { ++Visits[i]; });
+    }
+    for (auto &V : Visits)
+        ASSERT_EQ(V.load(), 20);
+
+    // at most one thread: the caller does it all
+    int Serial = 0;
+    Pool.parallelFor(0, 1000, 1, [&](std::size_t) { ++Serial; }, 1);
+    EXPECT_EQ(Serial, 1000);
+}
+
+TEST(ThreadPool, NestedGroupsDoNotBlockTheWorkers)
+{
+    // far more nested waits than workers
+    ThreadPool Pool{2};
+    for (int Round = 0; Round < 10; ++Round)
+    {
+        EXPECT_EQ(SumBelow(Pool, 0, 200000), 200000LL * 199999 / 2);
+    }
+
+    // and from tasks that are themselves enqueued
+    std::atomic<long long> Total{0};
+    {
+        ThreadPool::TaskGroup Group{Pool};
+        for (int i = 0; i < 8; ++i)
+            Group.run([&]() { Total += SumBelow(Pool, 0, 50000); });
+        Group.wait();
+    }
+    EXPECT_EQ(Total.load(), 8 * (50000LL * 49999 / 2));
+}
+
+TEST(ThreadPool, GroupsRethrowTheFirstException)
+{
+    ThreadPool Pool{3};
+    ThreadPool::TaskGroup Group{Pool};
+    std::atomic<int> Done{0};
+    for (int i = 0; i < 100; ++i)
+    {
+        Group.run([&, i]() {
+            if (i == 50)
+                throw std::invalid_argument("task 50");
+            ++Done;
+        });
+    }
+    EXPECT_THROW(Group.wait(), std::invalid_argument);
+    EXPECT_EQ(Done.load(), 99);
+
+    // large callables go to the heap
+    std::vector<long long> Big(16, 1);
+    long long Sum = 0;
+    auto Add = [Big, &Sum]() { Sum = std::accumulate(Big.begin(), Big.end(), 0LL); };
+    struct Padded
+    {
+        decltype(Add) Fn;
+        char Padding[PoolTask::inlineSize];
+        void operator()() { Fn(); }
+    };
+    Group.run(Padded{Add, {}});
+    Group.wait();
+    EXPECT_EQ(Sum, 16);
+}
@@ -0,0 +1,159 @@
+#include "TriangleMesh.h"
+#include "Triangles.h"
+#include "Groups.h"
+#include "Util.h"
+#include <cmath>
+#include <stdexcept>
+#include "gtest/gtest.h"
+
+namespace
+{
+    // a bumpy sheet of Size x Size quads, the upper triangle of every quad
+    // flat and the lower one smooth, built both as a mesh and as a group
+    const int Size = 24;
+
+    Real Height(int i, int j)
+    {
+        return 0.3 * std::sin(i * 0.7) * std::cos(j * 0.4);
+    }
+
+    void MakeSheet(TriangleMesh &Mesh, Groups &G)
+    {
+        std::vector<Point> Points;
+        std::vector<Vector> Normals;
+        for (int j = 0; j <= Size; ++j)
+        {
+            for (int i = 0; i <= Size; ++i)
+            {
+                Points.push_back(Point(i * 0.1 - 1.2, Height(i, j), j * 0.1 - 1.2));
+                Normals.push_back(Vector(std::sin(i * 0.3), 1., std::cos(j * 0.5)).Normalize());
+                Mesh.AddVertex(Points.back());
+                Mesh.AddNormal(Normals.back());
+            }
+        }
+
+        for (int j = 0; j < Size; ++j)
+        {
+            for (int i = 0; i < Size; ++i)
+            {
+                uint32_t A = j * (Size + 1) + i, B = A + 1, C = A + Size + 1, D = C + 1;
+                Mesh.AddTriangle(A, B, C);
+                Mesh.AddTriangle(B, D, C, B, D, C);
+
+                std::shared_ptr<Object> Flat = std::make_shared<Triangles>(Triangles(Points[A], Points[B], Points[C]));
+                std::shared_ptr<Object> Smooth = std::make_shared<SmoothTriangles>(
+                    SmoothTriangles(Points[B], Points[D], Points[C], Normals[B], Normals[D], Normals[C]));
+                G.AddChild(Flat);
+                G.AddChild(Smooth);
+            }
+        }
+    }
+
+    // long thin triangles across the sheet, in every direction
+    void MakeSlivers(TriangleMesh &Mesh, Groups &G)
+    {
+        for (int k = 0; k < 200; ++k)
+        {
+            Point A(std::sin(k * 0.31) * 1.2, 0.01 * k - 1., std::cos(k * 0.31) * 1.2);
+            Point B(-A.X(), A.Y() + 0.05, -A.Z());
+            Point C(A.X() + 0.02, A.Y() + 0.03, A.Z() - 0.02);
+            Mesh.AddTriangle(Mesh.AddVertex(A), Mesh.AddVertex(B), Mesh.AddVertex(C));
+            std::shared_ptr<Object> Sliver = std::make_shared<Triangles>(Triangles(A, B, C));
+            G.AddChild(Sliver);
+        }
+    }
+
+    void ExpectSameHits(const std::shared_ptr<TriangleMesh> &Mesh, const std::shared_ptr<Groups> &G)
+    {
+        for (int k = 0; k < 200; ++k)
+        {
+            Ray R(Point(std::sin(k * 1.3), 2., std::cos(k * 0.9)),
+                  Vector(std::sin(k * 0.37) * 0.4, -1., std::cos(k * 0.53) * 0.4).Normalize());
+
+            Real TMesh = Util::Inf, TGroup = Util::Inf;
+            Intersection<Object> MeshHit, GroupHit;
+            bool HitMesh = Mesh->ClosestHit(R, 0., TMesh, MeshHit);
+            ASSERT_EQ(HitMesh, G->ClosestHit(R, 0., TGroup, GroupHit));
+            EXPECT_EQ(Mesh->Intersect(R).size(), G->Intersect(R).size());
+            EXPECT_EQ(HitMesh, Mesh->AnyHit(R, 0., Util::Inf));
+            if (!HitMesh)
+                continue;
+
+            EXPECT_EQ(MeshHit.GetObject(), Mesh.get());
+            EXPECT_EQ(TMesh, TGroup);
+            auto P = R.Position(TMesh);
+            EXPECT_EQ(Mesh->NormalAt(P, MeshHit), GroupHit.GetObject()->NormalAt(P, GroupHit));
+        }
+    }
+}
+
+TEST(TriangleMesh, HitsMatchTriangleObjects)
+{
+    auto Mesh = std::make_shared<TriangleMesh>();
+    auto G = std::make_shared<Groups>();
+    MakeSheet(*Mesh, *G);
+    G->Divide(BVHCost());
+    Mesh->Divide(BVHCost());
+    G->Commit();
+    Mesh->Commit();
+    EXPECT_EQ(Mesh->TriangleCount(), 2 * Size * Size);
+    EXPECT_FALSE(Mesh->GetNodes().empty());
+    ExpectSameHits(Mesh, G);
+}
+
+TEST(TriangleMesh, SpatialSplitsKeepTheHits)
+{
+    auto Mesh = std::make_shared<TriangleMesh>();
+    auto G = std::make_shared<Groups>();
+    MakeSheet(*Mesh, *G);
+    MakeSlivers(*Mesh, *G);
+    G->Divide(BVHCost());
+    BVHCost Cost;
+    Cost.SpatialSplits = true;
+    Mesh->Divide(Cost);
+    auto Bytes = Mesh->MemoryUsage();
+    G->Commit();
+    Mesh->Commit();
+    ExpectSameHits(Mesh, G);
+
+    // slivers get split, within the budget of duplicates
+    auto Object = std::make_shared<TriangleMesh>(*Mesh);
+    Object->Divide(BVHCost());
+    EXPECT_GT(Bytes, Object->MemoryUsage());
+}
+
+TEST(TriangleMesh, TrianglesStayCompact)
+{
+    TriangleMesh Mesh;
+    Groups G;
+    MakeSheet(Mesh, G);
+    Mesh.Divide(BVHCost());
+
+    // a few tens of bytes, plus the packed copy in the leaf blocks
+    EXPECT_LT(Mesh.MemoryUsage() / Mesh.TriangleCount(), 200u);
+}
+
+TEST(TriangleMesh, EditingDropsTheHierarchy)
+{
+    TriangleMesh Mesh;
+    auto A = Mesh.AddVertex(Point(0., 1., 0.));
+    auto B = Mesh.AddVertex(Point(-1., 0., 0.));
+    auto C = Mesh.AddVertex(Point(1., 0., 0.));
+    EXPECT_THROW(Mesh.AddTriangle(A, B, 3), std::invalid_argument);
+    EXPECT_THROW(Mesh.AddTriangle(A, B, C, 0, 0, 0), std::invalid_argument);
+
+    Mesh.AddTriangle(A, B, C);
+    Mesh.Commit();
+    EXPECT_FALSE(Mesh.GetNodes().empty());
+    EXPECT_EQ(Mesh.BoundsOf().Max, Point(1., 1., 0.));
+
+    auto D = Mesh.AddVertex(Point(0., -3., 0.));
+    Mesh.AddTriangle(A, B, D);
+    EXPECT_TRUE(Mesh.GetNodes().empty());
+    EXPECT_EQ(Mesh.BoundsOf().Min, Point(-1., -3., 0.));
+
+    // without a hierarchy the triangles are tested one by one
+    auto XS = Mesh.Intersect(Ray(Point(-0.2, 0.5, -2.), Vector(0., 0., 1.)));
+    ASSERT_EQ(XS.size(), 2u);
+    EXPECT_TRUE(Util::Equal(XS[0].GetT(), 2.));
+}
@@ -0,0 +1,265 @@
+#include "World.h"
+#include "Camera.h"
+#include "Sphere.h"
+#include "Groups.h"
+#include "Plane.h"
+#include "Transformations.h"
+#include "Intersection.h"
+#include "Functions.h"
+#include "Util.h"
+#include <cmath>
+#include <limits>
+#include "gtest/gtest.h"
+
+TEST(World, ClosestHitMatchesTheSortedList)
+{
+    auto W = World::DefaultWorld();
+    Ray R(Point(0., 0., -5.), Vector(0., 0., 1.));
+
+    auto XS = W.Intersect(R);
+    ASSERT_EQ(4, XS.size());
+
+    Intersection<Object> H;
+    ASSERT_TRUE(W.ClosestHit(R, 0., std::numeric_limits<Real>::infinity(), H));
+    EXPECT_EQ(XS[0], H);
+    EXPECT_EQ(4., H.GetT());
+
+    // a range starting past the outer sphere's first hit finds the inner one
+    ASSERT_TRUE(W.ClosestHit(R, 4.2, std::numeric_limits<Real>::infinity(), H));
+    EXPECT_EQ(4.5, H.GetT());
+
+    EXPECT_FALSE(W.ClosestHit(R, 0., 3.9, H));
+}
+
+TEST(World, ClosestHitInsideNestedGroups)
+{
+    World W;
+    auto G = std::make_shared<Groups>(Groups());
+    std::shared_ptr<Object> Near = std::make_shared<Sphere>(Sphere());
+    Near->SetTransform(Transformations::Translation(0., 0., -3.));
+    std::shared_ptr<Object> Far = std::make_shared<Sphere>(Sphere());
+    G->AddChild(Far);
+    G->AddChild(Near);
+    std::shared_ptr<Object> GObj = G;
+    W.AddObject(GObj);
+
+    Ray R(Point(0., 0., -10.), Vector(0., 0., 1.));
+    Intersection<Object> H;
+    ASSERT_TRUE(W.ClosestHit(R, 0., std::numeric_limits<Real>::infinity(), H));
+    EXPECT_EQ(Near.get(), H.GetObject());
+    EXPECT_EQ(6., H.GetT());
+}
+
+TEST(World, AnyHitSkipsObjectsWithoutShadows)
+{
+    auto W = World::DefaultWorld();
+    Ray R(Point(0., 0., -5.), Vector(0., 0., 1.));
+
+    EXPECT_TRUE(W.AnyHit(R, 0., 10.));
+    EXPECT_FALSE(W.AnyHit(R, 0., 3.9));
+    EXPECT_FALSE(W.AnyHit(R, 6.1, 10.));
+
+    W.GetObjectAt(0)->SetShadowOn(false);
+    W.GetObjectAt(1)->SetShadowOn(false);
+    EXPECT_FALSE(W.AnyHit(R, 0., 10.));
+}
+
+TEST(World, RefractiveIndicesAtVariousIntersections)
+{
+    auto MakeGlass = [](const Matrix &M, Real RefractiveIndex) {
+        auto S = std::make_shared<Sphere>(Sphere::GlassSphere());
+        S->SetTransform(M);
+        auto Mat = S->GetMaterial();
+        Mat.SetRefractiveIndex(RefractiveIndex);
+        S->SetMaterial(Mat);
+        return S;
+    };
+    auto A = MakeGlass(Transformations::Scaling(2., 2., 2.), 1.5);
+    auto B = MakeGlass(Transformations::Translation(0., 0., -0.25), 2.);
+    auto C = MakeGlass(Transformations::Translation(0., 0., 0.25), 2.5);
+
+    Ray R(Point(0., 0., -4.), Vector(0., 0., 1.));
+    std::vector<Intersection<Object>> XS {
+        Intersection<Object>(2., A.get()), Intersection<Object>(2.75, B.get()),
+        Intersection<Object>(3.25, C.get()), Intersection<Object>(4.75, B.get()),
+        Intersection<Object>(5.25, C.get()), Intersection<Object>(6., A.get())};
+    std::vector<std::pair<Real, Real>> Expected {{1., 1.5}, {1.5, 2.}, {2., 2.5}, {2.5, 2.5}, {2.5, 1.5}, {1.5, 1.}};
+
+    for (size_t i = 0; i < XS.size(); ++i)
+    {
+        auto Comps = TRay::PrepareComputations(XS[i], R, XS);
+        EXPECT_DOUBLE_EQ(Expected[i].first, Comps.N1) << i;
+        EXPECT_DOUBLE_EQ(Expected[i].second, Comps.N2) << i;
+    }
+
+    // opaque hits skip the bookkeeping
+    Sphere Opaque;
+    Intersection<Object> I(4., &Opaque);
+    auto Comps = TRay::PrepareComputations(I, R, XS);
+    EXPECT_EQ(1., Comps.N1);
+    EXPECT_EQ(1., Comps.N2);
+}
+
+TEST(World, TopLevelHierarchyKeepsTheHits)
+{
+    // a crowd of spheres above a floor
+    World W;
+    for (int i = 0; i < 60; ++i)
+    {
+        std::shared_ptr<Object> S = std::make_shared<Sphere>(Sphere());
+        S->SetTransform(Transformations::Translation(std::sin(i * 1.7) * 8., 1. + (i % 3), std::cos(i * 0.9) * 8.) *
+                        Transformations::Scaling(0.5, 0.5, 0.5));
+        W.AddObject(S);
+    }
+    std::shared_ptr<Object> Floor = std::make_shared<Plane>(Plane());
+    W.AddObject(Floor);
+
+    // a copy made before Commit tests the objects one by one
+    auto Linear = W;
+    W.Commit();
+    EXPECT_TRUE(Linear.GetBVH().Empty());
+    EXPECT_EQ(W.GetBVH().PrimitiveCount(), 60u);
+
+    for (int k = 0; k < 200; ++k)
+    {
+        Ray R(Point(std::sin(k * 0.3) * 12., 2., std::cos(k * 0.7) * 12.),
+              Vector(-std::sin(k * 0.3), std::sin(k * 0.11) * 0.3, -std::cos(k * 0.7)).Normalize());
+        auto Inf = std::numeric_limits<Real>::infinity();
+        Intersection<Object> H, LinearH;
+        bool Hit = W.ClosestHit(R, 0., Inf, H);
+        ASSERT_EQ(Hit, Linear.ClosestHit(R, 0., Inf, LinearH));
+        EXPECT_EQ(W.AnyHit(R, 0., 5.), Linear.AnyHit(R, 0., 5.));
+        EXPECT_EQ(W.Intersect(R).size(), Linear.Intersect(R).size());
+        if (!Hit)
+            continue;
+
+        EXPECT_EQ(H.GetObject(), LinearH.GetObject());
+        EXPECT_EQ(H.GetT(), LinearH.GetT());
+    }
+
+    // an object added after Commit is not missed
+    W.AddObject(Floor);
+    EXPECT_TRUE(W.GetBVH().Empty());
+}
+
+TEST(World, MovingATopLevelObjectRefitsTheHierarchy)
+{
+    // a row of spheres, the last ones in a group without a transform; rays
+    // along x = 4.5 pass between them
+    World W;
+    std::vector<std::shared_ptr<Object>> Spheres;
+    auto G = std::make_shared<Groups>(Groups());
+    for (int i = 0; i < 20; ++i)
+    {
+        std::shared_ptr<Object> S = std::make_shared<Sphere>(Sphere());
+        S->SetTransform(Transformations::Translation(3. * i, 0., 0.));
+        Spheres.push_back(S);
+        if (i < 15)
+            W.AddObject(S);
+        else
+            G->AddChild(S);
+    }
+    std::shared_ptr<Object> Group = G;
+    W.AddObject(Group);
+    std::shared_ptr<Object> Floor = std::make_shared<Plane>(Plane());
+    Floor->SetTransform(Transformations::Translation(0., -1., 0.));
+    W.AddObject(Floor);
+    W.Commit();
+    auto Nodes = W.GetBVH().NodeCount();
+    ASSERT_LT(0u, Nodes);
+
+    auto Inf = std::numeric_limits<Real>::infinity();
+    Intersection<Object> Hit;
+    Ray Down(Point(4.5, 10., 30.), Vector(0., -1., 0.));
+
+    // no new commit, the world hierarchy follows the sphere
+    Spheres[5]->SetTransform(Transformations::Translation(4.5, 0., 30.));
+    EXPECT_EQ(Nodes, W.GetBVH().NodeCount());
+    ASSERT_TRUE(W.ClosestHit(Down, 0., Inf, Hit));
+    EXPECT_EQ(Spheres[5].get(), Hit.GetObject());
+    EXPECT_EQ(2u, W.Intersect(Ray(Point(4.5, 0., 20.), Vector(0., 0., 1.))).size());
+
+    // and a sphere of the group, through the group
+    Spheres[17]->SetTransform(Transformations::Translation(4.5, 5., 30.));
+    EXPECT_EQ(Nodes, W.GetBVH().NodeCount());
+    ASSERT_TRUE(W.ClosestHit(Down, 0., Inf, Hit));
+    EXPECT_EQ(Spheres[17].get(), Hit.GetObject());
+    EXPECT_TRUE(W.AnyHit(Ray(Point(4.5, 5., 20.), Vector(0., 0., 1.)), 0., Inf));
+
+    // moving the floor needs no refit
+    Floor->SetTransform(Transformations::Translation(0., -2., 0.));
+    EXPECT_EQ(Nodes, W.GetBVH().NodeCount());
+}
+
+TEST(World, MovedFromWorldStaysUsable)
+{
+    auto W = World::DefaultWorld();
+    W.Commit();
+    World Moved(std::move(W));
+    EXPECT_FALSE(Moved.GetBVH().Empty());
+    EXPECT_EQ(2u, Moved.GetObjects().size());
+
+    // the source is empty, and can be filled and committed again
+    EXPECT_TRUE(W.GetBVH().Empty());
+    std::shared_ptr<Object> S = std::make_shared<Sphere>(Sphere());
+    W.AddObject(S);
+    W.Commit();
+    EXPECT_EQ(1u, W.GetBVH().PrimitiveCount());
+
+    Moved = std::move(W);
+    EXPECT_EQ(1u, Moved.GetBVH().PrimitiveCount());
+    EXPECT_TRUE(W.GetBVH().Empty());
+    EXPECT_EQ(2u, Moved.Intersect(Ray(Point(0., 0., -5.), Vector(0., 0., 1.))).size());
+}
+
+TEST(World, FlattenedSpheresKeepTheirHitsAndLight)
+{
+    // the floor and walls of scenes/three-spheres.yml, spheres squashed to a
+    // hundredth of their width: the rays are stretched as much in their space
+    World W;
+    W.SetLight(Light(Color(1., 1., 1.), Point(-10., 10., -10.)));
+    auto Flat = Matrix::Identity(4).Scale(10., 0.01, 10.);
+    std::shared_ptr<Object> Floor = std::make_shared<Sphere>(Sphere());
+    Floor->SetTransform(Flat);
+    std::shared_ptr<Object> LeftWall = std::make_shared<Sphere>(Sphere());
+    LeftWall->SetTransform(Flat.RotateX(1.571).RotateY(-0.7855).Translate(0., 0., 5.));
+    std::shared_ptr<Object> RightWall = std::make_shared<Sphere>(Sphere());
+    RightWall->SetTransform(Flat.RotateX(1.571).RotateY(0.7855).Translate(0., 0., 5.));
+    W.AddObject(Floor);
+    W.AddObject(LeftWall);
+    W.AddObject(RightWall);
+    W.Commit();
+
+    Camera C(160, 80, 1.0473);
+    C.SetTransform(Transformations::ViewTransform(Point(0.1, 1.5, -5.), Point(0., 1., 0.), Vector(0., 1., 0.)));
+    for (int Y = 0; Y < 80; ++Y)
+    {
+        for (int X = 0; X < 160; ++X)
+        {
+            auto R = C.RayForPixel(X, Y);
+            Intersection<Object> Hit;
+            if (!W.ClosestHit(R, 0., Util::Inf, Hit))
+                continue;
+
+            // the hits on the floor, solved in double whatever Real is
+            if (Hit.GetObject() == Floor.get())
+            {
+                double O[3] = {R.GetOrigin().X(), R.GetOrigin().Y() / 0.01, R.GetOrigin().Z()};
+                double D[3] = {R.GetDirection().X(), R.GetDirection().Y() / 0.01, R.GetDirection().Z()};
+                O[0] /= 10.;
+                O[2] /= 10.;
+                D[0] /= 10.;
+                D[2] /= 10.;
+                double A = D[0] * D[0] + D[1] * D[1] + D[2] * D[2];
+                double HalfB = D[0] * O[0] + D[1] * O[1] + D[2] * O[2];
+                double C = O[0] * O[0] + O[1] * O[1] + O[2] * O[2] - 1.;
+                double Expected = (-HalfB - std::sqrt(HalfB * HalfB - A * C)) / A;
+                EXPECT_NEAR(Expected, Hit.GetT(), 1e-5 * Expected) << X << ", " << Y;
+            }
+
+            // nothing stands between the light and the floor or the walls
+            auto Comps = TRay::PrepareComputations(Hit, R);
+            EXPECT_FALSE(W.IsShadowed(Comps.OverPosition)) << X << ", " << Y;
+        }
+    }
+}
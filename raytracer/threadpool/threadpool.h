@@ -1,80 +1,501 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
 #include <condition_variable>
-#include <functional>
-#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <new>
 #include <thread>
-#include <iostream>
-#include <queue>
-#include <chrono>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// a callable run once by the pool; stored in place when it fits in
+// inlineSize bytes (the lambdas of the renderer and the builders capture a
+// few references), on the heap otherwise
+class PoolTask
+{
+public:
+    static const std::size_t inlineSize = 64;
+
+    PoolTask() = default;
+
+    template <class Fn, class = std::enable_if_t<!std::is_same<std::decay_t<Fn>, PoolTask>::value>>
+    PoolTask(Fn &&fn)
+    {
+        using Stored = std::decay_t<Fn>;
+        if constexpr (sizeof(Stored) <= inlineSize && alignof(Stored) <= alignof(std::max_align_t))
+        {
+            new (mStorage) Stored(std::forward<Fn>(fn));
+            mCall = [](void *p) { (*static_cast<Stored *>(p))(); };
+            mManage = [](void *src, void *dst) {
+                auto from = static_cast<Stored *>(src);
+                if (dst)
+                    new (dst) Stored(std::move(*from));
+                from->~Stored();
+            };
+        }
+        else
+        {
+            new (mStorage) Stored *(new Stored(std::forward<Fn>(fn)));
+            mCall = [](void *p) { (**static_cast<Stored **>(p))(); };
+            mManage = [](void *src, void *dst) {
+                auto from = static_cast<Stored **>(src);
+                if (dst)
+                    new (dst) Stored *(*from);
+                else
+                    delete *from;
+            };
+        }
+    }
+
+    PoolTask(PoolTask &&other) noexcept
+    {
+        *this = std::move(other);
+    }
 
+    PoolTask &operator=(PoolTask &&other) noexcept
+    {
+        if (this != &other)
+        {
+            reset();
+            if (other.mCall)
+            {
+                other.mManage(other.mStorage, mStorage);
+                mCall = other.mCall;
+                mManage = other.mManage;
+                other.mCall = nullptr;
+                other.mManage = nullptr;
+            }
+        }
+        return *this;
+    }
+
+    PoolTask(const PoolTask &) = delete;
+    PoolTask &operator=(const PoolTask &) = delete;
+
+    ~PoolTask()
+    {
+        reset();
+    }
+
+    explicit operator bool() const { return mCall != nullptr; }
+
+    void operator()()
+    {
+        mCall(mStorage);
+    }
+
+    void reset()
+    {
+        if (mCall)
+            mManage(mStorage, nullptr);
+        mCall = nullptr;
+        mManage = nullptr;
+    }
+
+private:
+    alignas(std::max_align_t) unsigned char mStorage[inlineSize];
+    void (*mCall)(void *) = nullptr;
+    // move the callable at src to dst (raw storage) and destroy it at src;
+    // only destroy it when dst is null
+    void (*mManage)(void *src, void *dst) = nullptr;
+};
+
+// pool of workers with one deque of tasks each: a worker pushes and pops
+// the tasks it spawns at the bottom of its own deque (most recent first,
+// still hot in its cache) and, once it runs dry, steals the oldest task at
+// the top of another one. The deques are lock-free (Chase-Lev); only the
+// tasks enqueued from outside the pool go through a locked queue.
+// ThreadPool::shared() is the pool used by the renderer, the hierarchy
+// builders and the obj parser.
 class ThreadPool
 {
+    class TaskGroupBase;
+
+    struct Node
+    {
+        PoolTask task;
+        // the group the task belongs to, if any
+        TaskGroupBase *group = nullptr;
+    };
+
+    // Chase-Lev work-stealing deque of a fixed capacity; the owner pushes and
+    // pops at the bottom, the other threads steal at the top
+    class WorkDeque
+    {
+        static const std::int64_t capacity = 4096;
+
+        std::atomic<std::int64_t> mTop{0};
+        std::atomic<std::int64_t> mBottom{0};
+        std::atomic<Node *> mSlots[capacity];
+
+    public:
+        // false when full
+        bool push(Node *node)
+        {
+            auto b = mBottom.load(std::memory_order_relaxed);
+            auto t = mTop.load(std::memory_order_acquire);
+            if (b - t >= capacity)
+                return false;
+            mSlots[b & (capacity - 1)].store(node, std::memory_order_relaxed);
+            // publishes the slot (and the node) to the thieves
+            mBottom.store(b + 1, std::memory_order_release);
+            return true;
+        }
+
+        Node *pop()
+        {
+            auto b = mBottom.load(std::memory_order_relaxed) - 1;
+            // seq_cst: the thieves must see the smaller bottom before we read
+            // the top, or both could take the last task
+            mBottom.store(b, std::memory_order_seq_cst);
+            auto t = mTop.load(std::memory_order_seq_cst);
+            if (t > b)
+            {
+                mBottom.store(b + 1, std::memory_order_relaxed);
+                return nullptr;
+            }
+
+            auto node = mSlots[b & (capacity - 1)].load(std::memory_order_relaxed);
+            if (t == b)
+            {
+                // the last task, a thief may be taking it too
+                if (!mTop.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                    node = nullptr;
+                mBottom.store(b + 1, std::memory_order_relaxed);
+            }
+            return node;
+        }
+
+        Node *steal()
+        {
+            auto t = mTop.load(std::memory_order_seq_cst);
+            auto b = mBottom.load(std::memory_order_seq_cst);
+            if (t >= b)
+                return nullptr;
+
+            auto node = mSlots[t & (capacity - 1)].load(std::memory_order_relaxed);
+            if (!mTop.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                return nullptr;
+            return node;
+        }
+    };
+
+    // completion count and first exception of the tasks of a TaskGroup
+    class TaskGroupBase
+    {
+        friend class ThreadPool;
+
+    protected:
+        std::atomic<std::size_t> mPending{0};
+        std::mutex mErrorMutex;
+        std::exception_ptr mError;
+
+        void finished(std::exception_ptr error)
+        {
+            if (error)
+            {
+                std::lock_guard<std::mutex> lock{mErrorMutex};
+                if (!mError)
+                    mError = error;
+            }
+            // the last access to the group, its owner may return from wait()
+            mPending.fetch_sub(1, std::memory_order_release);
+        }
+    };
+
 public:
-    using Task = std::function<void()>;
+    using Task = PoolTask;
+
+    // tasks run on a pool that can be waited for together. wait() runs tasks
+    // of the pool while the group is not done, so it can be called from a
+    // task (e.g. to build both halves of a hierarchy) without blocking a worker
+    class TaskGroup : private TaskGroupBase
+    {
+        ThreadPool &mPool;
+
+    public:
+        explicit TaskGroup(ThreadPool &pool) : mPool(pool) {}
+
+        TaskGroup(const TaskGroup &) = delete;
+        TaskGroup &operator=(const TaskGroup &) = delete;
+
+        ~TaskGroup()
+        {
+            help();
+        }
+
+        template <class Fn>
+        void run(Fn &&fn)
+        {
+            mPending.fetch_add(1, std::memory_order_relaxed);
+            mPool.push(PoolTask(std::forward<Fn>(fn)), this);
+        }
+
+        // returns once every task run so far is done, rethrowing the first
+        // exception one of them threw
+        void wait()
+        {
+            help();
+            std::exception_ptr error;
+            std::swap(error, mError);
+            if (error)
+                std::rethrow_exception(error);
+        }
+
+    private:
+        void help()
+        {
+            while (mPending.load(std::memory_order_acquire) > 0)
+            {
+                if (auto node = mPool.take())
+                    mPool.execute(node);
+                else
+                    std::this_thread::yield();
+            }
+        }
+    };
 
     explicit ThreadPool(std::size_t numberOfThreads)
     {
-        numThreads = numberOfThreads;
+        numThreads = std::max<std::size_t>(numberOfThreads, 1);
         start();
     }
 
+    // the tasks still queued are run before the workers stop
     ~ThreadPool()
     {
         stop();
     }
 
-    void enqueue(Task task)
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    // one worker per hardware thread, created on first use
+    static ThreadPool &shared()
     {
-        {
-            std::unique_lock<std::mutex> lock{mEventMutex};
-            mTasks.emplace(std::move(task));
-        }
+        static ThreadPool pool{std::thread::hardware_concurrency()};
+        return pool;
+    }
+
+    std::size_t size() const { return numThreads; }
 
-        mEventVar.notify_one();
+    template <class Fn>
+    void enqueue(Fn &&fn)
+    {
+        push(PoolTask(std::forward<Fn>(fn)), nullptr);
     }
 
-    void setTasks(std::queue<Task> newTasks)
+    // call body(i) for every i in [begin, end) and return when all are done.
+    // The indices are claimed grain at a time from a shared counter by at
+    // most maxThreads threads (0: all the workers), the caller being one of
+    // them, so uneven iterations still spread over the threads
+    template <class Fn>
+    void parallelFor(std::size_t begin, std::size_t end, std::size_t grain, Fn body, std::size_t maxThreads = 0)
     {
-        mTasks = newTasks;
+        if (begin >= end)
+            return;
+
+        grain = std::max<std::size_t>(grain, 1);
+        auto pieces = (end - begin + grain - 1) / grain;
+        auto threads = std::min({maxThreads ? maxThreads : numThreads + 1, numThreads + 1, pieces});
+
+        std::atomic<std::size_t> next{begin};
+        auto work = [&]() {
+            for (auto first = next.fetch_add(grain); first < end; first = next.fetch_add(grain))
+            {
+                for (auto i = first; i < std::min(first + grain, end); ++i)
+                    body(i);
+            }
+        };
+
+        TaskGroup group{*this};
+        for (std::size_t t = 1; t < threads; ++t)
+            group.run(work);
+        work();
+        group.wait();
     }
 
     void start()
     {
+        for (auto i = 0u; i < numThreads; ++i)
+            mDeques.emplace_back(new WorkDeque());
+
         for (auto i = 0u; i < numThreads; ++i)
         {
             mThreads.emplace_back([=] {
+                current() = {this, i};
                 while (true)
                 {
-                    Task task;
+                    if (auto node = take())
                     {
-                        std::unique_lock<std::mutex> lock{mEventMutex};
-                        // the predicate below (the lambda function) is the predicate of the condition_variable
-                        // it will keep waiting until the bool expression (predicate) is satisfied
-                        // here it means the thread will wake up when either: mStopping is true, or there's a task needs to be done
-                        mEventVar.wait(lock, [=] { return mStopping || !mTasks.empty(); });
-
-                        // if stopping or there's no task, this thread (worker) will be done
-                        if (mStopping && mTasks.empty())
-                            break;
-
-                        task = std::move(mTasks.front());
-                        mTasks.pop();
+                        execute(node);
+                        continue;
                     }
 
-                    task();
+                    // nothing to run or to steal: sleep until a task is pushed
+                    std::unique_lock<std::mutex> lock{mEventMutex};
+                    ++mSleepers;
+                    mEventVar.wait(lock, [=] { return mStopping || mQueued.load() > 0; });
+                    --mSleepers;
+                    if (mStopping && mQueued.load() <= 0)
+                        break;
                 }
+                current() = {nullptr, 0};
             });
         }
     }
 
 private:
+    struct Worker
+    {
+        ThreadPool *pool;
+        std::size_t index;
+    };
+
     std::size_t numThreads;
     std::vector<std::thread> mThreads;
-    std::condition_variable mEventVar;
+    std::vector<std::unique_ptr<WorkDeque>> mDeques;
 
+    // tasks pushed from outside the workers (or when a deque is full)
+    std::mutex mInjectedMutex;
+    std::deque<Node *> mInjected;
+    std::atomic<std::size_t> mInjectedCount{0};
+
+    // tasks pushed and not taken yet, and workers asleep waiting for one
+    std::atomic<std::int64_t> mQueued{0};
+    std::atomic<int> mSleepers{0};
+    std::condition_variable mEventVar;
     std::mutex mEventMutex;
     bool mStopping = false;
 
-    std::queue<Task> mTasks;
+    // the pool and index of the worker running on this thread, if any
+    static Worker &current()
+    {
+        static thread_local Worker worker{nullptr, 0};
+        return worker;
+    }
+
+    // nodes are recycled per thread, so a task costs no allocation once the
+    // threads have a few spare ones
+    struct NodeCache
+    {
+        static const std::size_t maxSize = 256;
+        std::vector<Node *> nodes;
+
+        ~NodeCache()
+        {
+            for (auto node : nodes)
+                delete node;
+        }
+    };
+
+    static NodeCache &cache()
+    {
+        static thread_local NodeCache nodes;
+        return nodes;
+    }
+
+    static Node *allocate()
+    {
+        auto &c = cache();
+        if (c.nodes.empty())
+            return new Node();
+        auto node = c.nodes.back();
+        c.nodes.pop_back();
+        return node;
+    }
+
+    static void release(Node *node)
+    {
+        node->task.reset();
+        node->group = nullptr;
+        auto &c = cache();
+        if (c.nodes.size() < NodeCache::maxSize)
+            c.nodes.push_back(node);
+        else
+            delete node;
+    }
+
+    void push(PoolTask task, TaskGroupBase *group)
+    {
+        auto node = allocate();
+        node->task = std::move(task);
+        node->group = group;
+
+        auto &worker = current();
+        if (worker.pool != this || !mDeques[worker.index]->push(node))
+        {
+            std::lock_guard<std::mutex> lock{mInjectedMutex};
+            mInjected.push_back(node);
+            mInjectedCount.fetch_add(1);
+        }
+
+        mQueued.fetch_add(1);
+        if (mSleepers.load() > 0)
+        {
+            std::lock_guard<std::mutex> lock{mEventMutex};
+            mEventVar.notify_one();
+        }
+    }
+
+    // a task to run: the newest of this worker's deque, the oldest pushed from
+    // outside, or one stolen from another worker; nullptr when none was found
+    Node *take()
+    {
+        auto &worker = current();
+        Node *node = nullptr;
+        if (worker.pool == this)
+            node = mDeques[worker.index]->pop();
+
+        if (!node && mInjectedCount.load() > 0)
+        {
+            std::lock_guard<std::mutex> lock{mInjectedMutex};
+            if (!mInjected.empty())
+            {
+                node = mInjected.front();
+                mInjected.pop_front();
+                mInjectedCount.fetch_sub(1);
+            }
+        }
+
+        auto first = worker.pool == this ? worker.index + 1 : 0;
+        for (std::size_t i = 0; !node && i < numThreads; ++i)
+            node = mDeques[(first + i) % numThreads]->steal();
+
+        if (node)
+            mQueued.fetch_sub(1);
+        return node;
+    }
+
+    void execute(Node *node)
+    {
+        auto group = node->group;
+        if (!group)
+        {
+            node->task();
+            release(node);
+            return;
+        }
+
+        std::exception_ptr error;
+        try
+        {
+            node->task();
+        }
+        catch (...)
+        {
+            error = std::current_exception();
+        }
+        release(node);
+        group->finished(error);
+    }
 
     void stop() noexcept
     {
@@ -89,4 +510,4 @@ private:
             thread.join();
         }
     }
-};
\ No newline at end of file
+};